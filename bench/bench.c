@@ -0,0 +1,222 @@
+#include "bench_scenes.h"
+
+// Renders canned scenes headless and prints per-frame averages as JSON, so
+// runs from two builds can be diffed. Usage:
+//   odc_bench [--frames N] [--width W] [--height H] [--scene NAME]
+//             [--font PATH]
+
+#define DEFAULT_FONT "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf"
+// GPU timer results lag, so the first frames of a scene aren't counted
+#define WARMUP_FRAMES (GPU_TIMER_FRAMES + 1)
+
+struct scene_result {
+	int frames;
+	double build_ms;
+	double frame_ms;
+	double gpu_ms;
+	int gpu_frames;
+	double shapes;
+	double draw_calls;
+	double upload_bytes;
+};
+
+static void add_circle(struct bench_context *ctx, float x, float y,
+		       float radius, float *color)
+{
+	odc_renderer_add_circle(ctx->target, x, y, radius, ctx->width,
+				ctx->height, color);
+}
+
+static void add_rounded_rect(struct bench_context *ctx, float x, float y,
+			     float width, float height, float radius,
+			     float *color)
+{
+	odc_renderer_add_rounded_rect(ctx->target, x, y, width, height, radius,
+				      ctx->width, ctx->height, color);
+}
+
+static void add_triangle(struct bench_context *ctx, float x1, float y1,
+			 float x2, float y2, float x3, float y3, float *color)
+{
+	odc_renderer_add_triangle(ctx->target, x1, y1, x2, y2, x3, y3,
+				  ctx->width, ctx->height, color);
+}
+
+static void add_line(struct bench_context *ctx, float x1, float y1, float x2,
+		     float y2, float width, float *color)
+{
+	odc_renderer_add_line(ctx->target, x1, y1, x2, y2, width, ctx->width,
+			      ctx->height, color);
+}
+
+static void add_text(struct bench_context *ctx, const char *text, float x,
+		     float y, float scale, float *color)
+{
+	odc_renderer_add_text(ctx->target, text, x, y, scale, ctx->width,
+			      ctx->height, color);
+}
+
+static void add_texture(struct bench_context *ctx, GLuint texture,
+			struct texture_render_options *options)
+{
+	odc_renderer_add_texture(ctx->target, texture, options);
+}
+
+static const struct bench_draw draw = {
+	.circle = add_circle,
+	.rounded_rect = add_rounded_rect,
+	.triangle = add_triangle,
+	.line = add_line,
+	.text = add_text,
+	.texture = add_texture,
+};
+
+static struct bench_context *current;
+static const struct scene *current_scene;
+static double build_ms;
+
+static void render(struct engine *e)
+{
+	(void)e;
+	odc_renderer_reset_shape_count(current->target);
+	odc_renderer_clear(current->target, 0.0f, 0.0f, 0.0f, 1.0f);
+
+	double start = now_ms();
+	current_scene->build(current);
+	build_ms = now_ms() - start;
+}
+
+static GLuint upload_sprite_sheet(struct renderer *renderer)
+{
+	unsigned char pixels[SPRITE_SHEET_SIZE * SPRITE_SHEET_SIZE * 4];
+	for (int y = 0; y < SPRITE_SHEET_SIZE; ++y) {
+		for (int x = 0; x < SPRITE_SHEET_SIZE; ++x) {
+			unsigned char *p =
+				&pixels[(y * SPRITE_SHEET_SIZE + x) * 4];
+			int cx = x % SPRITE_CELL_SIZE - SPRITE_CELL_SIZE / 2;
+			int cy = y % SPRITE_CELL_SIZE - SPRITE_CELL_SIZE / 2;
+			p[0] = (unsigned char)(x * 4);
+			p[1] = (unsigned char)(y * 4);
+			p[2] = 160;
+			p[3] = cx * cx + cy * cy < 40 ? 255 : 0;
+		}
+	}
+	return odc_renderer_upload_texture(renderer, pixels, SPRITE_SHEET_SIZE,
+					   SPRITE_SHEET_SIZE);
+}
+
+static void run_scene(struct engine *engine, struct bench_context *ctx,
+		      const struct scene *scene, int frames,
+		      struct scene_result *result)
+{
+	struct gpu_timer *timer = odc_renderer_get_gpu_timer(ctx->target);
+	memset(result, 0, sizeof(*result));
+	current_scene = scene;
+
+	for (int i = 0; i < WARMUP_FRAMES + frames; ++i) {
+		ctx->frame = i;
+		double start = now_ms();
+		odc_engine_render(engine);
+		double frame_ms = now_ms() - start;
+		if (i < WARMUP_FRAMES)
+			continue;
+
+		struct renderer_stats stats;
+		odc_renderer_get_stats(ctx->target, &stats);
+		result->frames++;
+		result->build_ms += build_ms;
+		result->frame_ms += frame_ms;
+		result->shapes += stats.shape_count;
+		result->draw_calls += stats.draw_calls;
+		result->upload_bytes += (double)stats.upload_bytes;
+
+		double gpu_ms = odc_gpu_timer_get_gpu_frame_time(timer);
+		if (gpu_ms > 0.0) {
+			result->gpu_ms += gpu_ms;
+			result->gpu_frames++;
+		}
+	}
+}
+
+static void print_result(const struct scene *scene,
+			 const struct scene_result *result, int skipped,
+			 int last)
+{
+	printf("    {\"name\": \"%s\", ", scene->name);
+	if (skipped || result->frames == 0) {
+		printf("\"skipped\": true}%s\n", last ? "" : ",");
+		return;
+	}
+
+	double frames = (double)result->frames;
+	printf("\"frames\": %d, \"shapes\": %.0f, \"build_ms\": %.3f, "
+	       "\"frame_ms\": %.3f, \"upload_bytes\": %.0f, "
+	       "\"draw_calls\": %.1f, ",
+	       result->frames, result->shapes / frames,
+	       result->build_ms / frames, result->frame_ms / frames,
+	       result->upload_bytes / frames, result->draw_calls / frames);
+	if (result->gpu_frames > 0)
+		printf("\"gpu_ms\": %.3f}",
+		       result->gpu_ms / (double)result->gpu_frames);
+	else
+		printf("\"gpu_ms\": null}");
+	printf("%s\n", last ? "" : ",");
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_options options = {
+		.frames = DEFAULT_FRAMES,
+		.width = DEFAULT_WIDTH,
+		.height = DEFAULT_HEIGHT,
+		.font = DEFAULT_FONT,
+	};
+	if (bench_parse_options(argc, argv, &options) != 0)
+		return 1;
+
+	struct engine *engine =
+		odc_engine_new_headless(options.width, options.height);
+	if (!engine)
+		return 1;
+
+	struct renderer *renderer = odc_engine_get_renderer(engine);
+	struct bench_context ctx = {
+		.draw = &draw,
+		.target = renderer,
+		.width = options.width,
+		.height = options.height,
+	};
+	FILE *font_file = fopen(options.font, "rb");
+	if (font_file) {
+		fclose(font_file);
+		ctx.has_font =
+			odc_renderer_load_font(renderer, options.font) == 0;
+	}
+	ctx.sheet = upload_sprite_sheet(renderer);
+	odc_renderer_set_gpu_timing(renderer, 1);
+
+	current = &ctx;
+	odc_engine_set_render_callback(engine, render);
+
+	printf("{\n  \"frames\": %d,\n  \"width\": %d,\n  \"height\": %d,\n"
+	       "  \"scenes\": [\n",
+	       options.frames, options.width, options.height);
+	int printed = 0;
+	int selected = bench_selected_count(&options);
+	for (int i = 0; i < SCENE_COUNT; ++i) {
+		const struct scene *scene = &scenes[i];
+		if (!bench_scene_selected(&options, scene))
+			continue;
+
+		struct scene_result result = {0};
+		int skipped = scene->needs_font && !ctx.has_font;
+		if (!skipped)
+			run_scene(engine, &ctx, scene, options.frames, &result);
+		print_result(scene, &result, skipped, ++printed == selected);
+		fflush(stdout);
+	}
+	printf("  ]\n}\n");
+
+	odc_engine_destroy(engine);
+	return 0;
+}
@@ -0,0 +1,315 @@
+#ifndef ODC_BENCH_SCENES_H
+#define ODC_BENCH_SCENES_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "odc.h"
+
+// The scenes odc_bench and odc_shape_bench both run. Each bench supplies the
+// calls that add shapes, to a renderer or straight to a shape batch, so the
+// two always time the same shapes and their numbers can be compared.
+
+#define DEFAULT_FRAMES 100
+#define DEFAULT_WIDTH 1280
+#define DEFAULT_HEIGHT 720
+#define SPRITE_SHEET_SIZE 64
+#define SPRITE_CELL_SIZE 16
+
+struct bench_context;
+
+struct bench_draw {
+	void (*circle)(struct bench_context *ctx, float x, float y,
+		       float radius, float *color);
+	void (*rounded_rect)(struct bench_context *ctx, float x, float y,
+			     float width, float height, float radius,
+			     float *color);
+	void (*triangle)(struct bench_context *ctx, float x1, float y1,
+			 float x2, float y2, float x3, float y3, float *color);
+	void (*line)(struct bench_context *ctx, float x1, float y1, float x2,
+		     float y2, float width, float *color);
+	void (*text)(struct bench_context *ctx, const char *text, float x,
+		     float y, float scale, float *color);
+	void (*texture)(struct bench_context *ctx, GLuint texture,
+			struct texture_render_options *options);
+};
+
+struct bench_context {
+	const struct bench_draw *draw;
+	// The renderer or shape batch the draw calls add to
+	void *target;
+	int width;
+	int height;
+	int frame;
+	int has_font;
+	GLuint sheet;
+};
+
+typedef void (*scene_fn)(struct bench_context *ctx);
+
+struct scene {
+	const char *name;
+	scene_fn build;
+	int needs_font;
+};
+
+struct bench_options {
+	int frames;
+	int width;
+	int height;
+	const char *only;
+	const char *font;
+};
+
+static inline double now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// Scenes must be identical from run to run, so no rand()
+static inline unsigned int next_random(unsigned int *state)
+{
+	*state = *state * 1664525u + 1013904223u;
+	return *state >> 8;
+}
+
+static inline float random_float(unsigned int *state, float max)
+{
+	return (float)(next_random(state) & 0xffff) / 65535.0f * max;
+}
+
+static inline void random_color(unsigned int *state, float *color,
+				float alpha)
+{
+	color[0] = random_float(state, 1.0f);
+	color[1] = random_float(state, 1.0f);
+	color[2] = random_float(state, 1.0f);
+	color[3] = alpha;
+}
+
+static void build_circles(struct bench_context *ctx)
+{
+	unsigned int seed = 1;
+	float color[4];
+	for (int i = 0; i < 100000; ++i) {
+		float x = random_float(&seed, (float)ctx->width);
+		float y = random_float(&seed, (float)ctx->height);
+		float radius = 2.0f + random_float(&seed, 4.0f);
+		random_color(&seed, color, 0.8f);
+		x += (float)((ctx->frame + i) % 8);
+		ctx->draw->circle(ctx, x, y, radius, color);
+	}
+}
+
+static void build_rects(struct bench_context *ctx)
+{
+	unsigned int seed = 2;
+	float color[4];
+	for (int i = 0; i < 400000; ++i) {
+		float x = random_float(&seed, (float)ctx->width);
+		float y = random_float(&seed, (float)ctx->height);
+		float size = 2.0f + random_float(&seed, 6.0f);
+		// A mix of opaque and translucent exercises both passes
+		random_color(&seed, color, i % 4 ? 1.0f : 0.5f);
+		y += (float)((ctx->frame + i) % 8);
+		ctx->draw->rounded_rect(ctx, x, y, size, size, 0.0f, color);
+	}
+}
+
+static void build_triangles(struct bench_context *ctx)
+{
+	unsigned int seed = 5;
+	float color[4];
+	for (int i = 0; i < 100000; ++i) {
+		float x = random_float(&seed, (float)ctx->width);
+		float y = random_float(&seed, (float)ctx->height);
+		float dx = (float)((ctx->frame + i) % 8);
+		random_color(&seed, color, 1.0f);
+		ctx->draw->triangle(ctx, x + dx, y, x + dx + 6.0f, y + 2.0f,
+				    x + 3.0f, y + 7.0f, color);
+	}
+}
+
+static void build_lines(struct bench_context *ctx)
+{
+	unsigned int seed = 6;
+	float color[4];
+	for (int i = 0; i < 100000; ++i) {
+		float x = random_float(&seed, (float)ctx->width);
+		float y = random_float(&seed, (float)ctx->height);
+		float dx = random_float(&seed, 20.0f) - 10.0f;
+		float dy = (float)((ctx->frame + i) % 16) - 8.0f;
+		random_color(&seed, color, 1.0f);
+		ctx->draw->line(ctx, x, y, x + dx, y + dy, 1.5f, color);
+	}
+}
+
+static void build_text(struct bench_context *ctx)
+{
+	unsigned int seed = 3;
+	float color[4];
+	char text[32];
+	for (int i = 0; i < 10000; ++i) {
+		float x = random_float(&seed, (float)ctx->width - 100.0f);
+		float y = random_float(&seed, (float)ctx->height - 20.0f);
+		random_color(&seed, color, 1.0f);
+		snprintf(text, sizeof(text), "Item %d", i + ctx->frame);
+		ctx->draw->text(ctx, text, x, y, 0.3f, color);
+	}
+}
+
+static void build_sprites(struct bench_context *ctx)
+{
+	unsigned int seed = 4;
+	int cells = SPRITE_SHEET_SIZE / SPRITE_CELL_SIZE;
+	for (int i = 0; i < 5000; ++i) {
+		int cell = (int)(next_random(&seed) % (cells * cells));
+		struct texture_render_options options = {
+			.x = random_float(&seed, (float)ctx->width),
+			.y = random_float(&seed, (float)ctx->height),
+			.width = SPRITE_SHEET_SIZE,
+			.height = SPRITE_SHEET_SIZE,
+			.rect_x = (float)(cell % cells * SPRITE_CELL_SIZE),
+			.rect_y = (float)(cell / cells * SPRITE_CELL_SIZE),
+			.rect_width = SPRITE_CELL_SIZE,
+			.rect_height = SPRITE_CELL_SIZE,
+			.screen_width = ctx->width,
+			.screen_height = ctx->height,
+			.scale = 1.0f + random_float(&seed, 2.0f),
+		};
+		options.rotation = random_float(&seed, 6.2831853f) +
+				   (float)ctx->frame * 0.05f;
+		ctx->draw->texture(ctx, ctx->sheet, &options);
+	}
+}
+
+// Panels with a title bar, rows of labels with icons and a progress bar,
+// roughly what a settings screen or inventory draws
+static void build_mixed_ui(struct bench_context *ctx)
+{
+	float panel[4] = {0.15f, 0.15f, 0.2f, 0.95f};
+	float title[4] = {0.25f, 0.3f, 0.5f, 1.0f};
+	float text[4] = {0.9f, 0.9f, 0.9f, 1.0f};
+	float track[4] = {0.1f, 0.1f, 0.1f, 1.0f};
+	float fill[4] = {0.2f, 0.7f, 0.3f, 1.0f};
+	float accent[4] = {0.9f, 0.6f, 0.1f, 1.0f};
+	char label[32];
+
+	for (int p = 0; p < 12; ++p) {
+		float px = (float)(p % 4) * 310.0f + 20.0f;
+		float py = (float)(p / 4) * 230.0f + 20.0f;
+		ctx->draw->rounded_rect(ctx, px, py, 290.0f, 210.0f, 8.0f,
+					panel);
+		ctx->draw->rounded_rect(ctx, px, py, 290.0f, 24.0f, 0.0f,
+					title);
+		if (ctx->has_font) {
+			snprintf(label, sizeof(label), "Panel %d", p);
+			ctx->draw->text(ctx, label, px + 8.0f, py + 4.0f,
+					0.35f, text);
+		}
+
+		for (int row = 0; row < 8; ++row) {
+			float ry = py + 32.0f + (float)row * 22.0f;
+			struct texture_render_options icon = {
+				.x = px + 8.0f,
+				.y = ry,
+				.width = SPRITE_SHEET_SIZE,
+				.height = SPRITE_SHEET_SIZE,
+				.rect_x = (float)(row % 4 * SPRITE_CELL_SIZE),
+				.rect_width = SPRITE_CELL_SIZE,
+				.rect_height = SPRITE_CELL_SIZE,
+				.screen_width = ctx->width,
+				.screen_height = ctx->height,
+				.scale = 1.0f,
+			};
+			ctx->draw->texture(ctx, ctx->sheet, &icon);
+			if (ctx->has_font) {
+				snprintf(label, sizeof(label), "Setting %d",
+					 row);
+				ctx->draw->text(ctx, label, px + 30.0f, ry,
+						0.3f, text);
+			}
+
+			float progress = (float)((ctx->frame * 3 + row * 17 +
+						  p * 29) %
+						 100) /
+					 100.0f;
+			ctx->draw->rounded_rect(ctx, px + 150.0f, ry + 4.0f,
+						120.0f, 10.0f, 5.0f, track);
+			ctx->draw->rounded_rect(ctx, px + 150.0f, ry + 4.0f,
+						120.0f * progress, 10.0f, 5.0f,
+						fill);
+		}
+
+		ctx->draw->circle(ctx, px + 276.0f, py + 12.0f, 6.0f, accent);
+		ctx->draw->line(ctx, px, py + 200.0f, px + 290.0f, py + 200.0f,
+				1.0f, accent);
+	}
+}
+
+static const struct scene scenes[] = {
+	{"circles_100k", build_circles, 0},
+	{"rects_400k", build_rects, 0},
+	{"triangles_100k", build_triangles, 0},
+	{"lines_100k", build_lines, 0},
+	{"text_10k", build_text, 1},
+	{"sprites_5k", build_sprites, 0},
+	{"mixed_ui", build_mixed_ui, 0},
+};
+
+#define SCENE_COUNT ((int)(sizeof(scenes) / sizeof(scenes[0])))
+
+// Fills options from the command line, leaving the defaults already in it
+// for anything not given; --font is only accepted when options->font is set
+static inline int bench_parse_options(int argc, char **argv,
+				      struct bench_options *options)
+{
+	for (int i = 1; i < argc; ++i) {
+		const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+		if (!value) {
+			fprintf(stderr, "Missing value for %s\n", argv[i]);
+			return -1;
+		}
+		if (strcmp(argv[i], "--frames") == 0)
+			options->frames = atoi(value);
+		else if (strcmp(argv[i], "--width") == 0)
+			options->width = atoi(value);
+		else if (strcmp(argv[i], "--height") == 0)
+			options->height = atoi(value);
+		else if (strcmp(argv[i], "--scene") == 0)
+			options->only = value;
+		else if (strcmp(argv[i], "--font") == 0 && options->font)
+			options->font = value;
+		else {
+			fprintf(stderr, "Unknown option %s\n", argv[i]);
+			return -1;
+		}
+		i++;
+	}
+	if (options->frames <= 0 || options->width <= 0 ||
+	    options->height <= 0) {
+		fprintf(stderr, "Frames and size must be positive\n");
+		return -1;
+	}
+	return 0;
+}
+
+static inline int bench_scene_selected(const struct bench_options *options,
+				       const struct scene *scene)
+{
+	return !options->only || strcmp(options->only, scene->name) == 0;
+}
+
+static inline int bench_selected_count(const struct bench_options *options)
+{
+	int selected = 0;
+	for (int i = 0; i < SCENE_COUNT; ++i)
+		selected += bench_scene_selected(options, &scenes[i]);
+	return selected;
+}
+
+#endif // ODC_BENCH_SCENES_H
@@ -0,0 +1,165 @@
+#include "bench_scenes.h"
+
+// Builds canned scenes straight into a shape batch and prints shapes per
+// second as JSON. No window or GL context is created, so it runs on build
+// machines and isolates the CPU side of a frame. Usage:
+//   odc_shape_bench [--frames N] [--width W] [--height H] [--scene NAME]
+
+#define WARMUP_FRAMES 3
+// Texture handles are only compared, so any nonzero value stands in for the
+// sprite sheet
+#define SHEET_TEXTURE 1
+
+struct scene_result {
+	int frames;
+	double build_ms;
+	double sort_ms;
+	double shapes;
+	double opaque;
+	double batches;
+};
+
+static void add_circle(struct bench_context *ctx, float x, float y,
+		       float radius, float *color)
+{
+	odc_shape_batch_add_circle(ctx->target, x, y, radius, ctx->width,
+				   ctx->height, color);
+}
+
+static void add_rounded_rect(struct bench_context *ctx, float x, float y,
+			     float width, float height, float radius,
+			     float *color)
+{
+	odc_shape_batch_add_rounded_rect(ctx->target, x, y, width, height,
+					 radius, ctx->width, ctx->height,
+					 color);
+}
+
+static void add_triangle(struct bench_context *ctx, float x1, float y1,
+			 float x2, float y2, float x3, float y3, float *color)
+{
+	odc_shape_batch_add_triangle(ctx->target, x1, y1, x2, y2, x3, y3,
+				     ctx->width, ctx->height, color);
+}
+
+static void add_line(struct bench_context *ctx, float x1, float y1, float x2,
+		     float y2, float width, float *color)
+{
+	odc_shape_batch_add_line(ctx->target, x1, y1, x2, y2, width,
+				 ctx->width, ctx->height, color);
+}
+
+static void add_texture(struct bench_context *ctx, GLuint texture,
+			struct texture_render_options *options)
+{
+	odc_shape_batch_add_texture(ctx->target, texture, options);
+}
+
+// Fonts need a GL context for their atlas, so text scenes are skipped
+static const struct bench_draw draw = {
+	.circle = add_circle,
+	.rounded_rect = add_rounded_rect,
+	.triangle = add_triangle,
+	.line = add_line,
+	.texture = add_texture,
+};
+
+static int is_texture_opaque(GLuint texture, void *user_data)
+{
+	(void)user_data;
+	return texture % 2 == 0;
+}
+
+static void run_scene(struct bench_context *ctx, const struct scene *scene,
+		      int frames, struct scene_result *result)
+{
+	struct shape_batch *batch = ctx->target;
+	memset(result, 0, sizeof(*result));
+
+	for (int i = 0; i < WARMUP_FRAMES + frames; ++i) {
+		ctx->frame = i;
+		odc_shape_batch_reset(batch);
+
+		double start = now_ms();
+		scene->build(ctx);
+		double built = now_ms();
+		int opaque = odc_shape_batch_sort(batch, is_texture_opaque,
+						  NULL);
+		double sorted = now_ms();
+		if (i < WARMUP_FRAMES)
+			continue;
+
+		int batch_count;
+		odc_shape_batch_get_draw_batches(batch, &batch_count);
+		result->frames++;
+		result->build_ms += built - start;
+		result->sort_ms += sorted - built;
+		result->shapes += odc_shape_batch_get_shape_count(batch);
+		result->opaque += opaque;
+		result->batches += batch_count;
+	}
+}
+
+static void print_result(const struct scene *scene,
+			 const struct scene_result *result, int last)
+{
+	printf("    {\"name\": \"%s\", ", scene->name);
+	if (result->frames == 0) {
+		printf("\"skipped\": true}%s\n", last ? "" : ",");
+		return;
+	}
+
+	double frames = (double)result->frames;
+	double shapes = result->shapes / frames;
+	double build_ms = result->build_ms / frames;
+	double sort_ms = result->sort_ms / frames;
+	printf("\"frames\": %d, \"shapes\": %.0f, \"opaque\": %.0f, "
+	       "\"batches\": %.1f, \"build_ms\": %.3f, \"sort_ms\": %.3f, "
+	       "\"shapes_per_sec\": %.0f}%s\n",
+	       result->frames, shapes, result->opaque / frames,
+	       result->batches / frames, build_ms, sort_ms,
+	       build_ms > 0.0 ? shapes * 1000.0 / build_ms : 0.0,
+	       last ? "" : ",");
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_options options = {
+		.frames = DEFAULT_FRAMES,
+		.width = DEFAULT_WIDTH,
+		.height = DEFAULT_HEIGHT,
+	};
+	if (bench_parse_options(argc, argv, &options) != 0)
+		return 1;
+
+	struct bench_context ctx = {
+		.draw = &draw,
+		.target = odc_shape_batch_new(),
+		.width = options.width,
+		.height = options.height,
+		.sheet = SHEET_TEXTURE,
+	};
+	if (!ctx.target)
+		return 1;
+
+	printf("{\n  \"frames\": %d,\n  \"width\": %d,\n  \"height\": %d,\n"
+	       "  \"scenes\": [\n",
+	       options.frames, options.width, options.height);
+	int printed = 0;
+	int selected = bench_selected_count(&options);
+	for (int i = 0; i < SCENE_COUNT; ++i) {
+		const struct scene *scene = &scenes[i];
+		if (!bench_scene_selected(&options, scene))
+			continue;
+
+		struct scene_result result = {0};
+		if (!scene->needs_font || ctx.has_font)
+			run_scene(&ctx, scene, options.frames, &result);
+		print_result(scene, &result, ++printed == selected);
+		fflush(stdout);
+	}
+	printf("  ]\n}\n");
+
+	odc_shape_batch_destroy(ctx.target);
+	return 0;
+}
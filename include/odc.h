@@ -10,15 +10,30 @@ extern "C" {
 #else
 #define ODC_API __attribute__((visibility("default")))
 #endif
+#include "odc_asset_loader.h"
 #include "odc_audio.h"
+#include "odc_cache.h"
+#include "odc_canvas.h"
 #include "odc_debug.h"
 #include "odc_engine.h"
 #include "odc_font.h"
+#include "odc_frame_capture.h"
+#include "odc_gl_state.h"
+#include "odc_gpu_timer.h"
+#include "odc_image.h"
 #include "odc_input.h"
 #include "odc_note_parser.h"
 #include "odc_oscillator.h"
+#include "odc_render_target.h"
 #include "odc_renderer.h"
 #include "odc_shader.h"
+#include "odc_shape_batch.h"
+#include "odc_soft_rasterizer.h"
+#include "odc_text_layout.h"
+#include "odc_texture_manager.h"
+#include "odc_texture_stream.h"
+#include "odc_thread_pool.h"
+#include "odc_video_capture.h"
 #ifdef __cplusplus
 }
 #endif
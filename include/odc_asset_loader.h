@@ -0,0 +1,50 @@
+#ifndef ODC_ASSET_LOADER_H
+#define ODC_ASSET_LOADER_H
+
+#include "glad.h"
+
+#include "odc.h"
+
+#define ASSET_LOADER_STAGING_SLOTS 4
+#define ASSET_LOADER_STAGING_SIZE (4 * 1024 * 1024)
+
+enum texture_future_state {
+	TEXTURE_FUTURE_DECODING,
+	TEXTURE_FUTURE_DECODED,
+	TEXTURE_FUTURE_UPLOADING,
+	TEXTURE_FUTURE_READY,
+	TEXTURE_FUTURE_FAILED,
+};
+
+struct asset_loader;
+struct texture_future;
+struct renderer;
+
+// A thread_count of zero or less decodes on every online core
+ODC_API struct asset_loader *odc_asset_loader_new(struct renderer *renderer,
+						  int thread_count);
+ODC_API void odc_asset_loader_destroy(struct asset_loader *loader);
+
+// Queues a decode on the pool; the future is owned by the loader and stays
+// valid until it is released
+ODC_API struct texture_future *
+odc_asset_loader_load_texture(struct asset_loader *loader, const char *path);
+// Uploads decoded images through the staging ring; call once per frame on
+// the GL thread.
+ODC_API void odc_asset_loader_update(struct asset_loader *loader);
+ODC_API void odc_asset_loader_wait(struct asset_loader *loader);
+ODC_API int odc_asset_loader_get_pending(struct asset_loader *loader);
+
+ODC_API enum texture_future_state
+odc_texture_future_get_state(struct texture_future *future);
+// Returns 0 until the future is ready
+ODC_API GLuint odc_texture_future_get_texture(struct texture_future *future);
+ODC_API void odc_texture_future_get_size(struct texture_future *future,
+					 int *width, int *height);
+// Call on the GL thread once the texture has been taken, or to cancel a load
+// nobody needs; the future must not be used afterwards. The loader frees it
+// on a later update, once no decode or upload still refers to it. The
+// texture itself stays with the renderer.
+ODC_API void odc_texture_future_release(struct texture_future *future);
+
+#endif // ODC_ASSET_LOADER_H
@@ -0,0 +1,31 @@
+#ifndef ODC_CACHE_H
+#define ODC_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "odc.h"
+
+#define CACHE_HASH_SEED 0xcbf29ce484222325ull
+#define MAX_CACHE_PATH 512
+
+// Cache files live in $ODC_CACHE_DIR, falling back to $XDG_CACHE_HOME/odc
+// and then ~/.cache/odc. Returns NULL when no directory can be created.
+ODC_API const char *odc_cache_get_dir(void);
+ODC_API void odc_cache_set_dir(const char *path);
+ODC_API int odc_cache_get_path(const char *name, char *path, size_t size);
+
+// 64-bit FNV-1a; chain calls by passing the previous hash as the seed
+ODC_API uint64_t odc_cache_hash(uint64_t seed, const void *data, size_t size);
+ODC_API uint64_t odc_cache_hash_string(uint64_t seed, const char *string);
+
+// read returns a malloc'd buffer; write goes through a temporary file and
+// a rename so readers never see a partial entry
+ODC_API void *odc_cache_read(const char *name, size_t *size);
+ODC_API int odc_cache_write(const char *name, const void *data, size_t size);
+// Maps an entry read-only instead of copying it, for large entries that are
+// only read once; release with odc_cache_unmap
+ODC_API const void *odc_cache_map(const char *name, size_t *size);
+ODC_API void odc_cache_unmap(const void *data, size_t size);
+
+#endif // ODC_CACHE_H
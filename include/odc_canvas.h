@@ -0,0 +1,50 @@
+#ifndef ODC_CANVAS_H
+#define ODC_CANVAS_H
+
+#include "glad.h"
+#include <stdint.h>
+
+#include "odc.h"
+
+#define MAX_DIRTY_RECTS 16
+
+// Pixels are stored as 0xAABBGGRR so the buffer uploads directly as GL_RGBA
+#define ODC_CANVAS_RGBA(r, g, b, a)                                      \
+	((uint32_t)(r) | ((uint32_t)(g) << 8) | ((uint32_t)(b) << 16) | \
+	 ((uint32_t)(a) << 24))
+
+struct canvas;
+struct renderer;
+
+ODC_API struct canvas *odc_canvas_new(struct renderer *renderer, int width,
+				      int height);
+// Frees the canvas texture too, so call it before destroying the renderer
+ODC_API void odc_canvas_destroy(struct canvas *canvas);
+
+ODC_API uint32_t *odc_canvas_get_pixels(struct canvas *canvas);
+ODC_API GLuint odc_canvas_get_texture(struct canvas *canvas);
+ODC_API int odc_canvas_get_width(struct canvas *canvas);
+ODC_API int odc_canvas_get_height(struct canvas *canvas);
+ODC_API void odc_canvas_mark_dirty(struct canvas *canvas, int x, int y,
+				   int width, int height);
+
+ODC_API void odc_canvas_clear(struct canvas *canvas, uint32_t color);
+ODC_API void odc_canvas_set_pixel(struct canvas *canvas, int x, int y,
+				  uint32_t color);
+ODC_API void odc_canvas_fill_rect(struct canvas *canvas, int x, int y,
+				  int width, int height, uint32_t color);
+ODC_API void odc_canvas_draw_line(struct canvas *canvas, int x0, int y0,
+				  int x1, int y1, uint32_t color);
+ODC_API void odc_canvas_blit(struct canvas *canvas, const uint32_t *src,
+			     int src_width, int src_height, int src_stride,
+			     int x, int y);
+ODC_API void odc_canvas_blit_alpha(struct canvas *canvas, const uint32_t *src,
+				   int src_width, int src_height,
+				   int src_stride, int x, int y);
+
+ODC_API void odc_canvas_flush(struct canvas *canvas);
+ODC_API void odc_canvas_draw(struct canvas *canvas, struct renderer *renderer,
+			     float x, float y, float scale, int screen_width,
+			     int screen_height);
+
+#endif // ODC_CANVAS_H
@@ -3,11 +3,36 @@
 
 #include "odc.h"
 
+#define OVERDRAW_RAMP_LAYERS 8
+
 struct renderer;
 
+// Average is shaded fragments per pixel over the whole target
+struct overdraw_stats {
+	float average;
+	float max;
+};
+
 ODC_API float odc_debug_calculate_average_frame_time();
 ODC_API void odc_debug_update_frame_times(float frameTime);
 ODC_API void odc_debug_render_frame_time_graph(struct renderer *renderer,
 					       int screen_width,
 					       int screen_height);
+
+// Call once the frame's shapes are queued. Redraws them into an offscreen
+// target counting fragments per pixel, then queues a heatmap of the counts
+// on top of the frame: blue for one layer through green and yellow to red
+// at OVERDRAW_RAMP_LAYERS, white beyond. The stats are read back without
+// stalling, so they describe an earlier call's frame, usually the last.
+ODC_API int odc_debug_render_overdraw(struct renderer *renderer,
+				      int screen_width, int screen_height,
+				      struct overdraw_stats *stats);
+ODC_API struct overdraw_stats odc_debug_get_overdraw_stats(void);
+// Bars for the renderer's last resolved GPU timings, frame first then one
+// row per section: GPU time in green over CPU time in gray, with half the
+// screen width standing for 20 ms. A GPU bar longer than its CPU bar means
+// that part of the frame is GPU bound.
+ODC_API void odc_debug_render_gpu_timings(struct renderer *renderer,
+					  int screen_width, int screen_height);
+ODC_API void odc_debug_release_overdraw(void);
 #endif // DEBUG_H
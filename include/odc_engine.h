@@ -2,6 +2,7 @@
 #define ODC_ENGINE_H
 
 #include "odc.h"
+#include "odc_video_capture.h"
 
 struct engine;
 struct renderer;
@@ -10,10 +11,25 @@ typedef void (*update_callback_t)(struct engine *e);
 typedef void (*render_callback_t)(struct engine *e);
 
 ODC_API struct engine *odc_engine_new(int width, int height, int fullscreen);
+// Renders into a width x height offscreen framebuffer instead of a window,
+// on an EGL surfaceless context (llvmpipe without a GPU) or a hidden GLFW
+// window. Step frames with odc_engine_render; time advances 1/60 s each.
+ODC_API struct engine *odc_engine_new_headless(int width, int height);
+ODC_API int odc_engine_is_headless(struct engine *e);
 ODC_API void odc_engine_run(struct engine *e);
 
 ODC_API void odc_engine_update(struct engine *e, double delta_time);
 ODC_API void odc_engine_render(struct engine *e);
+// Reads the last frame as RGBA8 with the top row first; pixels must hold
+// width * height * 4 bytes
+ODC_API int odc_engine_read_pixels(struct engine *e, unsigned char *pixels);
+// Saves the next rendered frame for odc_replay; see odc_frame_capture_save
+ODC_API int odc_engine_capture_frame(struct engine *e, const char *path);
+// Records every rendered frame at the size the window has now, at 60 fps;
+// see odc_video_capture_new for path
+ODC_API int odc_engine_start_recording(struct engine *e, const char *path,
+				       enum video_capture_format format);
+ODC_API void odc_engine_stop_recording(struct engine *e);
 
 ODC_API void odc_engine_set_update_callback(
 	struct engine *e, update_callback_t callback);
@@ -14,6 +14,25 @@
 #define MAX_GLYPHS 96 // Printable ASCII
 #endif
 
+#define ATLAS_WIDTH 1024
+#define ATLAS_HEIGHT 1024
+
+// The atlas is split into horizontal pages. Page 0 holds the ASCII glyphs
+// rasterized at load and is never evicted; the others fill with glyphs
+// rasterized on demand and are reused least recently drawn first.
+#define FONT_ATLAS_PAGES 4
+#define FONT_PAGE_HEIGHT (ATLAS_HEIGHT / FONT_ATLAS_PAGES)
+// The pixel size the ASCII glyphs and the line metrics are rasterized at
+#define FONT_BASE_SIZE 48
+// Signed distance field atlases hold every glyph at this one size, with
+// distances out to FONT_SDF_SPREAD pixels around the outline stored as
+// 0.5 at the edge, rising inside
+#define FONT_SDF_SIZE 32
+#define FONT_SDF_SPREAD 6
+#define FONT_MIN_PIXEL_SIZE 8
+#define FONT_MAX_PIXEL_SIZE 160
+#define FONT_MAX_CACHED_GLYPHS 4096
+
 struct glyph {
 	GLuint texture_id;
 	int width;
@@ -25,20 +44,105 @@ struct glyph {
 	float tex_offset_y;
 };
 
+struct cached_glyph {
+	struct glyph glyph;
+	uint32_t codepoint;
+	int pixel_size;
+	int page;
+	int next;
+};
+
+struct font_page {
+	int shelf_x;
+	int shelf_y;
+	int shelf_height;
+	unsigned long last_used;
+	// The font's generation when the page was last evicted
+	unsigned int evicted;
+};
+
 struct font {
 	GLuint texture_id;
 	FT_Library ft;
+	// Not opened until needed when the atlas came from the cache
 	FT_Face face;
+	char *path;
 	GLuint atlas;
+	// The R8 atlas stays on the CPU for the software rasterizer
+	unsigned char *bitmap;
 	struct glyph glyphs[MAX_GLYPHS];
 	float scale;
 	int units_per_em;
 	int ascender;
 	int descender;
 	int line_gap;
+	// The atlas holds signed distances rather than coverage
+	int sdf;
+	// Glyphs other than ASCII at FONT_BASE_SIZE, hashed by codepoint and
+	// pixel size
+	struct cached_glyph *cache;
+	int *buckets;
+	int free_glyph;
+	int face_size;
+	struct font_page pages[FONT_ATLAS_PAGES];
+	unsigned long frame;
+	// Atlas rows changed since the last upload
+	int dirty_top;
+	int dirty_bottom;
+	// Bumped when a page is evicted, so layouts holding atlas coordinates
+	// on it know to lay out again
+	unsigned int generation;
+	// Bumped whenever the bitmap changes
+	unsigned int version;
+	// The version each atlas row last changed at, so other backends can
+	// copy only what changed since they last looked
+	unsigned int row_versions[ATLAS_HEIGHT];
 };
 
+// The rendered ASCII atlas is kept in the cache directory, keyed by a hash of
+// the font file's contents and the render settings, and reused by later
+// loads without starting FreeType
 ODC_API int odc_font_load(const char *font_path, struct font *font);
+// Renders a signed distance field atlas at FONT_SDF_SIZE that stays sharp at
+// any scale, for text drawn at many sizes
+ODC_API int odc_font_load_sdf(const char *font_path, struct font *font);
+// Uses a prebuilt ATLAS_WIDTH x ATLAS_HEIGHT atlas without FreeType, holding
+// distances when sdf is set; the glyph metrics are left as they are
+ODC_API int odc_font_load_bitmap(struct font *font,
+				 const unsigned char *bitmap, int sdf);
 ODC_API void odc_font_free(struct font *font);
+// On by default
+ODC_API void odc_font_set_cache_enabled(int enabled);
+
+// Returns the glyph for codepoint rasterized at pixel_size, rendering it into
+// the atlas first if needed, or NULL when the font has no face to render it
+// with or every page is in use this frame. The pointer is valid until the
+// next call.
+ODC_API const struct glyph *odc_font_get_glyph(struct font *font,
+					       uint32_t codepoint,
+					       int pixel_size);
+// Falls back to the glyph at the base size when there is no room for it at
+// pixel_size, so text is stretched rather than losing characters.
+// glyph_size is set to the pixel size the returned glyph was rendered at.
+ODC_API const struct glyph *odc_font_get_nearest_glyph(struct font *font,
+						       uint32_t codepoint,
+						       int pixel_size,
+						       int *glyph_size);
+// The pixel size the font's glyphs for text drawn at scale are rasterized
+// at; always FONT_SDF_SIZE for distance fields
+ODC_API int odc_font_get_pixel_size(const struct font *font, float scale);
+// Marks the pages in page_mask as drawn from this frame. Returns 0 if any of
+// them was evicted after generation, leaving the glyphs on it gone.
+ODC_API int odc_font_touch_pages(struct font *font, unsigned int page_mask,
+				 unsigned int generation);
+// Uploads the atlas rows changed by odc_font_get_glyph
+ODC_API void odc_font_upload(struct font *font);
+// Call once per frame after drawing; pages drawn from in the current frame
+// are never evicted
+ODC_API void odc_font_end_frame(struct font *font);
+
+// Decodes the UTF-8 sequence at *text and advances past it. Returns 0 at the
+// end of the string and U+FFFD for malformed bytes.
+ODC_API uint32_t odc_font_next_codepoint(const char **text);
 
 #endif // FONT_H
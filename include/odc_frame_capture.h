@@ -0,0 +1,35 @@
+#ifndef ODC_FRAME_CAPTURE_H
+#define ODC_FRAME_CAPTURE_H
+
+#include "odc.h"
+
+#define FRAME_CAPTURE_MAGIC "ODCF"
+#define FRAME_CAPTURE_VERSION 2
+
+struct frame_capture;
+struct renderer;
+
+// Saves exactly what is queued on a renderer for a width x height frame:
+// the shapes and their draw batches, the pixels and filters of every
+// texture a batch samples, palettes, sprite animations, custom shape
+// sources, the font atlas when text is drawn, and the time, depth sorting
+// and overdraw state. Call it after the frame's shapes are added and before
+// odc_renderer_draw. Only textures the renderer manages can be captured;
+// mipmaps and wrap modes are not, and replay with the defaults.
+ODC_API int odc_frame_capture_save(struct renderer *renderer, const char *path,
+				   int width, int height);
+
+ODC_API struct frame_capture *odc_frame_capture_load(const char *path);
+ODC_API void odc_frame_capture_destroy(struct frame_capture *capture);
+ODC_API void odc_frame_capture_get_size(struct frame_capture *capture,
+					int *width, int *height);
+ODC_API int odc_frame_capture_get_shape_count(struct frame_capture *capture);
+
+// Uploads the captured resources to a fresh renderer once; afterwards
+// submit queues the captured frame on it as often as needed
+ODC_API int odc_frame_capture_prepare(struct frame_capture *capture,
+				      struct renderer *renderer);
+ODC_API int odc_frame_capture_submit(struct frame_capture *capture,
+				     struct renderer *renderer);
+
+#endif // ODC_FRAME_CAPTURE_H
@@ -0,0 +1,51 @@
+#ifndef ODC_GL_STATE_H
+#define ODC_GL_STATE_H
+
+#include "glad.h"
+
+#include "odc.h"
+
+#define GL_STATE_MAX_TEXTURE_UNITS 16
+
+struct gl_state_stats {
+	unsigned int program_changes;
+	unsigned int vertex_array_changes;
+	unsigned int buffer_changes;
+	unsigned int texture_changes;
+	unsigned int active_texture_changes;
+	unsigned int sampler_changes;
+	unsigned int blend_changes;
+	unsigned int depth_changes;
+	unsigned int skipped;
+};
+
+// Shadows the bindings the library touches so redundant GL calls can be
+// skipped. Code that binds state behind the cache's back must call
+// odc_gl_state_invalidate afterwards.
+ODC_API void odc_gl_state_invalidate(void);
+
+ODC_API void odc_gl_state_use_program(GLuint program);
+ODC_API void odc_gl_state_bind_vertex_array(GLuint vertex_array);
+ODC_API void odc_gl_state_bind_buffer(GLenum target, GLuint buffer);
+ODC_API void odc_gl_state_active_texture(int unit);
+// Binds to the active unit, which is what texture uploads want
+ODC_API void odc_gl_state_bind_texture(GLenum target, GLuint texture);
+ODC_API void odc_gl_state_bind_texture_unit(int unit, GLenum target,
+					    GLuint texture);
+ODC_API void odc_gl_state_bind_sampler(int unit, GLuint sampler);
+ODC_API void odc_gl_state_set_blend(int enabled, GLenum src_factor,
+				    GLenum dst_factor);
+ODC_API void odc_gl_state_set_depth(int test_enabled, int write_enabled);
+
+ODC_API void odc_gl_state_delete_program(GLuint program);
+ODC_API void odc_gl_state_delete_vertex_arrays(int count,
+					       const GLuint *vertex_arrays);
+ODC_API void odc_gl_state_delete_buffers(int count, const GLuint *buffers);
+ODC_API void odc_gl_state_delete_textures(int count, const GLuint *textures);
+ODC_API void odc_gl_state_delete_samplers(int count, const GLuint *samplers);
+
+// Counters cover the previous frame; end_frame starts a new one
+ODC_API void odc_gl_state_end_frame(void);
+ODC_API struct gl_state_stats odc_gl_state_get_stats(void);
+
+#endif // ODC_GL_STATE_H
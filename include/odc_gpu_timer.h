@@ -0,0 +1,39 @@
+#ifndef ODC_GPU_TIMER_H
+#define ODC_GPU_TIMER_H
+
+#include "odc.h"
+
+// Frames of queries kept in flight; results arrive this many frames late
+#define GPU_TIMER_FRAMES 4
+#define GPU_TIMER_MAX_SECTIONS 32
+
+struct gpu_timer_section {
+	const char *name;
+	int depth;
+	double gpu_ms;
+	double cpu_ms;
+};
+
+struct gpu_timer;
+
+ODC_API struct gpu_timer *odc_gpu_timer_new(void);
+ODC_API void odc_gpu_timer_destroy(struct gpu_timer *timer);
+
+// The whole frame is measured with a GL_TIME_ELAPSED query and sections
+// with GL_TIMESTAMP pairs, so sections may nest. Names must outlive the
+// timer. When the GPU is too far behind to free a slot, the frame goes
+// untimed rather than stalling. The recording calls accept a NULL timer.
+ODC_API void odc_gpu_timer_begin_frame(struct gpu_timer *timer);
+ODC_API void odc_gpu_timer_end_frame(struct gpu_timer *timer);
+ODC_API int odc_gpu_timer_begin(struct gpu_timer *timer, const char *name);
+ODC_API void odc_gpu_timer_end(struct gpu_timer *timer, int section);
+
+// Latest resolved frame, in milliseconds
+ODC_API int
+odc_gpu_timer_get_sections(struct gpu_timer *timer,
+			   const struct gpu_timer_section **sections);
+ODC_API double odc_gpu_timer_get_gpu_frame_time(struct gpu_timer *timer);
+ODC_API double odc_gpu_timer_get_cpu_frame_time(struct gpu_timer *timer);
+ODC_API unsigned long odc_gpu_timer_get_dropped_frames(struct gpu_timer *timer);
+
+#endif // ODC_GPU_TIMER_H
@@ -0,0 +1,21 @@
+#ifndef ODC_IMAGE_H
+#define ODC_IMAGE_H
+
+#include <stddef.h>
+
+#include "odc.h"
+
+// Decoders return a malloc'd RGBA8 image with the top row first. Supported
+// formats are QOI, PNG (8-bit, non-interlaced) and TGA (truecolor or
+// grayscale, optionally RLE).
+ODC_API unsigned char *odc_image_decode(const unsigned char *data,
+					size_t size, int *width, int *height);
+ODC_API unsigned char *odc_image_load(const char *path, int *width,
+				      int *height);
+ODC_API void odc_image_flip_rows(unsigned char *pixels, int width,
+				 int height);
+// True when every alpha byte of an RGBA8 image is 255
+ODC_API int odc_image_is_opaque(const unsigned char *pixels, int width,
+				int height);
+
+#endif // ODC_IMAGE_H
@@ -0,0 +1,57 @@
+#ifndef ODC_RENDER_TARGET_H
+#define ODC_RENDER_TARGET_H
+
+#include "glad.h"
+
+#include "odc.h"
+
+#define RENDER_TARGET_MIN_SCALE 0.25f
+#define RENDER_TARGET_SETTLE_FRAMES 8
+#define RENDER_TARGET_SCALE_STEP 0.02f
+
+enum render_target_filter {
+	RENDER_TARGET_NEAREST,
+	RENDER_TARGET_LINEAR,
+};
+
+struct render_target;
+
+// An offscreen color and depth target that is drawn at a fraction of the
+// output size, or at a fixed size such as 320x180, and blitted to the
+// default framebuffer on present.
+ODC_API struct render_target *odc_render_target_new(void);
+ODC_API void odc_render_target_destroy(struct render_target *target);
+
+// A scale of 1 renders at native size. A fixed size overrides the scale;
+// pass 0x0 to go back to scaling.
+ODC_API void odc_render_target_set_scale(struct render_target *target,
+					 float scale);
+ODC_API float odc_render_target_get_scale(struct render_target *target);
+ODC_API void odc_render_target_set_fixed_size(struct render_target *target,
+					      int width, int height);
+ODC_API void odc_render_target_set_filter(struct render_target *target,
+					  enum render_target_filter filter);
+// Fixed-size targets are shown at the largest whole multiple that fits and
+// letterboxed, which keeps pixel art crisp
+ODC_API void odc_render_target_set_integer_scaling(struct render_target *target,
+						   int enabled);
+
+// Lowers the scale quickly when frames run over the target and probes back
+// up slowly when they fit. Zero seconds turns the controller off.
+ODC_API void odc_render_target_set_frame_time_target(
+	struct render_target *target, double seconds, float min_scale,
+	float max_scale);
+ODC_API void odc_render_target_update(struct render_target *target,
+				      double frame_time);
+
+// begin binds the target and its viewport; present blits it to the
+// framebuffer that was bound before and leaves that bound with a full-size
+// viewport
+ODC_API int odc_render_target_begin(struct render_target *target,
+				    int output_width, int output_height);
+ODC_API void odc_render_target_present(struct render_target *target);
+ODC_API void odc_render_target_get_size(struct render_target *target,
+					int *width, int *height);
+ODC_API GLuint odc_render_target_get_texture(struct render_target *target);
+
+#endif // ODC_RENDER_TARGET_H
@@ -3,7 +3,10 @@
 
 #include "glad.h"
 
+#include <stddef.h>
+
 #include "odc.h"
+#include "odc_shape_batch.h"
 
 #define ATTRIB_POS_LOCATION 0
 #define ATTRIB_SHAPE_POS_LOCATION 1
@@ -15,38 +18,113 @@
 #define ATTRIB_HEIGHT_LOCATION 7
 #define ATTRIB_TEX_COORD_LOCATION 8
 #define ATTRIB_RESOLUTION_LOCATION 9
+#define ATTRIB_ANIM_LOCATION 10
 
-#define OP_CODE_CIRCLE 1.0f
-#define OP_CODE_ROUNDED_RECT 2.0f
-#define OP_CODE_EQUILATERAL_TRIANGLE 3.0f
-#define OP_CODE_TRIANGLE 4.0f
-#define OP_CODE_TEXT 5.0f
-#define OP_CODE_TEXTURE 6.0f
-
-#define MAX_SHAPES 400000
+#define MAX_PALETTE_COLORS 256
+#define MAX_SPRITE_ANIMATIONS 64
+#define MAX_CUSTOM_SHAPES 32
+struct gpu_timer;
 struct renderer;
+struct render_target;
+struct text_layout_cache;
+struct texture_manager;
+struct texture_stream;
+
+enum sprite_loop_mode {
+	SPRITE_LOOP_ONCE,
+	SPRITE_LOOP_REPEAT,
+	SPRITE_LOOP_PING_PONG,
+};
+
+// Frames are laid out left to right, top to bottom in a grid of `columns`
+// cells starting at (frame_x, frame_y) on the sheet.
+struct sprite_animation {
+	float sheet_width;
+	float sheet_height;
+	float frame_x;
+	float frame_y;
+	float frame_width;
+	float frame_height;
+	int columns;
+	int frame_count;
+	float fps;
+	enum sprite_loop_mode loop_mode;
+};
 
-struct texture_render_options {
-	float x;
-	float y;
-	float width;
-	float height;
-	float rect_x;
-	float rect_y;
-	float rect_width;
-	float rect_height;
-	int screen_width;
-	int screen_height;
-	int flip_x;
-	int flip_y;
-	float scale;
-	float rotation;
+// What the last odc_renderer_draw submitted
+struct renderer_stats {
+	int shape_count;
+	int batch_count;
+	int opaque_count;
+	int draw_calls;
+	size_t upload_bytes;
+};
+
+struct renderer_texture_info {
+	int width;
+	int height;
+	int channels;
+	int opaque;
+	GLenum min_filter;
+	GLenum mag_filter;
+};
+
+// Zeroed fields fall back to the defaults: GL_NEAREST filtering (trilinear
+// minification when mipmapped) and GL_REPEAT wrapping.
+struct texture_upload_options {
+	int generate_mipmaps;
+	GLenum min_filter;
+	GLenum mag_filter;
+	GLenum wrap_s;
+	GLenum wrap_t;
 };
 
 ODC_API struct renderer *odc_renderer_new();
 ODC_API void odc_renderer_init(struct renderer *renderer);
 ODC_API void odc_renderer_destroy(struct renderer *renderer);
 ODC_API void odc_renderer_draw(struct renderer *renderer);
+// Draws the queued shapes again without touching the frame: no GPU timer
+// sections, stats or texture manager frame, for debug passes
+ODC_API void odc_renderer_redraw(struct renderer *renderer);
+// The output size is normally fed from the window's resize callback so
+// draw never has to ask the windowing system
+ODC_API void odc_renderer_set_viewport_size(struct renderer *renderer,
+					    int width, int height);
+// Whether the framebuffer draw renders into has a depth buffer, which the
+// opaque pass needs. Set by the engine when it creates the framebuffer;
+// pass -1 to have draw look it up whenever the binding changes.
+ODC_API void odc_renderer_set_output_depth(struct renderer *renderer,
+					   int has_depth);
+// While a target is set, begin_frame redirects drawing into it and present
+// scales it onto the window. Change it between frames only; the renderer
+// does not own the target.
+ODC_API void odc_renderer_set_render_target(struct renderer *renderer,
+					    struct render_target *target);
+ODC_API struct render_target *
+odc_renderer_get_render_target(struct renderer *renderer);
+ODC_API void odc_renderer_begin_frame(struct renderer *renderer);
+ODC_API void odc_renderer_present(struct renderer *renderer);
+ODC_API void odc_renderer_get_frame(struct renderer *renderer,
+				    struct renderer_frame *frame);
+// The CPU side of the renderer; odc_renderer_add_* append to it
+ODC_API struct shape_batch *odc_renderer_get_batch(struct renderer *renderer);
+// Times upload, sort and each draw pass on the GPU and CPU, with frames
+// delimited by begin_frame and present
+ODC_API void odc_renderer_set_gpu_timing(struct renderer *renderer,
+					 int enabled);
+ODC_API struct gpu_timer *odc_renderer_get_gpu_timer(struct renderer *renderer);
+ODC_API void odc_renderer_get_stats(struct renderer *renderer,
+				    struct renderer_stats *stats);
+// Opaque rects, triangles and textures are drawn front to back with depth
+// writes before everything else; on by default
+ODC_API void odc_renderer_set_depth_sorting(struct renderer *renderer,
+					    int enabled);
+ODC_API int odc_renderer_get_depth_sorting(struct renderer *renderer);
+// Every shaded fragment writes 1 with additive blending, for counting
+// overdraw into a float target; see odc_debug_render_overdraw
+ODC_API void odc_renderer_set_overdraw_mode(struct renderer *renderer,
+					    int enabled);
+ODC_API int odc_renderer_get_overdraw_mode(struct renderer *renderer);
 ODC_API void odc_renderer_clear(struct renderer *renderer, float r, float g,
 				float b, float a);
 ODC_API void odc_renderer_clear_vertices(struct renderer *renderer);
@@ -72,6 +150,24 @@ ODC_API void odc_renderer_add_triangle(struct renderer *renderer, float x1,
 				       float y1, float x2, float y2, float x3,
 				       float y3, int screen_width,
 				       int screen_height, float *color);
+// sdf_source is the body of
+//   float sdf(vec2 p, vec2 half_size, float param)
+// returning a signed distance in pixels, negative inside, with p relative
+// to the shape's center. Returns the shape id; the shape can be drawn once
+// odc_renderer_rebuild_shaders has compiled it into the program.
+ODC_API int odc_renderer_register_shape(struct renderer *renderer,
+					const char *sdf_source);
+ODC_API int odc_renderer_rebuild_shaders(struct renderer *renderer);
+// Counts only the shapes compiled into the current program
+ODC_API int odc_renderer_get_custom_shape_count(struct renderer *renderer);
+ODC_API const char *odc_renderer_get_custom_shape(struct renderer *renderer,
+						  int shape);
+ODC_API void odc_renderer_add_custom_shape(struct renderer *renderer,
+					   int shape, float x, float y,
+					   float width, float height,
+					   float param, int screen_width,
+					   int screen_height, float *color);
+// text is UTF-8, rendered at the nearest whole pixel size to 48 * scale
 ODC_API void odc_renderer_add_text(struct renderer *renderer, const char *text,
 				   float x, float y, float scale,
 				   int screen_width, int screen_height,
@@ -84,8 +180,25 @@ ODC_API void odc_renderer_add_multiline_text(struct renderer *renderer,
 					     const char *text, float x, float y,
 					     float scale, int screen_width,
 					     int screen_height, float *color);
+// Sizes text the way add_text lays it out, from the same layout cache:
+// the widest line's advance by the line count times the line height
+ODC_API void odc_renderer_measure_text(struct renderer *renderer,
+				       const char *text, float scale,
+				       float *width, float *height);
+ODC_API void odc_renderer_measure_multiline_text(struct renderer *renderer,
+						 const char *text, float scale,
+						 float *width, float *height);
+ODC_API struct text_layout_cache *
+odc_renderer_get_text_layouts(struct renderer *renderer);
 
-ODC_API void odc_renderer_load_font(struct renderer *r, const char *font_path);
+// Both return 0 on success and -1 when the font can't be loaded
+ODC_API int odc_renderer_load_font(struct renderer *r, const char *font_path);
+// Text from a signed distance field atlas stays sharp at every scale
+ODC_API int odc_renderer_load_sdf_font(struct renderer *renderer,
+				       const char *font_path);
+ODC_API int odc_renderer_load_font_bitmap(struct renderer *renderer,
+					  const unsigned char *bitmap,
+					  int sdf);
 ODC_API GLuint odc_renderer_upload_texture(struct renderer *renderer,
 					   const unsigned char *data, int width,
 					   int height);
@@ -93,10 +206,87 @@ ODC_API void odc_renderer_add_line(struct renderer *renderer, float x1,
 				   float y1, float x2, float y2, float width,
 				   int screen_width, int screen_height,
 				   float *color);
-ODC_API void odc_renderer_update_texture(GLuint texture_id,
+ODC_API GLuint odc_renderer_upload_texture_ex(
+	struct renderer *renderer, const unsigned char *data, int width,
+	int height, const struct texture_upload_options *options);
+ODC_API GLuint odc_renderer_upload_texture_mips(
+	struct renderer *renderer, const unsigned char *const *levels,
+	int level_count, int width, int height,
+	const struct texture_upload_options *options);
+ODC_API void odc_renderer_set_texture_filter(struct renderer *renderer,
+					     GLuint texture_handle,
+					     GLenum min_filter,
+					     GLenum mag_filter);
+// With a budget set, uploads keep a CPU copy and the least recently drawn
+// textures are evicted from the GPU, then reloaded when next drawn.
+// Textures uploaded before a budget is set have no copy and stay resident.
+ODC_API void odc_renderer_set_texture_budget(struct renderer *renderer,
+					     size_t bytes);
+ODC_API size_t odc_renderer_get_texture_memory(struct renderer *renderer);
+ODC_API void odc_renderer_set_texture_pinned(struct renderer *renderer,
+					     GLuint texture_handle, int pinned);
+// Uploads with pixel data detect this themselves and updates that may add
+// transparency clear it; set it for textures filled later so the renderer
+// can draw them in its opaque pass
+ODC_API void odc_renderer_set_texture_opaque(struct renderer *renderer,
+					     GLuint texture_handle, int opaque);
+ODC_API GLuint odc_renderer_add_texture_source(
+	struct renderer *renderer, int width, int height,
+	unsigned char *(*load)(void *user_data, int *width, int *height),
+	void *user_data);
+ODC_API void odc_renderer_delete_texture(struct renderer *renderer,
+					 GLuint texture_handle);
+// Reads a texture's base level back from the GPU into a malloc'd buffer of
+// info->channels bytes per pixel
+ODC_API unsigned char *
+odc_renderer_read_texture(struct renderer *renderer, GLuint texture_handle,
+			  struct renderer_texture_info *info);
+ODC_API GLuint odc_renderer_upload_indexed_texture(struct renderer *renderer,
+						   const unsigned char *data,
+						   int width, int height);
+ODC_API int odc_renderer_upload_palettes(struct renderer *renderer,
+					 const unsigned char *colors,
+					 int colors_per_palette,
+					 int palette_count);
+// malloc'd RGBA8, one row per palette; NULL when none are uploaded
+ODC_API unsigned char *odc_renderer_read_palettes(struct renderer *renderer,
+						  int *colors_per_palette,
+						  int *palette_count);
+ODC_API void odc_renderer_update_palette(struct renderer *renderer,
+					 int palette_index,
+					 const unsigned char *colors);
+ODC_API void odc_renderer_add_indexed_texture(
+	struct renderer *renderer, GLuint texture_handle, int palette_index,
+	struct texture_render_options *options);
+ODC_API int odc_renderer_register_animation(
+	struct renderer *renderer, const struct sprite_animation *animation);
+ODC_API void odc_renderer_set_time(struct renderer *renderer, float seconds);
+ODC_API void odc_renderer_add_animated_sprite(
+	struct renderer *renderer, GLuint texture_handle, int animation_id,
+	float start_time, struct texture_render_options *options);
+// Breaking change: takes the renderer, whose texture manager must see the
+// write. Callers of the old form that took only the texture id pass it.
+ODC_API void odc_renderer_update_texture(struct renderer *renderer,
+					 GLuint texture_id,
 					 const unsigned char *data, int x,
 					 int y, int width, int height);
+ODC_API unsigned int odc_renderer_update_texture_async(
+	struct renderer *renderer, GLuint texture_id, const unsigned char *data,
+	int x, int y, int width, int height,
+	void (*callback)(GLuint texture, unsigned int ticket, void *user_data),
+	void *user_data);
+ODC_API struct texture_stream *
+odc_renderer_get_texture_stream(struct renderer *renderer);
+ODC_API struct texture_manager *
+odc_renderer_get_texture_manager(struct renderer *renderer);
 
 ODC_API void check_gl_errors();
 
+// glGetError stalls the pipeline, so release builds compile the polling out
+#ifdef NDEBUG
+#define CHECK_GL_ERRORS() ((void)0)
+#else
+#define CHECK_GL_ERRORS() check_gl_errors()
+#endif
+
 #endif // ODC_RENDERER_H
@@ -4,10 +4,30 @@
 #include "glad.h"
 #include "odc.h"
 
+#define MAX_SHADER_ERROR 256
+
+struct shader_source {
+	const char *vertex;
+	const char *fragment;
+};
+
 ODC_API GLuint odc_shader_new_program(const char *vertexShaderSource,
 				      const char *fragmentShaderSource,
 				      char *error);
 ODC_API GLuint odc_shader_compile_shader(const char *source, GLenum shaderType,
 					 char *error);
 
+// Links every program before checking any of them so parallel-compiling
+// drivers can overlap the work. Linked programs are cached on disk as
+// binaries when the driver supports it. error must hold MAX_SHADER_ERROR
+// bytes.
+ODC_API int odc_shader_new_programs(const struct shader_source *sources,
+				    int count, GLuint *programs, char *error);
+
+// Resolves the program binary and parallel compile entry points; without
+// it shaders are always compiled from source
+ODC_API void odc_shader_load_extensions(GLADloadfunc load);
+ODC_API void odc_shader_set_cache_enabled(int enabled);
+ODC_API int odc_shader_has_parallel_compile(void);
+
 #endif // SHADER_H
@@ -0,0 +1,184 @@
+#ifndef ODC_SHAPE_BATCH_H
+#define ODC_SHAPE_BATCH_H
+
+#include "glad.h"
+
+#include "odc.h"
+
+#define OP_CODE_CIRCLE 1.0f
+#define OP_CODE_ROUNDED_RECT 2.0f
+#define OP_CODE_EQUILATERAL_TRIANGLE 3.0f
+#define OP_CODE_TRIANGLE 4.0f
+#define OP_CODE_TEXT 5.0f
+#define OP_CODE_TEXTURE 6.0f
+#define OP_CODE_INDEXED_TEXTURE 7.0f
+#define OP_CODE_ANIMATED_SPRITE 8.0f
+#define OP_CODE_CUSTOM_BASE 16.0f
+
+#define MAX_SHAPES 400000
+#define MAX_DRAW_BATCHES 4096
+
+struct font;
+struct shape_batch;
+struct text_layout;
+
+struct vertex {
+	float fs_quad_pos[2];
+	float shape_pos[2];
+	float local_pos[2];
+	float op_code;
+	float radius;
+	float width;
+	float height;
+	float color[4];
+	float resolution[2];
+	float tex_coord[2];
+	float anim[2];
+};
+
+// A run of shapes starting at first_shape that samples the same texture.
+// The opaque and translucent ranges index into the batch's index buffer.
+struct draw_batch {
+	int first_shape;
+	GLuint texture;
+	int opaque_first;
+	int opaque_count;
+	int translucent_first;
+	int translucent_count;
+};
+
+// The queued shapes as a backend other than GL sees them: six vertices per
+// shape, in submission order, and the uniforms the shaders would read.
+// Valid until the next add or reset.
+struct renderer_frame {
+	const struct vertex *vertices;
+	int shape_count;
+	const struct draw_batch *batches;
+	int batch_count;
+	const unsigned char *font_bitmap;
+	// Changes whenever the font bitmap's contents do
+	unsigned int font_version;
+	// The font_version each bitmap row last changed at; NULL when every
+	// row should be treated as changed
+	const unsigned int *font_row_versions;
+	// The bitmap holds signed distances rather than coverage
+	int font_sdf;
+	float time;
+	const float (*animation_frames)[4];
+	const float (*animation_params)[4];
+	int animation_count;
+};
+
+struct texture_render_options {
+	float x;
+	float y;
+	float width;
+	float height;
+	float rect_x;
+	float rect_y;
+	float rect_width;
+	float rect_height;
+	int screen_width;
+	int screen_height;
+	int flip_x;
+	int flip_y;
+	float scale;
+	float rotation;
+};
+
+typedef int (*shape_batch_opaque_fn)(GLuint texture, void *user_data);
+
+// Turns shapes into vertices and draw batches on the CPU with no GL
+// context, so the same frame can be built once and handed to the GL or
+// software backend, or timed on a machine without a display.
+// Coordinates are in pixels of a screen_width x screen_height output.
+ODC_API struct shape_batch *odc_shape_batch_new(void);
+ODC_API void odc_shape_batch_destroy(struct shape_batch *batch);
+ODC_API void odc_shape_batch_reset(struct shape_batch *batch);
+ODC_API void odc_shape_batch_clear(struct shape_batch *batch);
+// Shapes that land entirely off screen are dropped as they are added; on by
+// default
+ODC_API void odc_shape_batch_set_culling(struct shape_batch *batch,
+					 int enabled);
+
+ODC_API void odc_shape_batch_add_circle(struct shape_batch *batch, float x,
+					float y, float radius,
+					int screen_width, int screen_height,
+					const float *color);
+ODC_API void odc_shape_batch_add_rounded_rect(struct shape_batch *batch,
+					      float x, float y, float width,
+					      float height, float radius,
+					      int screen_width,
+					      int screen_height,
+					      const float *color);
+ODC_API void odc_shape_batch_add_equilateral_triangle(
+	struct shape_batch *batch, float x, float y, float size,
+	int screen_width, int screen_height, const float *color);
+ODC_API void odc_shape_batch_add_triangle(struct shape_batch *batch, float x1,
+					  float y1, float x2, float y2,
+					  float x3, float y3, int screen_width,
+					  int screen_height,
+					  const float *color);
+ODC_API void odc_shape_batch_add_line(struct shape_batch *batch, float x1,
+				      float y1, float x2, float y2,
+				      float line_width, int screen_width,
+				      int screen_height, const float *color);
+ODC_API void odc_shape_batch_add_custom_shape(struct shape_batch *batch,
+					      int shape, float x, float y,
+					      float width, float height,
+					      float param, int screen_width,
+					      int screen_height,
+					      const float *color);
+// text is UTF-8; glyphs missing from the font's atlas are rendered into it
+ODC_API void odc_shape_batch_add_text(struct shape_batch *batch,
+				      struct font *font, const char *text,
+				      float x, float y, float scale,
+				      int screen_width, int screen_height,
+				      const float *color);
+ODC_API void odc_shape_batch_add_multiline_text(
+	struct shape_batch *batch, struct font *font, const char *text,
+	float x, float y, float scale, int screen_width, int screen_height,
+	const float *color);
+// Emits a layout from odc_text_layout_cache_get with its top left at (x, y)
+ODC_API void odc_shape_batch_add_text_layout(struct shape_batch *batch,
+					     const struct text_layout *layout,
+					     float x, float y, int screen_width,
+					     int screen_height,
+					     const float *color);
+
+ODC_API void
+odc_shape_batch_add_texture(struct shape_batch *batch, GLuint texture_handle,
+			    const struct texture_render_options *options);
+ODC_API void odc_shape_batch_add_indexed_texture(
+	struct shape_batch *batch, GLuint texture_handle, int palette_index,
+	const struct texture_render_options *options);
+// options describe a single frame of the sheet; the vertex shader picks
+// which one from the animation's uniforms
+ODC_API void odc_shape_batch_add_animated_sprite(
+	struct shape_batch *batch, GLuint texture_handle, int animation_id,
+	float start_time, const struct texture_render_options *options);
+
+// Appends prebuilt shapes, six vertices each, as they would come out of
+// the add functions. Nothing is culled. Returns how many fit.
+ODC_API int odc_shape_batch_add_shapes(struct shape_batch *batch,
+				       const struct vertex *vertices,
+				       int shape_count, GLuint texture_handle);
+
+// Fills the index buffer with each batch's opaque shapes front to back,
+// then its translucent shapes in submission order, and records the ranges
+// on the draw batches. Returns the number of opaque shapes.
+ODC_API int odc_shape_batch_sort(struct shape_batch *batch,
+				 shape_batch_opaque_fn is_texture_opaque,
+				 void *user_data);
+
+ODC_API int odc_shape_batch_get_shape_count(struct shape_batch *batch);
+ODC_API const struct vertex *
+odc_shape_batch_get_vertices(struct shape_batch *batch);
+ODC_API const GLuint *odc_shape_batch_get_indices(struct shape_batch *batch);
+ODC_API const struct draw_batch *
+odc_shape_batch_get_draw_batches(struct shape_batch *batch, int *count);
+// Fills the shape fields of frame and zeroes the rest
+ODC_API void odc_shape_batch_get_frame(struct shape_batch *batch,
+				       struct renderer_frame *frame);
+
+#endif // ODC_SHAPE_BATCH_H
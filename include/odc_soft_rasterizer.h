@@ -0,0 +1,61 @@
+#ifndef ODC_SOFT_RASTERIZER_H
+#define ODC_SOFT_RASTERIZER_H
+
+#include "glad.h"
+
+#include "odc.h"
+
+#define SOFT_RASTER_TILE_SIZE 64
+
+struct renderer;
+struct renderer_frame;
+struct soft_rasterizer;
+
+// The C twin of a custom shape's GLSL sdf body, in the same units
+typedef float (*soft_rasterizer_sdf_fn)(float x, float y, float half_width,
+					float half_height, float param);
+
+// Draws the renderer's queued shapes on the CPU with the fragment shader's
+// coverage and shading rules, for machines without a usable GL driver and
+// as a GPU-free reference image. Shapes are binned into tiles that are
+// shaded in parallel; a thread_count of zero or less uses every core.
+ODC_API struct soft_rasterizer *odc_soft_rasterizer_new(int width, int height,
+							int thread_count);
+ODC_API void odc_soft_rasterizer_destroy(struct soft_rasterizer *raster);
+ODC_API int odc_soft_rasterizer_resize(struct soft_rasterizer *raster,
+				       int width, int height);
+
+// GL textures can't be read back here, so each handle the renderer draws
+// needs the pixels it was uploaded with: RGBA8, or one byte per pixel for
+// indexed textures. The pixels are borrowed. Unregistered textures and
+// custom shapes without a function are skipped.
+ODC_API int odc_soft_rasterizer_set_texture(struct soft_rasterizer *raster,
+					    GLuint texture_handle,
+					    const unsigned char *pixels,
+					    int width, int height,
+					    int channels);
+ODC_API void odc_soft_rasterizer_set_palettes(struct soft_rasterizer *raster,
+					      const unsigned char *colors,
+					      int colors_per_palette,
+					      int palette_count);
+ODC_API int odc_soft_rasterizer_set_custom_shape(struct soft_rasterizer *raster,
+						 int shape,
+						 soft_rasterizer_sdf_fn sdf);
+
+ODC_API void odc_soft_rasterizer_clear(struct soft_rasterizer *raster, float r,
+				       float g, float b, float a);
+ODC_API int odc_soft_rasterizer_draw(struct soft_rasterizer *raster,
+				     struct renderer *renderer);
+// For frames built without a renderer, e.g. from odc_shape_batch_get_frame
+// with the font bitmap and animation fields filled in by the caller
+ODC_API int
+odc_soft_rasterizer_draw_frame(struct soft_rasterizer *raster,
+			       const struct renderer_frame *frame);
+
+// RGBA8 with the top row first, ready to save or to upload as a texture
+ODC_API const unsigned char *
+odc_soft_rasterizer_get_pixels(struct soft_rasterizer *raster);
+ODC_API void odc_soft_rasterizer_get_size(struct soft_rasterizer *raster,
+					  int *width, int *height);
+
+#endif // ODC_SOFT_RASTERIZER_H
@@ -0,0 +1,56 @@
+#ifndef ODC_TEXT_LAYOUT_H
+#define ODC_TEXT_LAYOUT_H
+
+#include "odc.h"
+
+#define TEXT_LAYOUT_CACHE_DEFAULT_ENTRIES 1024
+
+struct font;
+struct text_layout_cache;
+
+// A glyph quad in pixels relative to the top left of the text, and its
+// atlas coordinates
+struct text_layout_glyph {
+	float x0;
+	float y0;
+	float x1;
+	float y1;
+	float u0;
+	float v0;
+	float u1;
+	float v1;
+};
+
+struct text_layout {
+	const struct text_layout_glyph *glyphs;
+	int glyph_count;
+	int line_count;
+	// The widest line's advance by line_count line heights, which is what
+	// UI code lines things up against
+	float width;
+	float height;
+	// The inked area, relative to the top left like the glyphs
+	float min_x;
+	float min_y;
+	float max_x;
+	float max_y;
+};
+
+// Remembers laid out strings for a font and scale so text that is the same
+// every frame isn't walked glyph by glyph again. The least recently used
+// layout is dropped once capacity is reached.
+ODC_API struct text_layout_cache *odc_text_layout_cache_new(int capacity);
+ODC_API void odc_text_layout_cache_destroy(struct text_layout_cache *cache);
+// Layouts depend on the font's metrics, so clear after reloading a font
+ODC_API void odc_text_layout_cache_clear(struct text_layout_cache *cache);
+
+// text is UTF-8. Lines break at '\n' when multiline is set; otherwise it is
+// skipped like any other control character. Glyphs missing from the atlas
+// are rendered into it. The layout stays valid until the next get or clear.
+ODC_API const struct text_layout *
+odc_text_layout_cache_get(struct text_layout_cache *cache, struct font *font,
+			  const char *text, float scale, int multiline);
+ODC_API void odc_text_layout_cache_get_stats(struct text_layout_cache *cache,
+					     int *hits, int *misses);
+
+#endif // ODC_TEXT_LAYOUT_H
@@ -0,0 +1,68 @@
+#ifndef ODC_TEXTURE_MANAGER_H
+#define ODC_TEXTURE_MANAGER_H
+
+#include "glad.h"
+#include <stddef.h>
+
+#include "odc.h"
+
+// Returns a malloc'd RGBA8 (or single channel, matching the texture) image
+// that the manager frees once it has been uploaded.
+typedef unsigned char *(*texture_load_fn)(void *user_data, int *width,
+					  int *height);
+
+struct managed_texture {
+	GLuint id;
+	GLuint sampler;
+	int width;
+	int height;
+	GLenum internal_format;
+	GLenum format;
+	int bytes_per_pixel;
+	int has_mipmaps;
+	int opaque;
+	size_t gpu_bytes;
+	int resident;
+	int pinned;
+	unsigned long last_used;
+	unsigned char *pixels;
+	texture_load_fn load;
+	void *user_data;
+};
+
+struct texture_manager;
+
+ODC_API struct texture_manager *odc_texture_manager_new(void);
+ODC_API void odc_texture_manager_destroy(struct texture_manager *manager);
+
+ODC_API struct managed_texture *
+odc_texture_manager_add(struct texture_manager *manager, GLuint id, int width,
+			int height, GLenum internal_format, GLenum format,
+			int has_mipmaps, const unsigned char *pixels);
+ODC_API struct managed_texture *
+odc_texture_manager_add_source(struct texture_manager *manager, int width,
+			       int height, texture_load_fn load,
+			       void *user_data);
+ODC_API struct managed_texture *
+odc_texture_manager_find(struct texture_manager *manager, GLuint id);
+ODC_API void odc_texture_manager_remove(struct texture_manager *manager,
+					GLuint id);
+
+ODC_API int odc_texture_manager_use(struct texture_manager *manager,
+				    GLuint id);
+// Call before writing to a texture's storage directly. Evicted textures are
+// made resident again and the CPU copy is patched with pixels, or dropped
+// when pixels is NULL because the data never leaves the GPU. Writes that
+// may add transparency clear the opaque flag.
+ODC_API int odc_texture_manager_update(struct texture_manager *manager,
+				       GLuint id, int x, int y, int width,
+				       int height, const unsigned char *pixels);
+ODC_API void odc_texture_manager_end_frame(struct texture_manager *manager);
+
+ODC_API void odc_texture_manager_set_budget(struct texture_manager *manager,
+					    size_t bytes);
+ODC_API size_t odc_texture_manager_get_usage(struct texture_manager *manager);
+ODC_API void odc_texture_manager_set_pinned(struct texture_manager *manager,
+					    GLuint id, int pinned);
+
+#endif // ODC_TEXTURE_MANAGER_H
@@ -0,0 +1,50 @@
+#ifndef ODC_TEXTURE_STREAM_H
+#define ODC_TEXTURE_STREAM_H
+
+#include "glad.h"
+#include <stddef.h>
+
+#include "odc.h"
+
+#define TEXTURE_STREAM_DEFAULT_SLOTS 4
+#define TEXTURE_STREAM_MIN_SLOT_SIZE (1024 * 1024)
+
+typedef void (*texture_stream_callback)(GLuint texture, unsigned int ticket,
+					void *user_data);
+
+struct texture_stream;
+struct texture_manager;
+
+// Updates to textures tracked by textures (which may be NULL) go through
+// the manager, so evicted textures are reloaded before they are written.
+// Breaking change: textures is new; pass NULL to keep the old behaviour.
+ODC_API struct texture_stream *
+odc_texture_stream_new(struct texture_manager *textures, int slot_count,
+		       size_t slot_size);
+ODC_API void odc_texture_stream_destroy(struct texture_stream *stream);
+
+// Maps a free staging buffer. Must be called on the GL thread, but the
+// returned memory may be filled from any thread before it is submitted.
+ODC_API void *odc_texture_stream_acquire(struct texture_stream *stream,
+					 size_t size, int *slot);
+// Thread safe. Queues the filled slot as a texture update; the returned
+// ticket completes once the GPU has consumed the data. If the texture is
+// gone or can't be reloaded nothing is uploaded, and the callback is
+// passed 0 in place of the texture.
+ODC_API unsigned int odc_texture_stream_submit(
+	struct texture_stream *stream, int slot, GLuint texture, int x, int y,
+	int width, int height, GLenum format, texture_stream_callback callback,
+	void *user_data);
+ODC_API unsigned int odc_texture_stream_upload(
+	struct texture_stream *stream, GLuint texture, int x, int y, int width,
+	int height, GLenum format, const void *data,
+	texture_stream_callback callback, void *user_data);
+
+// Issues queued uploads and retires finished ones; call once per frame on
+// the GL thread.
+ODC_API void odc_texture_stream_update(struct texture_stream *stream);
+ODC_API void odc_texture_stream_finish(struct texture_stream *stream);
+ODC_API int odc_texture_stream_is_complete(struct texture_stream *stream,
+					   unsigned int ticket);
+
+#endif // ODC_TEXTURE_STREAM_H
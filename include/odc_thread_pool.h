@@ -0,0 +1,19 @@
+#ifndef ODC_THREAD_POOL_H
+#define ODC_THREAD_POOL_H
+
+#include "odc.h"
+
+typedef void (*thread_pool_job_fn)(void *arg);
+
+struct thread_pool;
+
+// A thread_count of zero or less uses one thread per online core
+ODC_API struct thread_pool *odc_thread_pool_new(int thread_count);
+ODC_API void odc_thread_pool_destroy(struct thread_pool *pool);
+
+ODC_API int odc_thread_pool_submit(struct thread_pool *pool,
+				   thread_pool_job_fn fn, void *arg);
+ODC_API void odc_thread_pool_wait(struct thread_pool *pool);
+ODC_API int odc_thread_pool_get_thread_count(struct thread_pool *pool);
+
+#endif // ODC_THREAD_POOL_H
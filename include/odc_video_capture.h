@@ -0,0 +1,42 @@
+#ifndef ODC_VIDEO_CAPTURE_H
+#define ODC_VIDEO_CAPTURE_H
+
+#include "glad.h"
+
+#include "odc.h"
+
+// Frames in flight between glReadPixels and the writer thread. The GL
+// thread never waits for them; a frame that finds every slot busy is
+// dropped.
+#define VIDEO_CAPTURE_SLOTS 4
+
+enum video_capture_format {
+	// RGBA8 frames back to back, top row first
+	VIDEO_CAPTURE_RAW,
+	// YUV4MPEG2 4:2:0, which ffmpeg and most encoders read directly
+	VIDEO_CAPTURE_Y4M,
+};
+
+struct video_capture;
+
+// Records width x height frames to path, or to the standard input of a
+// shell command when path starts with '|', e.g.
+//   "|ffmpeg -loglevel error -y -i - -c:v libx264 out.mp4"
+// Frames are read back into a ring of pixel buffers and mapped a few frames
+// later, then written out on a thread of their own.
+ODC_API struct video_capture *
+odc_video_capture_new(const char *path, enum video_capture_format format,
+		      int width, int height, int fps);
+// Writes out every queued frame and closes the file or waits for the
+// command to exit. Call on the GL thread.
+ODC_API void odc_video_capture_destroy(struct video_capture *capture);
+
+// Queues the bottom-left width x height of framebuffer's color buffer.
+// When the writer falls behind and every slot is taken the frame is dropped
+// rather than stalling; returns 1 if it was queued.
+ODC_API int odc_video_capture_frame(struct video_capture *capture,
+				    GLuint framebuffer);
+ODC_API int odc_video_capture_get_frame_count(struct video_capture *capture);
+ODC_API int odc_video_capture_get_dropped_count(struct video_capture *capture);
+
+#endif // ODC_VIDEO_CAPTURE_H
@@ -0,0 +1,309 @@
+#include "glad.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "odc_asset_loader.h"
+#include "odc_image.h"
+#include "odc_renderer.h"
+#include "odc_texture_stream.h"
+#include "odc_thread_pool.h"
+
+struct texture_future {
+	struct asset_loader *loader;
+	char *path;
+	enum texture_future_state state;
+	unsigned char *pixels;
+	int width;
+	int height;
+	int opaque;
+	GLuint texture;
+	// Set by odc_texture_future_release; only touched on the GL thread
+	int released;
+};
+
+struct asset_loader {
+	struct renderer *renderer;
+	struct thread_pool *pool;
+	struct texture_stream *stream;
+	struct texture_future **futures;
+	int future_count;
+	int future_capacity;
+	int pending;
+	pthread_mutex_t mutex;
+};
+
+static void set_state(struct texture_future *future,
+		      enum texture_future_state state)
+{
+	pthread_mutex_lock(&future->loader->mutex);
+	future->state = state;
+	if (state == TEXTURE_FUTURE_READY || state == TEXTURE_FUTURE_FAILED)
+		future->loader->pending--;
+	pthread_mutex_unlock(&future->loader->mutex);
+}
+
+static void free_future(struct texture_future *future)
+{
+	free(future->pixels);
+	free(future->path);
+	free(future);
+}
+
+static void decode_job(void *arg)
+{
+	struct texture_future *future = (struct texture_future *)arg;
+
+	int width, height;
+	unsigned char *pixels = odc_image_load(future->path, &width, &height);
+	if (!pixels) {
+		set_state(future, TEXTURE_FUTURE_FAILED);
+		return;
+	}
+
+	// Textures are drawn with row zero at the bottom, as GL expects
+	odc_image_flip_rows(pixels, width, height);
+
+	future->pixels = pixels;
+	future->opaque = odc_image_is_opaque(pixels, width, height);
+	future->width = width;
+	future->height = height;
+	set_state(future, TEXTURE_FUTURE_DECODED);
+}
+
+static void on_uploaded(GLuint texture, unsigned int ticket, void *user_data)
+{
+	struct texture_future *future = (struct texture_future *)user_data;
+	(void)ticket;
+
+	if (!texture) {
+		set_state(future, TEXTURE_FUTURE_FAILED);
+		return;
+	}
+
+	// Streamed writes clear the flag, so it is set once they have landed
+	odc_renderer_set_texture_opaque(future->loader->renderer, texture,
+					future->opaque);
+	set_state(future, TEXTURE_FUTURE_READY);
+}
+
+struct asset_loader *odc_asset_loader_new(struct renderer *renderer,
+					  int thread_count)
+{
+	struct asset_loader *loader =
+		(struct asset_loader *)calloc(1, sizeof(*loader));
+	if (!loader) {
+		fprintf(stderr,
+			"ERROR::ASSET_LOADER: Failed to allocate asset loader\n");
+		return NULL;
+	}
+
+	loader->renderer = renderer;
+	loader->pool = odc_thread_pool_new(thread_count);
+	loader->stream = odc_texture_stream_new(
+		odc_renderer_get_texture_manager(renderer),
+		ASSET_LOADER_STAGING_SLOTS, ASSET_LOADER_STAGING_SIZE);
+	if (!loader->pool || !loader->stream) {
+		odc_thread_pool_destroy(loader->pool);
+		odc_texture_stream_destroy(loader->stream);
+		free(loader);
+		return NULL;
+	}
+
+	pthread_mutex_init(&loader->mutex, NULL);
+	return loader;
+}
+
+void odc_asset_loader_destroy(struct asset_loader *loader)
+{
+	if (!loader)
+		return;
+
+	// Joining the pool first means no worker still touches a future
+	odc_thread_pool_destroy(loader->pool);
+	odc_texture_stream_destroy(loader->stream);
+
+	for (int i = 0; i < loader->future_count; ++i)
+		free_future(loader->futures[i]);
+
+	pthread_mutex_destroy(&loader->mutex);
+	free(loader->futures);
+	free(loader);
+}
+
+struct texture_future *odc_asset_loader_load_texture(struct asset_loader *loader,
+						     const char *path)
+{
+	if (loader->future_count == loader->future_capacity) {
+		int capacity = loader->future_capacity
+				       ? loader->future_capacity * 2
+				       : 64;
+		struct texture_future **futures =
+			(struct texture_future **)realloc(
+				loader->futures,
+				capacity * sizeof(struct texture_future *));
+		if (!futures)
+			return NULL;
+		loader->futures = futures;
+		loader->future_capacity = capacity;
+	}
+
+	struct texture_future *future =
+		(struct texture_future *)calloc(1, sizeof(*future));
+	if (!future)
+		return NULL;
+
+	future->loader = loader;
+	future->path = strdup(path);
+	future->state = TEXTURE_FUTURE_DECODING;
+	if (!future->path) {
+		free(future);
+		return NULL;
+	}
+
+	loader->futures[loader->future_count++] = future;
+
+	pthread_mutex_lock(&loader->mutex);
+	loader->pending++;
+	pthread_mutex_unlock(&loader->mutex);
+
+	if (odc_thread_pool_submit(loader->pool, decode_job, future) != 0)
+		set_state(future, TEXTURE_FUTURE_FAILED);
+
+	return future;
+}
+
+static int start_upload(struct asset_loader *loader,
+			struct texture_future *future)
+{
+	size_t size = (size_t)future->width * future->height * 4;
+
+	if (!future->texture) {
+		future->texture = odc_renderer_upload_texture(
+			loader->renderer, NULL, future->width, future->height);
+		if (!future->texture) {
+			free(future->pixels);
+			future->pixels = NULL;
+			set_state(future, TEXTURE_FUTURE_FAILED);
+			return 0;
+		}
+	}
+
+	if (size > ASSET_LOADER_STAGING_SIZE) {
+		odc_renderer_update_texture(loader->renderer, future->texture,
+					    future->pixels, 0, 0, future->width,
+					    future->height);
+		odc_renderer_set_texture_opaque(loader->renderer,
+						future->texture, future->opaque);
+		set_state(future, TEXTURE_FUTURE_READY);
+	} else {
+		int slot;
+		void *staging = odc_texture_stream_acquire(loader->stream, size,
+							   &slot);
+		// The ring is busy, so try again next frame
+		if (!staging)
+			return -1;
+
+		memcpy(staging, future->pixels, size);
+		set_state(future, TEXTURE_FUTURE_UPLOADING);
+		odc_texture_stream_submit(loader->stream, slot, future->texture,
+					  0, 0, future->width, future->height,
+					  GL_RGBA, on_uploaded, future);
+	}
+
+	free(future->pixels);
+	future->pixels = NULL;
+	return 0;
+}
+
+// A finished future is no longer referenced by a decode job or a pending
+// upload, so once released it can be freed
+static void free_released(struct asset_loader *loader)
+{
+	int kept = 0;
+	for (int i = 0; i < loader->future_count; ++i) {
+		struct texture_future *future = loader->futures[i];
+		enum texture_future_state state =
+			odc_texture_future_get_state(future);
+		if (future->released && (state == TEXTURE_FUTURE_READY ||
+					 state == TEXTURE_FUTURE_FAILED)) {
+			free_future(future);
+			continue;
+		}
+		loader->futures[kept++] = future;
+	}
+	loader->future_count = kept;
+}
+
+void odc_asset_loader_update(struct asset_loader *loader)
+{
+	odc_texture_stream_update(loader->stream);
+
+	for (int i = 0; i < loader->future_count; ++i) {
+		struct texture_future *future = loader->futures[i];
+		if (odc_texture_future_get_state(future) !=
+		    TEXTURE_FUTURE_DECODED)
+			continue;
+		// Nobody is waiting for the texture, so don't upload it
+		if (future->released) {
+			free(future->pixels);
+			future->pixels = NULL;
+			set_state(future, TEXTURE_FUTURE_FAILED);
+			continue;
+		}
+		if (start_upload(loader, future) != 0)
+			break;
+	}
+
+	odc_texture_stream_update(loader->stream);
+	free_released(loader);
+}
+
+void odc_asset_loader_wait(struct asset_loader *loader)
+{
+	odc_thread_pool_wait(loader->pool);
+
+	while (odc_asset_loader_get_pending(loader) > 0) {
+		odc_asset_loader_update(loader);
+		odc_texture_stream_finish(loader->stream);
+	}
+}
+
+int odc_asset_loader_get_pending(struct asset_loader *loader)
+{
+	pthread_mutex_lock(&loader->mutex);
+	int pending = loader->pending;
+	pthread_mutex_unlock(&loader->mutex);
+	return pending;
+}
+
+enum texture_future_state
+odc_texture_future_get_state(struct texture_future *future)
+{
+	pthread_mutex_lock(&future->loader->mutex);
+	enum texture_future_state state = future->state;
+	pthread_mutex_unlock(&future->loader->mutex);
+	return state;
+}
+
+GLuint odc_texture_future_get_texture(struct texture_future *future)
+{
+	return odc_texture_future_get_state(future) == TEXTURE_FUTURE_READY
+		       ? future->texture
+		       : 0;
+}
+
+void odc_texture_future_get_size(struct texture_future *future, int *width,
+				 int *height)
+{
+	*width = future->width;
+	*height = future->height;
+}
+
+void odc_texture_future_release(struct texture_future *future)
+{
+	if (future)
+		future->released = 1;
+}
@@ -0,0 +1,181 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "odc_cache.h"
+
+#define FNV_PRIME 0x100000001b3ull
+
+static char cache_dir[MAX_CACHE_PATH];
+static int cache_dir_ready = 0;
+
+static int make_dirs(char *path)
+{
+	for (char *p = path + 1; *p; ++p) {
+		if (*p != '/')
+			continue;
+		*p = '\0';
+		int result = mkdir(path, 0755);
+		*p = '/';
+		if (result != 0 && errno != EEXIST)
+			return -1;
+	}
+
+	if (mkdir(path, 0755) != 0 && errno != EEXIST)
+		return -1;
+	return 0;
+}
+
+const char *odc_cache_get_dir(void)
+{
+	if (cache_dir_ready)
+		return cache_dir[0] ? cache_dir : NULL;
+
+	const char *dir = getenv("ODC_CACHE_DIR");
+	const char *xdg = getenv("XDG_CACHE_HOME");
+	const char *home = getenv("HOME");
+	int written = -1;
+
+	if (dir && dir[0])
+		written = snprintf(cache_dir, sizeof(cache_dir), "%s", dir);
+	else if (xdg && xdg[0])
+		written = snprintf(cache_dir, sizeof(cache_dir), "%s/odc", xdg);
+	else if (home && home[0])
+		written = snprintf(cache_dir, sizeof(cache_dir),
+				   "%s/.cache/odc", home);
+
+	cache_dir_ready = 1;
+	if (written <= 0 || written >= (int)sizeof(cache_dir) ||
+	    make_dirs(cache_dir) != 0) {
+		cache_dir[0] = '\0';
+		return NULL;
+	}
+
+	return cache_dir;
+}
+
+void odc_cache_set_dir(const char *path)
+{
+	cache_dir_ready = 1;
+	if (!path ||
+	    snprintf(cache_dir, sizeof(cache_dir), "%s", path) >=
+		    (int)sizeof(cache_dir) ||
+	    make_dirs(cache_dir) != 0) {
+		fprintf(stderr, "ERROR::CACHE: Cache directory unavailable\n");
+		cache_dir[0] = '\0';
+	}
+}
+
+int odc_cache_get_path(const char *name, char *path, size_t size)
+{
+	const char *dir = odc_cache_get_dir();
+	if (!dir)
+		return -1;
+
+	int written = snprintf(path, size, "%s/%s", dir, name);
+	return written > 0 && (size_t)written < size ? 0 : -1;
+}
+
+uint64_t odc_cache_hash(uint64_t seed, const void *data, size_t size)
+{
+	const unsigned char *bytes = (const unsigned char *)data;
+	uint64_t hash = seed;
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= bytes[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+uint64_t odc_cache_hash_string(uint64_t seed, const char *string)
+{
+	// Hash the terminator too so ("ab", "c") and ("a", "bc") differ
+	return string ? odc_cache_hash(seed, string, strlen(string) + 1)
+		      : odc_cache_hash(seed, "", 1);
+}
+
+void *odc_cache_read(const char *name, size_t *size)
+{
+	char path[MAX_CACHE_PATH];
+	if (odc_cache_get_path(name, path, sizeof(path)) != 0)
+		return NULL;
+
+	FILE *file = fopen(path, "rb");
+	if (!file)
+		return NULL;
+
+	fseek(file, 0, SEEK_END);
+	long length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	void *data = length > 0 ? malloc(length) : NULL;
+	if (!data || fread(data, 1, length, file) != (size_t)length) {
+		free(data);
+		fclose(file);
+		return NULL;
+	}
+
+	fclose(file);
+	*size = (size_t)length;
+	return data;
+}
+
+const void *odc_cache_map(const char *name, size_t *size)
+{
+	char path[MAX_CACHE_PATH];
+	if (odc_cache_get_path(name, path, sizeof(path)) != 0)
+		return NULL;
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	struct stat info;
+	void *data = MAP_FAILED;
+	if (fstat(fd, &info) == 0 && info.st_size > 0)
+		data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE,
+			    fd, 0);
+	// The mapping outlives the descriptor
+	close(fd);
+	if (data == MAP_FAILED)
+		return NULL;
+
+	*size = (size_t)info.st_size;
+	return data;
+}
+
+void odc_cache_unmap(const void *data, size_t size)
+{
+	if (data)
+		munmap((void *)data, size);
+}
+
+int odc_cache_write(const char *name, const void *data, size_t size)
+{
+	char path[MAX_CACHE_PATH];
+	char tmp_path[MAX_CACHE_PATH + 16];
+	if (odc_cache_get_path(name, path, sizeof(path)) != 0)
+		return -1;
+	snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", path, (int)getpid());
+
+	FILE *file = fopen(tmp_path, "wb");
+	if (!file) {
+		fprintf(stderr, "ERROR::CACHE: Failed to write %s\n", tmp_path);
+		return -1;
+	}
+
+	int ok = fwrite(data, 1, size, file) == size;
+	ok = fclose(file) == 0 && ok;
+	if (!ok || rename(tmp_path, path) != 0) {
+		fprintf(stderr, "ERROR::CACHE: Failed to write %s\n", path);
+		remove(tmp_path);
+		return -1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,472 @@
+#include "glad.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "odc_canvas.h"
+#include "odc_gl_state.h"
+#include "odc_renderer.h"
+#include "odc_texture_manager.h"
+
+struct dirty_rect {
+	int x0, y0;
+	int x1, y1;
+};
+
+struct canvas {
+	int width;
+	int height;
+	uint32_t *pixels;
+	GLuint texture;
+	struct texture_manager *textures;
+	GLuint pbo[2];
+	int pbo_index;
+	struct dirty_rect dirty[MAX_DIRTY_RECTS];
+	int dirty_count;
+};
+
+static int min_int(int a, int b)
+{
+	return a < b ? a : b;
+}
+
+static int max_int(int a, int b)
+{
+	return a > b ? a : b;
+}
+
+static int clip_rect(struct canvas *canvas, int *x, int *y, int *width,
+		     int *height)
+{
+	int x0 = max_int(*x, 0);
+	int y0 = max_int(*y, 0);
+	int x1 = min_int(*x + *width, canvas->width);
+	int y1 = min_int(*y + *height, canvas->height);
+
+	if (x0 >= x1 || y0 >= y1)
+		return 0;
+
+	*x = x0;
+	*y = y0;
+	*width = x1 - x0;
+	*height = y1 - y0;
+	return 1;
+}
+
+static int rects_touch(const struct dirty_rect *a, const struct dirty_rect *b)
+{
+	return a->x0 <= b->x1 && b->x0 <= a->x1 && a->y0 <= b->y1 &&
+	       b->y0 <= a->y1;
+}
+
+static void merge_rect(struct dirty_rect *dst, const struct dirty_rect *src)
+{
+	dst->x0 = min_int(dst->x0, src->x0);
+	dst->y0 = min_int(dst->y0, src->y0);
+	dst->x1 = max_int(dst->x1, src->x1);
+	dst->y1 = max_int(dst->y1, src->y1);
+}
+
+static void add_dirty_rect(struct canvas *canvas, int x, int y, int width,
+			   int height)
+{
+	struct dirty_rect rect = {x, y, x + width, y + height};
+
+	// Absorb every rect the new one touches, starting over as it grows,
+	// so the rects stay disjoint and no pixel is uploaded twice
+	for (int i = 0; i < canvas->dirty_count;) {
+		if (rects_touch(&canvas->dirty[i], &rect)) {
+			merge_rect(&rect, &canvas->dirty[i]);
+			canvas->dirty[i] = canvas->dirty[--canvas->dirty_count];
+			i = 0;
+		} else {
+			++i;
+		}
+	}
+
+	if (canvas->dirty_count == MAX_DIRTY_RECTS) {
+		// Out of slots, collapse everything into one bounding box
+		for (int i = 1; i < canvas->dirty_count; ++i)
+			merge_rect(&canvas->dirty[0], &canvas->dirty[i]);
+		merge_rect(&canvas->dirty[0], &rect);
+		canvas->dirty_count = 1;
+		return;
+	}
+
+	canvas->dirty[canvas->dirty_count++] = rect;
+}
+
+static void fill_span(uint32_t *dst, int count, uint32_t color)
+{
+	int i = 0;
+#ifdef __SSE2__
+	__m128i c = _mm_set1_epi32((int)color);
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_si128((__m128i *)(dst + i), c);
+#endif
+	for (; i < count; ++i)
+		dst[i] = color;
+}
+
+static uint32_t blend_pixel(uint32_t src, uint32_t dst)
+{
+	uint32_t a = src >> 24;
+	if (a == 255)
+		return src;
+	if (a == 0)
+		return dst;
+
+	uint32_t ia = 255 - a;
+	uint32_t out = 0;
+	for (int shift = 0; shift < 24; shift += 8) {
+		uint32_t s = (src >> shift) & 0xff;
+		uint32_t d = (dst >> shift) & 0xff;
+		uint32_t v = s * a + d * ia + 128;
+		out |= ((v + (v >> 8)) >> 8) << shift;
+	}
+	uint32_t da = dst >> 24;
+	uint32_t v = 255 * a + da * ia + 128;
+	out |= ((v + (v >> 8)) >> 8) << 24;
+	return out;
+}
+
+#ifdef __SSE2__
+// Blends two pixels held as 16-bit lanes; the source alpha lane is forced to
+// 255 so the result alpha comes out as sa + da * (1 - sa).
+static __m128i blend_pixels_16(__m128i s, __m128i d)
+{
+	__m128i a = _mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3));
+	a = _mm_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+	__m128i ia = _mm_sub_epi16(_mm_set1_epi16(255), a);
+	s = _mm_or_si128(s, _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0));
+
+	__m128i v = _mm_add_epi16(_mm_mullo_epi16(s, a),
+				  _mm_mullo_epi16(d, ia));
+	v = _mm_add_epi16(v, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(v, _mm_srli_epi16(v, 8)), 8);
+}
+#endif
+
+static void blend_span(uint32_t *dst, const uint32_t *src, int count)
+{
+	int i = 0;
+#ifdef __SSE2__
+	__m128i zero = _mm_setzero_si128();
+	for (; i + 4 <= count; i += 4) {
+		__m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+		__m128i lo = blend_pixels_16(_mm_unpacklo_epi8(s, zero),
+					     _mm_unpacklo_epi8(d, zero));
+		__m128i hi = blend_pixels_16(_mm_unpackhi_epi8(s, zero),
+					     _mm_unpackhi_epi8(d, zero));
+		_mm_storeu_si128((__m128i *)(dst + i),
+				 _mm_packus_epi16(lo, hi));
+	}
+#endif
+	for (; i < count; ++i)
+		dst[i] = blend_pixel(src[i], dst[i]);
+}
+
+struct canvas *odc_canvas_new(struct renderer *renderer, int width, int height)
+{
+	if (!renderer || width <= 0 || height <= 0) {
+		fprintf(stderr, "ERROR::CANVAS: Invalid canvas parameters\n");
+		return NULL;
+	}
+
+	struct canvas *canvas = (struct canvas *)calloc(1, sizeof(*canvas));
+	if (!canvas) {
+		fprintf(stderr, "ERROR::CANVAS: Failed to allocate canvas\n");
+		return NULL;
+	}
+
+	canvas->width = width;
+	canvas->height = height;
+	canvas->pixels =
+		(uint32_t *)calloc((size_t)width * height, sizeof(uint32_t));
+	if (!canvas->pixels) {
+		fprintf(stderr,
+			"ERROR::CANVAS: Failed to allocate pixel buffer\n");
+		free(canvas);
+		return NULL;
+	}
+
+	canvas->texture = odc_renderer_upload_texture(
+		renderer, (const unsigned char *)canvas->pixels, width, height);
+	if (!canvas->texture) {
+		free(canvas->pixels);
+		free(canvas);
+		return NULL;
+	}
+	canvas->textures = odc_renderer_get_texture_manager(renderer);
+
+	glGenBuffers(2, canvas->pbo);
+	for (int i = 0; i < 2; ++i) {
+		odc_gl_state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, canvas->pbo[i]);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER,
+			     (GLsizeiptr)width * height * sizeof(uint32_t),
+			     NULL, GL_STREAM_DRAW);
+	}
+	odc_gl_state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	return canvas;
+}
+
+void odc_canvas_destroy(struct canvas *canvas)
+{
+	if (!canvas)
+		return;
+
+	odc_texture_manager_remove(canvas->textures, canvas->texture);
+	odc_gl_state_delete_buffers(2, canvas->pbo);
+	free(canvas->pixels);
+	free(canvas);
+}
+
+uint32_t *odc_canvas_get_pixels(struct canvas *canvas)
+{
+	return canvas->pixels;
+}
+
+GLuint odc_canvas_get_texture(struct canvas *canvas)
+{
+	return canvas->texture;
+}
+
+int odc_canvas_get_width(struct canvas *canvas)
+{
+	return canvas->width;
+}
+
+int odc_canvas_get_height(struct canvas *canvas)
+{
+	return canvas->height;
+}
+
+void odc_canvas_mark_dirty(struct canvas *canvas, int x, int y, int width,
+			   int height)
+{
+	if (clip_rect(canvas, &x, &y, &width, &height))
+		add_dirty_rect(canvas, x, y, width, height);
+}
+
+void odc_canvas_clear(struct canvas *canvas, uint32_t color)
+{
+	fill_span(canvas->pixels, canvas->width * canvas->height, color);
+	canvas->dirty_count = 0;
+	add_dirty_rect(canvas, 0, 0, canvas->width, canvas->height);
+}
+
+void odc_canvas_set_pixel(struct canvas *canvas, int x, int y, uint32_t color)
+{
+	if (x < 0 || y < 0 || x >= canvas->width || y >= canvas->height)
+		return;
+
+	canvas->pixels[y * canvas->width + x] = color;
+	add_dirty_rect(canvas, x, y, 1, 1);
+}
+
+void odc_canvas_fill_rect(struct canvas *canvas, int x, int y, int width,
+			  int height, uint32_t color)
+{
+	if (!clip_rect(canvas, &x, &y, &width, &height))
+		return;
+
+	for (int row = y; row < y + height; ++row)
+		fill_span(&canvas->pixels[row * canvas->width + x], width,
+			  color);
+
+	add_dirty_rect(canvas, x, y, width, height);
+}
+
+static void fill_run(struct canvas *canvas, int x0, int x1, int y,
+		     uint32_t color)
+{
+	if (y < 0 || y >= canvas->height)
+		return;
+
+	x0 = max_int(x0, 0);
+	x1 = min_int(x1, canvas->width - 1);
+	if (x0 <= x1)
+		fill_span(&canvas->pixels[y * canvas->width + x0], x1 - x0 + 1,
+			  color);
+}
+
+void odc_canvas_draw_line(struct canvas *canvas, int x0, int y0, int x1,
+			  int y1, uint32_t color)
+{
+	int min_x = min_int(x0, x1);
+	int min_y = min_int(y0, y1);
+	int bounds_w = abs(x1 - x0) + 1;
+	int bounds_h = abs(y1 - y0) + 1;
+	if (!clip_rect(canvas, &min_x, &min_y, &bounds_w, &bounds_h))
+		return;
+
+	int dx = abs(x1 - x0);
+	int dy = -abs(y1 - y0);
+	int sx = x0 < x1 ? 1 : -1;
+	int sy = y0 < y1 ? 1 : -1;
+	int err = dx + dy;
+
+	// Bresenham, but each row's pixels are written as one run, so shallow
+	// lines go through the SIMD span fill
+	int run_x = x0;
+	for (;;) {
+		int done = x0 == x1 && y0 == y1;
+		int next_x = x0;
+		int next_y = y0;
+		if (!done) {
+			int e2 = 2 * err;
+			if (e2 >= dy) {
+				err += dy;
+				next_x += sx;
+			}
+			if (e2 <= dx) {
+				err += dx;
+				next_y += sy;
+			}
+		}
+
+		if (done || next_y != y0) {
+			fill_run(canvas, min_int(run_x, x0), max_int(run_x, x0),
+				 y0, color);
+			run_x = next_x;
+		}
+		if (done)
+			break;
+		x0 = next_x;
+		y0 = next_y;
+	}
+
+	add_dirty_rect(canvas, min_x, min_y, bounds_w, bounds_h);
+}
+
+void odc_canvas_blit(struct canvas *canvas, const uint32_t *src,
+		     int src_width, int src_height, int src_stride, int x,
+		     int y)
+{
+	int dst_x = x, dst_y = y, width = src_width, height = src_height;
+	if (!clip_rect(canvas, &dst_x, &dst_y, &width, &height))
+		return;
+
+	const uint32_t *src_row =
+		src + (size_t)(dst_y - y) * src_stride + (dst_x - x);
+	for (int row = 0; row < height; ++row) {
+		memcpy(&canvas->pixels[(dst_y + row) * canvas->width + dst_x],
+		       src_row, (size_t)width * sizeof(uint32_t));
+		src_row += src_stride;
+	}
+
+	add_dirty_rect(canvas, dst_x, dst_y, width, height);
+}
+
+void odc_canvas_blit_alpha(struct canvas *canvas, const uint32_t *src,
+			   int src_width, int src_height, int src_stride,
+			   int x, int y)
+{
+	int dst_x = x, dst_y = y, width = src_width, height = src_height;
+	if (!clip_rect(canvas, &dst_x, &dst_y, &width, &height))
+		return;
+
+	const uint32_t *src_row =
+		src + (size_t)(dst_y - y) * src_stride + (dst_x - x);
+	for (int row = 0; row < height; ++row) {
+		blend_span(&canvas->pixels[(dst_y + row) * canvas->width +
+					   dst_x],
+			   src_row, width);
+		src_row += src_stride;
+	}
+
+	add_dirty_rect(canvas, dst_x, dst_y, width, height);
+}
+
+void odc_canvas_flush(struct canvas *canvas)
+{
+	if (canvas->dirty_count == 0)
+		return;
+
+	// An evicted canvas is reloaded before the dirty rects are written
+	// over it, and the manager's copy is dropped since they bypass it
+	if (odc_texture_manager_update(canvas->textures, canvas->texture, 0, 0,
+				       canvas->width, canvas->height,
+				       NULL) != 0)
+		return;
+
+	size_t total = 0;
+	for (int i = 0; i < canvas->dirty_count; ++i) {
+		struct dirty_rect *r = &canvas->dirty[i];
+		total += (size_t)(r->x1 - r->x0) * (r->y1 - r->y0);
+	}
+	total *= sizeof(uint32_t);
+
+	// Alternate between two PBOs and orphan the one we write so the copy
+	// never waits on a transfer the GPU is still reading from
+	GLuint pbo = canvas->pbo[canvas->pbo_index];
+	canvas->pbo_index ^= 1;
+
+	odc_gl_state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER,
+		     (GLsizeiptr)canvas->width * canvas->height *
+			     sizeof(uint32_t),
+		     NULL, GL_STREAM_DRAW);
+	unsigned char *dst = (unsigned char *)glMapBufferRange(
+		GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)total,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (!dst) {
+		fprintf(stderr, "ERROR::CANVAS: Failed to map upload buffer\n");
+		odc_gl_state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return;
+	}
+
+	size_t offsets[MAX_DIRTY_RECTS];
+	size_t offset = 0;
+	for (int i = 0; i < canvas->dirty_count; ++i) {
+		struct dirty_rect *r = &canvas->dirty[i];
+		size_t row_bytes = (size_t)(r->x1 - r->x0) * sizeof(uint32_t);
+		offsets[i] = offset;
+		for (int row = r->y0; row < r->y1; ++row) {
+			memcpy(dst + offset,
+			       &canvas->pixels[row * canvas->width + r->x0],
+			       row_bytes);
+			offset += row_bytes;
+		}
+	}
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+	odc_gl_state_bind_texture(GL_TEXTURE_2D, canvas->texture);
+	for (int i = 0; i < canvas->dirty_count; ++i) {
+		struct dirty_rect *r = &canvas->dirty[i];
+		glTexSubImage2D(GL_TEXTURE_2D, 0, r->x0, r->y0, r->x1 - r->x0,
+				r->y1 - r->y0, GL_RGBA, GL_UNSIGNED_BYTE,
+				(const void *)offsets[i]);
+	}
+	odc_gl_state_bind_texture(GL_TEXTURE_2D, 0);
+	odc_gl_state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	canvas->dirty_count = 0;
+}
+
+void odc_canvas_draw(struct canvas *canvas, struct renderer *renderer, float x,
+		     float y, float scale, int screen_width, int screen_height)
+{
+	odc_canvas_flush(canvas);
+
+	struct texture_render_options options = {
+		.x = x,
+		.y = y,
+		.width = (float)canvas->width,
+		.height = (float)canvas->height,
+		.rect_width = (float)canvas->width,
+		.rect_height = (float)canvas->height,
+		.screen_width = screen_width,
+		.screen_height = screen_height,
+		.flip_y = 1,
+		.scale = scale,
+	};
+	odc_renderer_add_texture(renderer, canvas->texture, &options);
+}
@@ -1,10 +1,72 @@
+#include "glad.h"
+
+#include <stdio.h>
+
+#include "odc_debug.h"
+#include "odc_gl_state.h"
+#include "odc_gpu_timer.h"
 #include "odc_renderer.h"
+#include "odc_shader.h"
 
 #define MAX_FRAME_TIMES 100
+#define TIMING_BAR_HEIGHT 6.0f
+#define TIMING_FULL_SCALE_MS 20.0f
+#define OVERDRAW_READBACKS 3
+#define STRINGIFY(x) #x
+#define TO_STRING(x) STRINGIFY(x)
+
+struct overdraw_view {
+	GLuint count_framebuffer;
+	GLuint count_texture;
+	GLuint depth;
+	GLuint heatmap_framebuffer;
+	GLuint heatmap_texture;
+	GLuint program;
+	GLuint vertex_array;
+	// Counts are read into a pixel buffer behind a fence and summed once
+	// the fence has signaled, so the stats never stall the frame
+	GLuint readback[OVERDRAW_READBACKS];
+	GLsync fences[OVERDRAW_READBACKS];
+	int readback_index;
+	int width;
+	int height;
+	struct overdraw_stats stats;
+};
 
 static float frameTimes[MAX_FRAME_TIMES];
 static int frameTimeIndex = 0;
 static double last_delta_time = 0.0;
+static struct overdraw_view overdraw;
+
+static const char *heatmapVertexSource =
+	"#version 330 core\n"
+	"void main() {\n"
+	"    vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+	"    gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);\n"
+	"}\n";
+
+static const char *heatmapFragmentSource =
+	"#version 330 core\n"
+	"uniform sampler2D count_sampler;\n"
+	"out vec4 fragColor;\n"
+	"void main() {\n"
+	"    float n = texelFetch(count_sampler, ivec2(gl_FragCoord.xy), "
+	"0).r;\n"
+	"    if (n < 0.5) {\n"
+	"        fragColor = vec4(0.0);\n"
+	"        return;\n"
+	"    }\n"
+	"    float t = clamp((n - 1.0) / (" TO_STRING(OVERDRAW_RAMP_LAYERS)
+	".0 - 1.0), 0.0, 1.0) * 3.0;\n"
+	"    vec3 c = mix(vec3(0.0, 0.2, 1.0), vec3(0.0, 1.0, 0.0), "
+	"clamp(t, 0.0, 1.0));\n"
+	"    c = mix(c, vec3(1.0, 1.0, 0.0), clamp(t - 1.0, 0.0, 1.0));\n"
+	"    c = mix(c, vec3(1.0, 0.0, 0.0), clamp(t - 2.0, 0.0, 1.0));\n"
+	"    if (n > " TO_STRING(OVERDRAW_RAMP_LAYERS) ".5) {\n"
+	"        c = vec3(1.0);\n"
+	"    }\n"
+	"    fragColor = vec4(c, 0.75);\n"
+	"}\n";
 
 float odc_debug_calculate_average_frame_time()
 {
@@ -61,3 +123,307 @@ void odc_debug_render_frame_time_graph(struct renderer *renderer,
 					     screen_height, color);
 	}
 }
+
+static void add_timing_row(struct renderer *renderer, int row, int depth,
+			   double gpu_ms, double cpu_ms, int screen_width,
+			   int screen_height)
+{
+	static float gpu_color[4] = {0.2f, 0.8f, 0.3f, 1.0f};
+	static float cpu_color[4] = {0.6f, 0.6f, 0.6f, 1.0f};
+	float scale = (float)screen_width * 0.5f / TIMING_FULL_SCALE_MS;
+	float x = 4.0f + depth * 8.0f;
+	float y = 4.0f + row * (TIMING_BAR_HEIGHT * 2.0f + 2.0f);
+
+	if (gpu_ms > 0.0)
+		add_rectangle_with_triangles(renderer, x, y,
+					     (float)gpu_ms * scale,
+					     TIMING_BAR_HEIGHT, screen_width,
+					     screen_height, gpu_color);
+	if (cpu_ms > 0.0)
+		add_rectangle_with_triangles(renderer, x, y + TIMING_BAR_HEIGHT,
+					     (float)cpu_ms * scale,
+					     TIMING_BAR_HEIGHT, screen_width,
+					     screen_height, cpu_color);
+}
+
+void odc_debug_render_gpu_timings(struct renderer *renderer,
+				  int screen_width, int screen_height)
+{
+	struct gpu_timer *timer = odc_renderer_get_gpu_timer(renderer);
+	if (!timer)
+		return;
+
+	add_timing_row(renderer, 0, 0, odc_gpu_timer_get_gpu_frame_time(timer),
+		       odc_gpu_timer_get_cpu_frame_time(timer), screen_width,
+		       screen_height);
+
+	const struct gpu_timer_section *sections;
+	int count = odc_gpu_timer_get_sections(timer, &sections);
+	for (int i = 0; i < count; ++i)
+		add_timing_row(renderer, i + 1, sections[i].depth + 1,
+			       sections[i].gpu_ms, sections[i].cpu_ms,
+			       screen_width, screen_height);
+}
+
+static void release_overdraw_targets(void)
+{
+	if (overdraw.count_framebuffer)
+		glDeleteFramebuffers(1, &overdraw.count_framebuffer);
+	if (overdraw.heatmap_framebuffer)
+		glDeleteFramebuffers(1, &overdraw.heatmap_framebuffer);
+	if (overdraw.depth)
+		glDeleteRenderbuffers(1, &overdraw.depth);
+	if (overdraw.count_texture)
+		odc_gl_state_delete_textures(1, &overdraw.count_texture);
+	if (overdraw.heatmap_texture)
+		odc_gl_state_delete_textures(1, &overdraw.heatmap_texture);
+	for (int i = 0; i < OVERDRAW_READBACKS; ++i) {
+		if (overdraw.fences[i])
+			glDeleteSync(overdraw.fences[i]);
+		if (overdraw.readback[i])
+			glDeleteBuffers(1, &overdraw.readback[i]);
+		overdraw.fences[i] = NULL;
+		overdraw.readback[i] = 0;
+	}
+
+	overdraw.count_framebuffer = 0;
+	overdraw.heatmap_framebuffer = 0;
+	overdraw.depth = 0;
+	overdraw.count_texture = 0;
+	overdraw.heatmap_texture = 0;
+	overdraw.readback_index = 0;
+	overdraw.width = 0;
+	overdraw.height = 0;
+}
+
+static GLuint new_target_texture(GLenum internal_format, GLenum format,
+				 GLenum type, int width, int height)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+	odc_gl_state_bind_texture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0,
+		     format, type, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return texture;
+}
+
+static int create_overdraw_targets(int width, int height)
+{
+	release_overdraw_targets();
+
+	glGenBuffers(OVERDRAW_READBACKS, overdraw.readback);
+	for (int i = 0; i < OVERDRAW_READBACKS; ++i) {
+		odc_gl_state_bind_buffer(GL_PIXEL_PACK_BUFFER,
+					 overdraw.readback[i]);
+		glBufferData(GL_PIXEL_PACK_BUFFER,
+			     (GLsizeiptr)sizeof(float) * width * height, NULL,
+			     GL_STREAM_READ);
+	}
+	odc_gl_state_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	// A float target so counts don't saturate at 255 layers
+	overdraw.count_texture =
+		new_target_texture(GL_R16F, GL_RED, GL_FLOAT, width, height);
+	overdraw.heatmap_texture = new_target_texture(
+		GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+
+	// Depth lets the renderer's opaque pass reject hidden fragments
+	// exactly as it does on screen
+	glGenRenderbuffers(1, &overdraw.depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, overdraw.depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width,
+			      height);
+
+	glGenFramebuffers(1, &overdraw.count_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, overdraw.count_framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+			       GL_TEXTURE_2D, overdraw.count_texture, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+				  GL_RENDERBUFFER, overdraw.depth);
+	int complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) ==
+		       GL_FRAMEBUFFER_COMPLETE;
+
+	glGenFramebuffers(1, &overdraw.heatmap_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, overdraw.heatmap_framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+			       GL_TEXTURE_2D, overdraw.heatmap_texture, 0);
+	complete = complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) ==
+				       GL_FRAMEBUFFER_COMPLETE;
+
+	if (!complete) {
+		fprintf(stderr, "ERROR::DEBUG: Overdraw targets are "
+				"incomplete\n");
+		release_overdraw_targets();
+		return -1;
+	}
+
+	overdraw.width = width;
+	overdraw.height = height;
+	return 0;
+}
+
+static int create_heatmap_program(void)
+{
+	char error[MAX_SHADER_ERROR] = {0};
+	overdraw.program = odc_shader_new_program(heatmapVertexSource,
+						  heatmapFragmentSource, error);
+	if (!overdraw.program) {
+		fprintf(stderr, "ERROR::DEBUG: Heatmap shader failed: %s\n",
+			error);
+		return -1;
+	}
+
+	odc_gl_state_use_program(overdraw.program);
+	glUniform1i(glGetUniformLocation(overdraw.program, "count_sampler"),
+		    0);
+	glGenVertexArrays(1, &overdraw.vertex_array);
+	return 0;
+}
+
+// Skips the frame when every buffer is still waiting on the GPU
+static void queue_overdraw_readback(void)
+{
+	int slot = overdraw.readback_index;
+	if (overdraw.fences[slot])
+		return;
+
+	odc_gl_state_bind_buffer(GL_PIXEL_PACK_BUFFER, overdraw.readback[slot]);
+	glReadPixels(0, 0, overdraw.width, overdraw.height, GL_RED, GL_FLOAT,
+		     (void *)0);
+	odc_gl_state_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+	overdraw.fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	overdraw.readback_index = (slot + 1) % OVERDRAW_READBACKS;
+}
+
+static void sum_overdraw_readback(int slot)
+{
+	size_t count = (size_t)overdraw.width * overdraw.height;
+	odc_gl_state_bind_buffer(GL_PIXEL_PACK_BUFFER, overdraw.readback[slot]);
+	const float *counts = (const float *)glMapBufferRange(
+		GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)(sizeof(float) * count),
+		GL_MAP_READ_BIT);
+	if (!counts) {
+		fprintf(stderr, "ERROR::DEBUG: Failed to map overdraw "
+				"readback\n");
+		odc_gl_state_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+		return;
+	}
+
+	double sum = 0.0;
+	float max = 0.0f;
+	for (size_t i = 0; i < count; ++i) {
+		sum += counts[i];
+		if (counts[i] > max)
+			max = counts[i];
+	}
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	odc_gl_state_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	overdraw.stats.average = (float)(sum / count);
+	overdraw.stats.max = max;
+}
+
+// Polls the queued readbacks oldest first without waiting. One that hasn't
+// landed keeps its fence and is tried again on the next call.
+static void read_overdraw_stats(void)
+{
+	for (int i = 0; i < OVERDRAW_READBACKS; ++i) {
+		int slot = (overdraw.readback_index + i) % OVERDRAW_READBACKS;
+		if (!overdraw.fences[slot])
+			continue;
+
+		GLenum status = glClientWaitSync(overdraw.fences[slot],
+						 GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		if (status != GL_ALREADY_SIGNALED &&
+		    status != GL_CONDITION_SATISFIED)
+			return;
+
+		glDeleteSync(overdraw.fences[slot]);
+		overdraw.fences[slot] = NULL;
+		sum_overdraw_readback(slot);
+	}
+}
+
+int odc_debug_render_overdraw(struct renderer *renderer, int screen_width,
+			      int screen_height, struct overdraw_stats *stats)
+{
+	GLint viewport[4];
+	GLint framebuffer;
+	GLfloat clear_color[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, clear_color);
+
+	int width = viewport[2];
+	int height = viewport[3];
+	if (width <= 0 || height <= 0)
+		return -1;
+	if (!overdraw.program && create_heatmap_program() != 0)
+		return -1;
+	if ((width != overdraw.width || height != overdraw.height) &&
+	    create_overdraw_targets(width, height) != 0) {
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		return -1;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, overdraw.count_framebuffer);
+	glViewport(0, 0, width, height);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	odc_renderer_set_overdraw_mode(renderer, 1);
+	odc_renderer_redraw(renderer);
+	odc_renderer_set_overdraw_mode(renderer, 0);
+	read_overdraw_stats();
+	queue_overdraw_readback();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, overdraw.heatmap_framebuffer);
+	odc_gl_state_set_blend(0, GL_ONE, GL_ZERO);
+	odc_gl_state_use_program(overdraw.program);
+	odc_gl_state_bind_vertex_array(overdraw.vertex_array);
+	odc_gl_state_bind_texture_unit(0, GL_TEXTURE_2D,
+				       overdraw.count_texture);
+	odc_gl_state_bind_sampler(0, 0);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	glClearColor(clear_color[0], clear_color[1], clear_color[2],
+		     clear_color[3]);
+	odc_gl_state_set_blend(1, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	// Queued last so it covers the frame without counting itself
+	struct texture_render_options options = {0};
+	options.width = (float)width;
+	options.height = (float)height;
+	options.rect_width = (float)width;
+	options.rect_height = (float)height;
+	options.screen_width = screen_width;
+	options.screen_height = screen_height;
+	options.scale = (float)screen_width / (float)width;
+	odc_renderer_add_texture(renderer, overdraw.heatmap_texture, &options);
+
+	if (stats)
+		*stats = overdraw.stats;
+	return 0;
+}
+
+struct overdraw_stats odc_debug_get_overdraw_stats(void)
+{
+	return overdraw.stats;
+}
+
+void odc_debug_release_overdraw(void)
+{
+	release_overdraw_targets();
+	if (overdraw.program)
+		odc_gl_state_delete_program(overdraw.program);
+	if (overdraw.vertex_array)
+		odc_gl_state_delete_vertex_arrays(1, &overdraw.vertex_array);
+	overdraw.program = 0;
+	overdraw.vertex_array = 0;
+}
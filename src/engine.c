@@ -1,12 +1,23 @@
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
 #include "glad.h"
 #include <GLFW/glfw3.h>
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "odc_engine.h"
+#include "odc_frame_capture.h"
+#include "odc_gl_state.h"
+#include "odc_image.h"
 #include "odc_input.h"
+#include "odc_render_target.h"
 #include "odc_renderer.h"
+#include "odc_shader.h"
+#include "odc_video_capture.h"
+
+#define HEADLESS_TIME_STEP (1.0 / 60.0)
 
 struct engine {
 	GLFWwindow *window;
@@ -19,11 +30,23 @@ struct engine {
 	int fps;
 	GLFWmonitor *monitor;
 	const GLFWvidmode *original_vidmode;
+	int headless;
+	EGLDisplay egl_display;
+	EGLContext egl_context;
+	GLuint framebuffer;
+	GLuint color_buffer;
+	GLuint depth_buffer;
+	double time;
+	char *capture_path;
+	struct video_capture *recording;
 };
 
 static void framebuffer_size_callback(GLFWwindow *window, int width, int height)
 {
+	struct engine *e = (struct engine *)glfwGetWindowUserPointer(window);
 	glViewport(0, 0, width, height);
+	if (e && e->renderer)
+		odc_renderer_set_viewport_size(e->renderer, width, height);
 }
 
 static void set_default_window_size(struct engine *e, int width, int height)
@@ -95,7 +118,13 @@ struct engine *odc_engine_new(int width, int height, int fullscreen)
 		return NULL;
 	}
 
+	odc_shader_load_extensions((GLADloadfunc)glfwGetProcAddress);
+	// The state cache is process wide and may still describe a context
+	// from an earlier engine
+	odc_gl_state_invalidate();
+
 	glViewport(0, 0, e->window_width, e->window_height);
+	glfwSetWindowUserPointer(e->window, e);
 	glfwSetFramebufferSizeCallback(e->window, framebuffer_size_callback);
 
 	e->renderer = odc_renderer_new();
@@ -108,17 +137,209 @@ struct engine *odc_engine_new(int width, int height, int fullscreen)
 	}
 	odc_renderer_init(e->renderer);
 
+	GLint depth_type = GL_NONE;
+	glGetFramebufferAttachmentParameteriv(
+		GL_DRAW_FRAMEBUFFER, GL_DEPTH,
+		GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE, &depth_type);
+	odc_renderer_set_output_depth(e->renderer, depth_type != GL_NONE);
+
+	int framebuffer_width, framebuffer_height;
+	glfwGetFramebufferSize(e->window, &framebuffer_width,
+			       &framebuffer_height);
+	odc_renderer_set_viewport_size(e->renderer, framebuffer_width,
+				       framebuffer_height);
+
 	e->fps = 0;
 
 	return e;
 }
 
+static void destroy_offscreen_framebuffer(struct engine *e)
+{
+	if (e->framebuffer) {
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDeleteFramebuffers(1, &e->framebuffer);
+	}
+	if (e->color_buffer) {
+		glDeleteRenderbuffers(1, &e->color_buffer);
+	}
+	if (e->depth_buffer) {
+		glDeleteRenderbuffers(1, &e->depth_buffer);
+	}
+	e->framebuffer = 0;
+	e->color_buffer = 0;
+	e->depth_buffer = 0;
+}
+
+static int create_offscreen_framebuffer(struct engine *e)
+{
+	glGenRenderbuffers(1, &e->color_buffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, e->color_buffer);
+	glRenderbufferStorage(
+		GL_RENDERBUFFER, GL_RGBA8, e->window_width, e->window_height);
+
+	glGenRenderbuffers(1, &e->depth_buffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, e->depth_buffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24,
+		e->window_width, e->window_height);
+
+	glGenFramebuffers(1, &e->framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, e->framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+		GL_RENDERBUFFER, e->color_buffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+		GL_RENDERBUFFER, e->depth_buffer);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) !=
+		GL_FRAMEBUFFER_COMPLETE) {
+		fprintf(stderr, "Offscreen framebuffer is incomplete\n");
+		destroy_offscreen_framebuffer(e);
+		return -1;
+	}
+
+	glViewport(0, 0, e->window_width, e->window_height);
+	return 0;
+}
+
+// Mesa's surfaceless platform needs no display server and falls back to
+// llvmpipe when there is no GPU
+static int create_egl_context(struct engine *e)
+{
+	PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress(
+			"eglGetPlatformDisplayEXT");
+	if (!get_platform_display) {
+		return -1;
+	}
+
+	e->egl_display = get_platform_display(
+		EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (e->egl_display == EGL_NO_DISPLAY ||
+		!eglInitialize(e->egl_display, NULL, NULL)) {
+		return -1;
+	}
+
+	const char *extensions =
+		eglQueryString(e->egl_display, EGL_EXTENSIONS);
+	if (!extensions ||
+		!strstr(extensions, "EGL_KHR_surfaceless_context") ||
+		!eglBindAPI(EGL_OPENGL_API)) {
+		eglTerminate(e->egl_display);
+		return -1;
+	}
+
+	EGLint attributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK,
+		EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE,
+	};
+	e->egl_context = eglCreateContext(e->egl_display, EGL_NO_CONFIG_KHR,
+		EGL_NO_CONTEXT, attributes);
+	if (e->egl_context == EGL_NO_CONTEXT ||
+		!eglMakeCurrent(e->egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+			e->egl_context)) {
+		if (e->egl_context != EGL_NO_CONTEXT) {
+			eglDestroyContext(e->egl_display, e->egl_context);
+		}
+		eglTerminate(e->egl_display);
+		e->egl_context = NULL;
+		return -1;
+	}
+
+	if (!gladLoadGL((GLADloadfunc)eglGetProcAddress)) {
+		eglMakeCurrent(e->egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+			EGL_NO_CONTEXT);
+		eglDestroyContext(e->egl_display, e->egl_context);
+		eglTerminate(e->egl_display);
+		e->egl_context = NULL;
+		return -1;
+	}
+
+	odc_shader_load_extensions((GLADloadfunc)eglGetProcAddress);
+	odc_gl_state_invalidate();
+	return 0;
+}
+
+static int create_hidden_window(struct engine *e)
+{
+	if (!glfwInit()) {
+		return -1;
+	}
+
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	e->window = glfwCreateWindow(
+		e->window_width, e->window_height, "odc", NULL, NULL);
+	if (!e->window) {
+		glfwTerminate();
+		return -1;
+	}
+
+	glfwMakeContextCurrent(e->window);
+	if (!gladLoaderLoadGL()) {
+		glfwDestroyWindow(e->window);
+		glfwTerminate();
+		e->window = NULL;
+		return -1;
+	}
+
+	odc_shader_load_extensions((GLADloadfunc)glfwGetProcAddress);
+	odc_gl_state_invalidate();
+	return 0;
+}
+
+struct engine *odc_engine_new_headless(int width, int height)
+{
+	struct engine *e = (struct engine *)calloc(1, sizeof(struct engine));
+	if (!e) {
+		fprintf(stderr, "Failed to allocate memory for engine\n");
+		return NULL;
+	}
+
+	e->headless = 1;
+	set_default_window_size(e, width, height);
+
+	if (create_egl_context(e) != 0 && create_hidden_window(e) != 0) {
+		fprintf(stderr, "Failed to create a headless GL context\n");
+		free(e);
+		return NULL;
+	}
+
+	e->renderer = odc_renderer_new();
+	if (!e->renderer || create_offscreen_framebuffer(e) != 0) {
+		fprintf(stderr, "Failed to set up headless rendering\n");
+		odc_engine_destroy(e);
+		return NULL;
+	}
+	odc_renderer_init(e->renderer);
+	odc_renderer_set_viewport_size(
+		e->renderer, e->window_width, e->window_height);
+	odc_renderer_set_output_depth(e->renderer, 1);
+	odc_gl_state_set_blend(1, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	return e;
+}
+
 void odc_engine_destroy(struct engine *e)
 {
 	if (e) {
+		odc_engine_stop_recording(e);
 		if (e->renderer) {
 			odc_renderer_destroy(e->renderer);
 		}
+		if (e->headless) {
+			destroy_offscreen_framebuffer(e);
+		}
+		if (e->egl_context) {
+			eglMakeCurrent(e->egl_display, EGL_NO_SURFACE,
+				EGL_NO_SURFACE, EGL_NO_CONTEXT);
+			eglDestroyContext(e->egl_display, e->egl_context);
+			eglTerminate(e->egl_display);
+		}
 		if (e->window) {
 			glfwDestroyWindow(e->window);
 		}
@@ -128,8 +349,10 @@ void odc_engine_destroy(struct engine *e)
 				e->original_vidmode->height,
 				e->original_vidmode->refreshRate);
 		}
+		free(e->capture_path);
 		free(e);
 	}
+	odc_gl_state_invalidate();
 	glfwTerminate();
 }
 
@@ -147,8 +370,101 @@ void process_input(struct engine *e)
 	odc_input_update(e);
 }
 
+void odc_engine_render(struct engine *e)
+{
+	odc_renderer_begin_frame(e->renderer);
+	odc_renderer_set_time(e->renderer, (float)e->time);
+
+	if (e->render_callback) {
+		e->render_callback(e);
+	}
+
+	if (e->capture_path) {
+		odc_frame_capture_save(e->renderer, e->capture_path,
+			odc_engine_get_window_width(e),
+			odc_engine_get_window_height(e));
+		free(e->capture_path);
+		e->capture_path = NULL;
+	}
+
+	/*odc_renderer_clear(e->renderer, 0.1f);*/
+	odc_renderer_draw(e->renderer);
+	odc_renderer_present(e->renderer);
+	if (e->recording) {
+		odc_video_capture_frame(e->recording, e->framebuffer);
+	}
+	odc_gl_state_end_frame();
+
+	// Headless frames advance a fixed step so repeated runs match
+	if (e->headless) {
+		e->time += HEADLESS_TIME_STEP;
+	}
+}
+
+int odc_engine_capture_frame(struct engine *e, const char *path)
+{
+	char *capture_path = strdup(path);
+	if (!capture_path) {
+		fprintf(stderr, "Failed to allocate memory for capture path\n");
+		return -1;
+	}
+
+	free(e->capture_path);
+	e->capture_path = capture_path;
+	return 0;
+}
+
+int odc_engine_start_recording(struct engine *e, const char *path,
+	enum video_capture_format format)
+{
+	odc_engine_stop_recording(e);
+	e->recording = odc_video_capture_new(path, format,
+		odc_engine_get_window_width(e),
+		odc_engine_get_window_height(e), 60);
+	return e->recording ? 0 : -1;
+}
+
+void odc_engine_stop_recording(struct engine *e)
+{
+	if (e->recording) {
+		odc_video_capture_destroy(e->recording);
+		e->recording = NULL;
+	}
+}
+
+int odc_engine_read_pixels(struct engine *e, unsigned char *pixels)
+{
+	int width = odc_engine_get_window_width(e);
+	int height = odc_engine_get_window_height(e);
+
+	while (glGetError() != GL_NO_ERROR) {
+	}
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, e->framebuffer);
+	odc_gl_state_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	if (glGetError() != GL_NO_ERROR) {
+		fprintf(stderr, "Failed to read back the framebuffer\n");
+		return -1;
+	}
+
+	odc_image_flip_rows(pixels, width, height);
+	return 0;
+}
+
+int odc_engine_is_headless(struct engine *e)
+{
+	return e->headless;
+}
+
 void odc_engine_run(struct engine *e)
 {
+	if (e->headless) {
+		fprintf(stderr, "Headless engines are stepped with "
+				"odc_engine_render\n");
+		return;
+	}
+
 	odc_input_init(e->window);
 
 	double lastTime = glfwGetTime();
@@ -157,8 +473,7 @@ void odc_engine_run(struct engine *e)
 	int frameCount = 0;
 	double totalFrameTime = 0.0;
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	odc_gl_state_set_blend(1, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	while (!glfwWindowShouldClose(e->window)) {
 		double currentTime = glfwGetTime();
@@ -169,12 +484,13 @@ void odc_engine_run(struct engine *e)
 			e->update_callback(e);
 		}
 
-		if (e->render_callback) {
-			e->render_callback(e);
-		}
+		e->time = currentTime;
+		odc_engine_render(e);
 
-		/*odc_renderer_clear(e->renderer, 0.1f);*/
-		odc_renderer_draw(e->renderer);
+		struct render_target *target =
+			odc_renderer_get_render_target(e->renderer);
+		if (target)
+			odc_render_target_update(target, deltaTime);
 
 		frameCount++;
 
@@ -226,6 +542,10 @@ void odc_engine_set_window_title(struct engine *e, const char *title)
 
 int odc_engine_get_window_height(struct engine *e)
 {
+	if (e->headless) {
+		return e->window_height;
+	}
+
 	GLFWwindow *window = odc_engine_get_window(e);
 	int window_width, window_height;
 	glfwGetFramebufferSize(window, &window_width, &window_height);
@@ -234,6 +554,10 @@ int odc_engine_get_window_height(struct engine *e)
 
 int odc_engine_get_window_width(struct engine *e)
 {
+	if (e->headless) {
+		return e->window_width;
+	}
+
 	GLFWwindow *window = odc_engine_get_window(e);
 	int window_width, window_height;
 	glfwGetFramebufferSize(window, &window_width, &window_height);
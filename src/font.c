@@ -1,18 +1,197 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "odc_cache.h"
 #include "odc_font.h"
+#include "odc_gl_state.h"
 
-#define ATLAS_WIDTH 512
-#define ATLAS_HEIGHT 512
+#include FT_MODULE_H
 
-int odc_font_load(const char *font_path, struct font *font)
+#define FONT_CACHE_MAGIC "ODCA"
+#define FONT_CACHE_VERSION 1
+
+// The ASCII glyphs and the rows of page 0 they fill follow the header
+struct font_cache_header {
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	int32_t units_per_em;
+	int32_t ascender;
+	int32_t descender;
+	int32_t line_gap;
+	int32_t glyph_count;
+	int32_t rows;
+};
+
+struct font_cache_glyph {
+	int32_t width;
+	int32_t height;
+	int32_t bearing_x;
+	int32_t bearing_y;
+	int32_t advance;
+	float tex_offset_x;
+	float tex_offset_y;
+};
+
+static int font_cache_enabled = 1;
+
+// Takes ownership of atlas_bitmap
+static void set_atlas(struct font *font, unsigned char *atlas_bitmap)
 {
-	if (!font) {
-		fprintf(stderr, "ERROR::FONT: Font pointer is NULL\n");
+	// Without a loaded GL context only the software rasterizer can draw
+	// text, so the atlas is kept on the CPU alone
+	if (GLAD_GL_VERSION_3_3) {
+		if (font->atlas)
+			odc_gl_state_delete_textures(1, &font->atlas);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glGenTextures(1, &font->atlas);
+		font->texture_id = font->atlas;
+		odc_gl_state_bind_texture(GL_TEXTURE_2D, font->atlas);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, ATLAS_WIDTH,
+			     ATLAS_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE,
+			     atlas_bitmap);
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,
+				GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,
+				GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+				GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,
+				GL_LINEAR);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	}
+
+	free(font->bitmap);
+	font->bitmap = atlas_bitmap;
+	font->dirty_top = 0;
+	font->dirty_bottom = 0;
+	font->version++;
+	for (int row = 0; row < ATLAS_HEIGHT; ++row)
+		font->row_versions[row] = font->version;
+}
+
+// Glyphs are packed on shelves within a page, with a blank texel between
+// them so linear filtering doesn't pick up the neighbours
+#define GLYPH_PADDING 1
+#define GLYPH_BUCKETS (FONT_MAX_CACHED_GLYPHS * 2)
+
+static void mark_dirty(struct font *font, int top, int bottom)
+{
+	if (font->dirty_bottom <= font->dirty_top) {
+		font->dirty_top = top;
+		font->dirty_bottom = bottom;
+	} else {
+		if (top < font->dirty_top)
+			font->dirty_top = top;
+		if (bottom > font->dirty_bottom)
+			font->dirty_bottom = bottom;
+	}
+	font->version++;
+	for (int row = top; row < bottom; ++row)
+		font->row_versions[row] = font->version;
+}
+
+static int pack_glyph(struct font *font, int page, int width, int height,
+		      int *x, int *y)
+{
+	struct font_page *p = &font->pages[page];
+	if (p->shelf_x + width + GLYPH_PADDING > ATLAS_WIDTH) {
+		p->shelf_y += p->shelf_height;
+		p->shelf_x = 0;
+		p->shelf_height = 0;
+	}
+	if (p->shelf_y + height + GLYPH_PADDING > FONT_PAGE_HEIGHT)
 		return -1;
+
+	*x = p->shelf_x;
+	*y = page * FONT_PAGE_HEIGHT + p->shelf_y;
+	p->shelf_x += width + GLYPH_PADDING;
+	if (height + GLYPH_PADDING > p->shelf_height)
+		p->shelf_height = height + GLYPH_PADDING;
+	return 0;
+}
+
+// Copies the rendered glyph in the face's slot into page of bitmap. Glyphs
+// without pixels take no space and get page -1.
+static int place_glyph(struct font *font, unsigned char *bitmap, int page,
+		       struct glyph *glyph, int *glyph_page)
+{
+	FT_GlyphSlot g = font->face->glyph;
+	int x = 0;
+	int y = 0;
+
+	*glyph_page = -1;
+	if (g->bitmap.width > 0 && g->bitmap.rows > 0) {
+		if (pack_glyph(font, page, (int)g->bitmap.width,
+			       (int)g->bitmap.rows, &x, &y) != 0)
+			return -1;
+
+		for (unsigned int row = 0; row < g->bitmap.rows; row++) {
+			memcpy(&bitmap[(y + row) * ATLAS_WIDTH + x],
+			       &g->bitmap.buffer[row * g->bitmap.pitch],
+			       g->bitmap.width);
+		}
+		mark_dirty(font, y, y + (int)g->bitmap.rows);
+		*glyph_page = page;
+	}
+
+	glyph->width = g->bitmap.width;
+	glyph->height = g->bitmap.rows;
+	glyph->bearing_x = g->bitmap_left;
+	glyph->bearing_y = g->bitmap_top;
+	glyph->advance = g->advance.x >> 6;
+	glyph->tex_offset_x = (float)x / (float)ATLAS_WIDTH;
+	glyph->tex_offset_y = (float)y / (float)ATLAS_HEIGHT;
+	return 0;
+}
+
+static void reset_glyph_cache(struct font *font)
+{
+	free(font->cache);
+	free(font->buckets);
+	font->cache = NULL;
+	font->buckets = NULL;
+	font->frame = 1;
+	font->dirty_top = 0;
+	font->dirty_bottom = 0;
+	font->generation++;
+	// Every page counts as evicted for layouts made before
+	memset(font->pages, 0, sizeof(font->pages));
+	for (int i = 0; i < FONT_ATLAS_PAGES; ++i)
+		font->pages[i].evicted = font->generation;
+}
+
+static void close_face(struct font *font)
+{
+	if (font->face) {
+		FT_Done_Face(font->face);
+		FT_Done_FreeType(font->ft);
+		font->face = NULL;
+		font->ft = NULL;
 	}
+}
+
+static int base_size(const struct font *font)
+{
+	return font->sdf ? FONT_SDF_SIZE : FONT_BASE_SIZE;
+}
 
+// Loads codepoint into the face's glyph slot as an 8-bit bitmap
+static int render_codepoint(struct font *font, uint32_t codepoint)
+{
+	if (!font->sdf)
+		return FT_Load_Char(font->face, codepoint, FT_LOAD_RENDER);
+
+	FT_Error error = FT_Load_Char(font->face, codepoint, FT_LOAD_DEFAULT);
+	if (!error)
+		error = FT_Render_Glyph(font->face->glyph, FT_RENDER_MODE_SDF);
+	return error;
+}
+
+static int open_face(struct font *font, const char *font_path)
+{
 	if (FT_Init_FreeType(&font->ft)) {
 		fprintf(stderr,
 			"ERROR::FREETYPE: Could not init FreeType Library\n");
@@ -23,12 +202,198 @@ int odc_font_load(const char *font_path, struct font *font)
 		fprintf(stderr, "ERROR::FREETYPE: Failed to load font %s\n",
 			font_path);
 		FT_Done_FreeType(font->ft);
+		font->face = NULL;
+		font->ft = NULL;
 		return -1;
 	}
 
-	FT_Set_Pixel_Sizes(font->face, 0, 48);
+	if (font->sdf) {
+		int spread = FONT_SDF_SPREAD;
+		FT_Property_Set(font->ft, "sdf", "spread", &spread);
+	}
+	font->face_size = 0;
+	return 0;
+}
 
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+// Identifies the font file by its contents, so a file replaced within the
+// same second or by one of the same size is never mistaken for the old one,
+// along with everything that changes how its glyphs are rendered and packed
+static int font_cache_key(const struct font *font, const char *font_path,
+			  uint64_t *key)
+{
+	FILE *file = fopen(font_path, "rb");
+	if (!file)
+		return -1;
+
+	unsigned char buffer[65536];
+	uint64_t hash = CACHE_HASH_SEED;
+	int64_t file_size = 0;
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		hash = odc_cache_hash(hash, buffer, read);
+		file_size += (int64_t)read;
+	}
+	int failed = ferror(file);
+	fclose(file);
+	if (failed)
+		return -1;
+
+	const int32_t settings[] = {
+		base_size(font), font->sdf, FONT_SDF_SPREAD,
+		MAX_GLYPHS, ATLAS_WIDTH, FONT_PAGE_HEIGHT,
+		FREETYPE_MAJOR, FREETYPE_MINOR, FREETYPE_PATCH,
+	};
+	hash = odc_cache_hash(hash, &file_size, sizeof(file_size));
+	*key = odc_cache_hash(hash, settings, sizeof(settings));
+	return 0;
+}
+
+static void font_cache_name(uint64_t key, char *name, size_t size)
+{
+	snprintf(name, size, "font-%016llx.bin", (unsigned long long)key);
+}
+
+static int load_cached_atlas(struct font *font, uint64_t key)
+{
+	char name[64];
+	font_cache_name(key, name, sizeof(name));
+
+	size_t size = 0;
+	const unsigned char *data =
+		(const unsigned char *)odc_cache_map(name, &size);
+	if (!data)
+		return -1;
+
+	struct font_cache_header header;
+	const size_t glyphs_size = sizeof(struct font_cache_glyph) * MAX_GLYPHS;
+	unsigned char *atlas_bitmap = NULL;
+	if (size >= sizeof(header)) {
+		memcpy(&header, data, sizeof(header));
+		if (memcmp(header.magic, FONT_CACHE_MAGIC, 4) == 0 &&
+		    header.version == FONT_CACHE_VERSION &&
+		    header.key == key && header.glyph_count == MAX_GLYPHS &&
+		    header.rows > 0 && header.rows <= FONT_PAGE_HEIGHT &&
+		    size == sizeof(header) + glyphs_size +
+				    (size_t)header.rows * ATLAS_WIDTH)
+			atlas_bitmap = (unsigned char *)calloc(
+				ATLAS_WIDTH * ATLAS_HEIGHT,
+				sizeof(unsigned char));
+	}
+	if (!atlas_bitmap) {
+		odc_cache_unmap(data, size);
+		return -1;
+	}
+
+	const unsigned char *glyphs = data + sizeof(header);
+	for (int i = 0; i < MAX_GLYPHS; ++i) {
+		struct font_cache_glyph cached;
+		memcpy(&cached, glyphs + i * sizeof(cached), sizeof(cached));
+		struct glyph *glyph = &font->glyphs[i];
+		glyph->width = cached.width;
+		glyph->height = cached.height;
+		glyph->bearing_x = cached.bearing_x;
+		glyph->bearing_y = cached.bearing_y;
+		glyph->advance = cached.advance;
+		glyph->tex_offset_x = cached.tex_offset_x;
+		glyph->tex_offset_y = cached.tex_offset_y;
+	}
+	memcpy(atlas_bitmap, glyphs + glyphs_size,
+	       (size_t)header.rows * ATLAS_WIDTH);
+	odc_cache_unmap(data, size);
+
+	font->units_per_em = header.units_per_em;
+	font->ascender = header.ascender;
+	font->descender = header.descender;
+	font->line_gap = header.line_gap;
+	// Glyphs rendered later go below the cached ones
+	font->pages[0].shelf_y = header.rows;
+	set_atlas(font, atlas_bitmap);
+	return 0;
+}
+
+static void save_cached_atlas(const struct font *font, uint64_t key)
+{
+	const struct font_page *page = &font->pages[0];
+	int rows = page->shelf_y + page->shelf_height;
+	size_t glyphs_size = sizeof(struct font_cache_glyph) * MAX_GLYPHS;
+	size_t size = sizeof(struct font_cache_header) + glyphs_size +
+		      (size_t)rows * ATLAS_WIDTH;
+	unsigned char *data = (unsigned char *)malloc(size);
+	if (!data)
+		return;
+
+	struct font_cache_header header;
+	memcpy(header.magic, FONT_CACHE_MAGIC, 4);
+	header.version = FONT_CACHE_VERSION;
+	header.key = key;
+	header.units_per_em = font->units_per_em;
+	header.ascender = font->ascender;
+	header.descender = font->descender;
+	header.line_gap = font->line_gap;
+	header.glyph_count = MAX_GLYPHS;
+	header.rows = rows;
+	memcpy(data, &header, sizeof(header));
+
+	unsigned char *glyphs = data + sizeof(header);
+	for (int i = 0; i < MAX_GLYPHS; ++i) {
+		const struct glyph *glyph = &font->glyphs[i];
+		struct font_cache_glyph cached = {
+			.width = glyph->width,
+			.height = glyph->height,
+			.bearing_x = glyph->bearing_x,
+			.bearing_y = glyph->bearing_y,
+			.advance = (int32_t)glyph->advance,
+			.tex_offset_x = glyph->tex_offset_x,
+			.tex_offset_y = glyph->tex_offset_y,
+		};
+		memcpy(glyphs + i * sizeof(cached), &cached, sizeof(cached));
+	}
+	memcpy(glyphs + glyphs_size, font->bitmap, (size_t)rows * ATLAS_WIDTH);
+
+	char name[64];
+	font_cache_name(key, name, sizeof(name));
+	odc_cache_write(name, data, size);
+	free(data);
+}
+
+static int load_face(const char *font_path, struct font *font, int sdf)
+{
+	if (!font) {
+		fprintf(stderr, "ERROR::FONT: Font pointer is NULL\n");
+		return -1;
+	}
+
+	close_face(font);
+	reset_glyph_cache(font);
+	free(font->path);
+	font->path = strdup(font_path);
+	font->sdf = sdf;
+
+	// A cached atlas needs no FreeType until text asks for a glyph it
+	// doesn't have
+	uint64_t key = 0;
+	int cacheable = font_cache_enabled && font->path &&
+			font_cache_key(font, font_path, &key) == 0;
+	if (cacheable && load_cached_atlas(font, key) == 0) {
+		font->scale = 1.0f / (float)ATLAS_WIDTH;
+		return 0;
+	}
+
+	if (open_face(font, font_path) != 0)
+		return -1;
+
+	FT_Set_Pixel_Sizes(font->face, 0, FONT_BASE_SIZE);
+
+	// Line metrics at FONT_BASE_SIZE, which text scales are relative to
+	const FT_Size_Metrics *metrics = &font->face->size->metrics;
+	font->units_per_em = font->face->units_per_EM;
+	font->ascender = (int)(metrics->ascender >> 6);
+	font->descender = (int)(metrics->descender >> 6);
+	font->line_gap = (int)(metrics->height >> 6) - font->ascender +
+			 font->descender;
+
+	font->face_size = base_size(font);
+	FT_Set_Pixel_Sizes(font->face, 0, font->face_size);
 
 	unsigned char *atlas_bitmap = (unsigned char *)calloc(
 		ATLAS_WIDTH * ATLAS_HEIGHT, sizeof(unsigned char));
@@ -36,18 +401,13 @@ int odc_font_load(const char *font_path, struct font *font)
 		fprintf(stderr,
 			"ERROR::FONT: Failed to allocate memory for atlas "
 			"bitmap\n");
-		FT_Done_Face(font->face);
-		FT_Done_FreeType(font->ft);
+		close_face(font);
 		return -1;
 	}
 
-	int x_offset = 0;
-	int y_offset = 0;
-	int row_height = 0;
-
 	for (unsigned char c = 32; c < 32 + MAX_GLYPHS; c++) {
 		// Load character glyph
-		if (FT_Load_Char(font->face, c, FT_LOAD_RENDER)) {
+		if (render_codepoint(font, c)) {
 			fprintf(stderr,
 				"ERROR::FREETYPE: Failed to load Glyph for "
 				"character '%c'\n",
@@ -55,76 +415,65 @@ int odc_font_load(const char *font_path, struct font *font)
 			continue;
 		}
 
-		FT_GlyphSlot g = font->face->glyph;
-
-		if (x_offset + g->bitmap.width > ATLAS_WIDTH) {
-			x_offset = 0;
-			y_offset += row_height;
-			row_height = 0;
-		}
-
-		if (y_offset + g->bitmap.rows > ATLAS_HEIGHT) {
+		int page;
+		if (place_glyph(font, atlas_bitmap, 0, &font->glyphs[c - 32],
+				&page) != 0) {
 			fprintf(stderr,
 				"ERROR::FONT: Texture atlas is too small for "
 				"all glyphs\n");
 			free(atlas_bitmap);
-			FT_Done_Face(font->face);
-			FT_Done_FreeType(font->ft);
+			close_face(font);
 			return -1;
 		}
+	}
 
-		for (int row = 0; row < g->bitmap.rows; row++) {
-			for (int col = 0; col < g->bitmap.width; col++) {
-				int atlas_x = x_offset + col;
-				int atlas_y = y_offset + row;
-				if (atlas_x < ATLAS_WIDTH &&
-				    atlas_y < ATLAS_HEIGHT) {
-					atlas_bitmap[atlas_y * ATLAS_WIDTH +
-						     atlas_x] =
-						g->bitmap.buffer
-							[row * g->bitmap.width +
-							 col];
-				}
-			}
-		}
+	set_atlas(font, atlas_bitmap);
 
-		int glyph_index = c - 32;
-		struct glyph *glyph = &font->glyphs[glyph_index];
-		glyph->width = g->bitmap.width;
-		glyph->height = g->bitmap.rows;
-		glyph->bearing_x = g->bitmap_left;
-		glyph->bearing_y = g->bitmap_top;
-		glyph->advance = g->advance.x >> 6;
+	font->scale = 1.0f / (float)ATLAS_WIDTH;
 
-		glyph->tex_offset_x = (float)x_offset / (float)ATLAS_WIDTH;
-		glyph->tex_offset_y = (float)y_offset / (float)ATLAS_HEIGHT;
+	if (cacheable)
+		save_cached_atlas(font, key);
 
-		x_offset += g->bitmap.width;
-		if (g->bitmap.rows > row_height) {
-			row_height = g->bitmap.rows;
-		}
-	}
+	// The face stays open to render other glyphs as text needs them
+	return 0;
+}
 
-	glGenTextures(1, &font->atlas);
-	font->texture_id = font->atlas;
-	glBindTexture(GL_TEXTURE_2D, font->atlas);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, ATLAS_WIDTH, ATLAS_HEIGHT, 0,
-		     GL_RED, GL_UNSIGNED_BYTE, atlas_bitmap);
+int odc_font_load(const char *font_path, struct font *font)
+{
+	return load_face(font_path, font, 0);
+}
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+int odc_font_load_sdf(const char *font_path, struct font *font)
+{
+	return load_face(font_path, font, 1);
+}
 
-	free(atlas_bitmap);
+void odc_font_set_cache_enabled(int enabled)
+{
+	font_cache_enabled = enabled;
+}
 
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+int odc_font_load_bitmap(struct font *font, const unsigned char *bitmap,
+			 int sdf)
+{
+	unsigned char *atlas_bitmap =
+		(unsigned char *)malloc(ATLAS_WIDTH * ATLAS_HEIGHT);
+	if (!atlas_bitmap) {
+		fprintf(stderr,
+			"ERROR::FONT: Failed to allocate memory for atlas "
+			"bitmap\n");
+		return -1;
+	}
 
+	memcpy(atlas_bitmap, bitmap, ATLAS_WIDTH * ATLAS_HEIGHT);
+	// Whatever the face rendered before isn't in this atlas
+	close_face(font);
+	reset_glyph_cache(font);
+	free(font->path);
+	font->path = NULL;
+	set_atlas(font, atlas_bitmap);
+	font->sdf = sdf != 0;
 	font->scale = 1.0f / (float)ATLAS_WIDTH;
-
-	FT_Done_Face(font->face);
-	FT_Done_FreeType(font->ft);
-
 	return 0;
 }
 
@@ -134,7 +483,280 @@ void odc_font_free(struct font *font)
 		return;
 
 	if (font->atlas) {
-		glDeleteTextures(1, &font->atlas);
+		odc_gl_state_delete_textures(1, &font->atlas);
 		font->atlas = 0;
 	}
+
+	free(font->bitmap);
+	font->bitmap = NULL;
+	close_face(font);
+	reset_glyph_cache(font);
+	free(font->path);
+	font->path = NULL;
+}
+
+static int alloc_glyph_cache(struct font *font)
+{
+	font->cache = (struct cached_glyph *)malloc(
+		sizeof(struct cached_glyph) * FONT_MAX_CACHED_GLYPHS);
+	font->buckets = (int *)malloc(sizeof(int) * GLYPH_BUCKETS);
+	if (!font->cache || !font->buckets) {
+		fprintf(stderr,
+			"ERROR::FONT: Failed to allocate glyph cache\n");
+		free(font->cache);
+		free(font->buckets);
+		font->cache = NULL;
+		font->buckets = NULL;
+		return -1;
+	}
+
+	for (int i = 0; i < GLYPH_BUCKETS; ++i)
+		font->buckets[i] = -1;
+	for (int i = 0; i < FONT_MAX_CACHED_GLYPHS; ++i)
+		font->cache[i].next = i + 1;
+	font->cache[FONT_MAX_CACHED_GLYPHS - 1].next = -1;
+	font->free_glyph = 0;
+	return 0;
+}
+
+static unsigned int glyph_bucket(uint32_t codepoint, int pixel_size)
+{
+	uint32_t hash = (codepoint * 2654435761u) ^ (uint32_t)pixel_size;
+	return (hash ^ (hash >> 15)) % GLYPH_BUCKETS;
+}
+
+// Drops every glyph on the least recently drawn page that wasn't drawn from
+// this frame and returns the page, or -1 if there is none
+static int evict_page(struct font *font)
+{
+	int victim = -1;
+	for (int i = 1; i < FONT_ATLAS_PAGES; ++i) {
+		const struct font_page *page = &font->pages[i];
+		if (page->last_used == font->frame)
+			continue;
+		if (victim < 0 ||
+		    page->last_used < font->pages[victim].last_used)
+			victim = i;
+	}
+	if (victim < 0)
+		return -1;
+
+	for (int i = 0; i < GLYPH_BUCKETS; ++i) {
+		int *link = &font->buckets[i];
+		while (*link >= 0) {
+			struct cached_glyph *entry = &font->cache[*link];
+			if (entry->page != victim) {
+				link = &entry->next;
+				continue;
+			}
+			int index = *link;
+			*link = entry->next;
+			entry->next = font->free_glyph;
+			font->free_glyph = index;
+		}
+	}
+
+	int top = victim * FONT_PAGE_HEIGHT;
+	memset(&font->bitmap[top * ATLAS_WIDTH], 0,
+	       (size_t)FONT_PAGE_HEIGHT * ATLAS_WIDTH);
+	mark_dirty(font, top, top + FONT_PAGE_HEIGHT);
+	memset(&font->pages[victim], 0, sizeof(font->pages[victim]));
+	font->pages[victim].evicted = ++font->generation;
+	return victim;
+}
+
+static int render_glyph(struct font *font, struct cached_glyph *entry)
+{
+	if (font->face_size != entry->pixel_size) {
+		FT_Set_Pixel_Sizes(font->face, 0, entry->pixel_size);
+		font->face_size = entry->pixel_size;
+	}
+	// Codepoints the face lacks render as its missing glyph box
+	if (render_codepoint(font, entry->codepoint)) {
+		fprintf(stderr,
+			"ERROR::FREETYPE: Failed to load glyph U+%04X\n",
+			(unsigned int)entry->codepoint);
+		return -1;
+	}
+
+	// Page 0 holds the base set and is never evicted, so glyphs placed
+	// there on demand could never be reclaimed
+	for (int page = 1; page < FONT_ATLAS_PAGES; ++page) {
+		if (place_glyph(font, font->bitmap, page, &entry->glyph,
+				&entry->page) == 0)
+			return 0;
+	}
+
+	int page = evict_page(font);
+	if (page < 0)
+		return -1;
+	return place_glyph(font, font->bitmap, page, &entry->glyph,
+			   &entry->page);
+}
+
+const struct glyph *odc_font_get_glyph(struct font *font, uint32_t codepoint,
+				       int pixel_size)
+{
+	if (pixel_size == base_size(font) && codepoint >= 32 &&
+	    codepoint < 32 + MAX_GLYPHS)
+		return &font->glyphs[codepoint - 32];
+
+	unsigned int bucket = glyph_bucket(codepoint, pixel_size);
+	if (font->cache) {
+		for (int i = font->buckets[bucket]; i >= 0;
+		     i = font->cache[i].next) {
+			struct cached_glyph *entry = &font->cache[i];
+			if (entry->codepoint != codepoint ||
+			    entry->pixel_size != pixel_size)
+				continue;
+			if (entry->page >= 0)
+				font->pages[entry->page].last_used =
+					font->frame;
+			return &entry->glyph;
+		}
+	}
+
+	if (!font->bitmap)
+		return NULL;
+	// Fonts loaded from the atlas cache open the face on first use
+	if (!font->face) {
+		if (!font->path || open_face(font, font->path) != 0) {
+			free(font->path);
+			font->path = NULL;
+			return NULL;
+		}
+	}
+	if (!font->cache && alloc_glyph_cache(font) != 0)
+		return NULL;
+	if (font->free_glyph < 0 && evict_page(font) < 0)
+		return NULL;
+	if (font->free_glyph < 0)
+		return NULL;
+
+	// Off the free list first, as evicting a page adds to it
+	int index = font->free_glyph;
+	struct cached_glyph *entry = &font->cache[index];
+	font->free_glyph = entry->next;
+	entry->codepoint = codepoint;
+	entry->pixel_size = pixel_size;
+	if (render_glyph(font, entry) != 0) {
+		entry->next = font->free_glyph;
+		font->free_glyph = index;
+		return NULL;
+	}
+
+	entry->next = font->buckets[bucket];
+	font->buckets[bucket] = index;
+	if (entry->page >= 0)
+		font->pages[entry->page].last_used = font->frame;
+	return &entry->glyph;
+}
+
+const struct glyph *odc_font_get_nearest_glyph(struct font *font,
+					       uint32_t codepoint,
+					       int pixel_size, int *glyph_size)
+{
+	const struct glyph *glyph =
+		odc_font_get_glyph(font, codepoint, pixel_size);
+	*glyph_size = pixel_size;
+	if (glyph || pixel_size == base_size(font))
+		return glyph;
+
+	// Large sizes fill a page in a few shelves, so when none is free the
+	// base size, whose ASCII glyphs are always resident, is stretched
+	*glyph_size = base_size(font);
+	return odc_font_get_glyph(font, codepoint, *glyph_size);
+}
+
+int odc_font_get_pixel_size(const struct font *font, float scale)
+{
+	if (font->sdf)
+		return FONT_SDF_SIZE;
+
+	int size = (int)((float)FONT_BASE_SIZE * scale + 0.5f);
+	if (size < FONT_MIN_PIXEL_SIZE)
+		return FONT_MIN_PIXEL_SIZE;
+	if (size > FONT_MAX_PIXEL_SIZE)
+		return FONT_MAX_PIXEL_SIZE;
+	return size;
+}
+
+int odc_font_touch_pages(struct font *font, unsigned int page_mask,
+			 unsigned int generation)
+{
+	for (int i = 0; i < FONT_ATLAS_PAGES; ++i) {
+		if (!(page_mask & (1u << i)))
+			continue;
+		if (font->pages[i].evicted > generation)
+			return 0;
+		font->pages[i].last_used = font->frame;
+	}
+	return 1;
+}
+
+void odc_font_upload(struct font *font)
+{
+	if (font->dirty_bottom <= font->dirty_top)
+		return;
+
+	if (font->atlas && GLAD_GL_VERSION_3_3) {
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		odc_gl_state_bind_texture(GL_TEXTURE_2D, font->atlas);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, font->dirty_top,
+				ATLAS_WIDTH,
+				font->dirty_bottom - font->dirty_top, GL_RED,
+				GL_UNSIGNED_BYTE,
+				&font->bitmap[font->dirty_top * ATLAS_WIDTH]);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	}
+	font->dirty_top = 0;
+	font->dirty_bottom = 0;
+}
+
+void odc_font_end_frame(struct font *font)
+{
+	font->frame++;
+}
+
+uint32_t odc_font_next_codepoint(const char **text)
+{
+	static const uint32_t min_value[] = { 0, 0, 0x80, 0x800, 0x10000 };
+	const unsigned char *s = (const unsigned char *)*text;
+	uint32_t c = s[0];
+	int length;
+
+	if (c < 0x80) {
+		if (c)
+			*text += 1;
+		return c;
+	}
+	if ((c & 0xe0) == 0xc0) {
+		length = 2;
+		c &= 0x1f;
+	} else if ((c & 0xf0) == 0xe0) {
+		length = 3;
+		c &= 0x0f;
+	} else if ((c & 0xf8) == 0xf0) {
+		length = 4;
+		c &= 0x07;
+	} else {
+		*text += 1;
+		return 0xfffd;
+	}
+
+	for (int i = 1; i < length; ++i) {
+		// Stops at the terminator too
+		if ((s[i] & 0xc0) != 0x80) {
+			*text += i;
+			return 0xfffd;
+		}
+		c = (c << 6) | (s[i] & 0x3f);
+	}
+	*text += length;
+
+	// Overlong forms, surrogates and values past U+10FFFF
+	if (c < min_value[length] || c > 0x10ffff ||
+	    (c >= 0xd800 && c <= 0xdfff))
+		return 0xfffd;
+	return c;
 }
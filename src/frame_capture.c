@@ -0,0 +1,645 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "odc_font.h"
+#include "odc_frame_capture.h"
+#include "odc_renderer.h"
+#include "odc_shape_batch.h"
+
+#define CAPTURE_DEPTH_SORTING 0x1
+#define CAPTURE_OVERDRAW 0x2
+#define CAPTURE_FONT 0x4
+#define CAPTURE_SDF_FONT 0x8
+
+#define MAX_CAPTURE_TEXTURE_SIZE 16384
+
+struct captured_texture {
+	GLuint handle;
+	GLuint replay_handle;
+	struct renderer_texture_info info;
+	const unsigned char *pixels;
+};
+
+struct frame_capture {
+	// The whole file; pixels and sources point into it
+	unsigned char *data;
+	int width;
+	int height;
+	float time;
+	int flags;
+	float animation_frames[MAX_SPRITE_ANIMATIONS][4];
+	float animation_params[MAX_SPRITE_ANIMATIONS][4];
+	int animation_count;
+	char *custom_shapes[MAX_CUSTOM_SHAPES];
+	int custom_shape_count;
+	const unsigned char *palettes;
+	int colors_per_palette;
+	int palette_count;
+	const unsigned char *font_bitmap;
+	struct captured_texture *textures;
+	int texture_count;
+	struct draw_batch *batches;
+	GLuint *batch_textures;
+	int batch_count;
+	struct vertex *vertices;
+	int shape_count;
+	int prepared;
+};
+
+// A shape's six vertices only differ in their positions and texture
+// coordinates, so the rest is stored once, in 200 bytes instead of 480
+struct shape_record {
+	float shape_pos[2];
+	float op_code;
+	float radius;
+	float width;
+	float height;
+	float color[4];
+	float resolution[2];
+	float anim[2];
+	struct {
+		float fs_quad_pos[2];
+		float local_pos[2];
+		float tex_coord[2];
+	} corners[6];
+};
+
+struct writer {
+	FILE *file;
+	int ok;
+};
+
+struct reader {
+	const unsigned char *data;
+	size_t size;
+	size_t offset;
+	int ok;
+};
+
+static void write_data(struct writer *w, const void *data, size_t size)
+{
+	if (w->ok && size > 0 && fwrite(data, 1, size, w->file) != size)
+		w->ok = 0;
+}
+
+static void write_int(struct writer *w, int32_t value)
+{
+	write_data(w, &value, sizeof(value));
+}
+
+static void write_float(struct writer *w, float value)
+{
+	write_data(w, &value, sizeof(value));
+}
+
+static const void *read_data(struct reader *r, size_t size)
+{
+	if (!r->ok || size > r->size - r->offset) {
+		r->ok = 0;
+		return NULL;
+	}
+
+	const void *data = r->data + r->offset;
+	r->offset += size;
+	return data;
+}
+
+static int32_t read_int(struct reader *r)
+{
+	int32_t value = 0;
+	const void *data = read_data(r, sizeof(value));
+	if (data)
+		memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static float read_float(struct reader *r)
+{
+	float value = 0.0f;
+	const void *data = read_data(r, sizeof(value));
+	if (data)
+		memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static int read_count(struct reader *r, int max)
+{
+	int count = read_int(r);
+	if (count < 0 || count > max) {
+		r->ok = 0;
+		return 0;
+	}
+	return count;
+}
+
+static void pack_shape(const struct vertex *shape, struct shape_record *record)
+{
+	memcpy(record->shape_pos, shape->shape_pos, sizeof(record->shape_pos));
+	record->op_code = shape->op_code;
+	record->radius = shape->radius;
+	record->width = shape->width;
+	record->height = shape->height;
+	memcpy(record->color, shape->color, sizeof(record->color));
+	memcpy(record->resolution, shape->resolution,
+	       sizeof(record->resolution));
+	memcpy(record->anim, shape->anim, sizeof(record->anim));
+
+	for (int i = 0; i < 6; ++i) {
+		const struct vertex *v = &shape[i];
+		memcpy(record->corners[i].fs_quad_pos, v->fs_quad_pos,
+		       sizeof(v->fs_quad_pos));
+		memcpy(record->corners[i].local_pos, v->local_pos,
+		       sizeof(v->local_pos));
+		memcpy(record->corners[i].tex_coord, v->tex_coord,
+		       sizeof(v->tex_coord));
+	}
+}
+
+static void unpack_shape(const struct shape_record *record,
+			 struct vertex *shape)
+{
+	for (int i = 0; i < 6; ++i) {
+		struct vertex *v = &shape[i];
+		memcpy(v->fs_quad_pos, record->corners[i].fs_quad_pos,
+		       sizeof(v->fs_quad_pos));
+		memcpy(v->shape_pos, record->shape_pos, sizeof(v->shape_pos));
+		memcpy(v->local_pos, record->corners[i].local_pos,
+		       sizeof(v->local_pos));
+		v->op_code = record->op_code;
+		v->radius = record->radius;
+		v->width = record->width;
+		v->height = record->height;
+		memcpy(v->color, record->color, sizeof(v->color));
+		memcpy(v->resolution, record->resolution,
+		       sizeof(v->resolution));
+		memcpy(v->tex_coord, record->corners[i].tex_coord,
+		       sizeof(v->tex_coord));
+		memcpy(v->anim, record->anim, sizeof(v->anim));
+	}
+}
+
+static int has_text(const struct renderer_frame *frame)
+{
+	for (int i = 0; i < frame->shape_count; ++i) {
+		if (frame->vertices[i * 6].op_code == OP_CODE_TEXT)
+			return 1;
+	}
+	return 0;
+}
+
+static void write_textures(struct writer *w, struct renderer *renderer,
+			   const struct renderer_frame *frame)
+{
+	GLuint handles[MAX_DRAW_BATCHES];
+	int count = 0;
+	for (int i = 0; i < frame->batch_count; ++i) {
+		GLuint texture = frame->batches[i].texture;
+		int seen = texture == 0;
+		for (int j = 0; j < count && !seen; ++j)
+			seen = handles[j] == texture;
+		if (!seen)
+			handles[count++] = texture;
+	}
+
+	write_int(w, count);
+	for (int i = 0; i < count && w->ok; ++i) {
+		struct renderer_texture_info info;
+		unsigned char *pixels =
+			odc_renderer_read_texture(renderer, handles[i], &info);
+		if (!pixels) {
+			w->ok = 0;
+			return;
+		}
+
+		write_int(w, (int32_t)handles[i]);
+		write_int(w, info.width);
+		write_int(w, info.height);
+		write_int(w, info.channels);
+		write_int(w, (int32_t)info.min_filter);
+		write_int(w, (int32_t)info.mag_filter);
+		write_int(w, info.opaque);
+		write_data(w, pixels,
+			   (size_t)info.width * info.height * info.channels);
+		free(pixels);
+	}
+}
+
+int odc_frame_capture_save(struct renderer *renderer, const char *path,
+			   int width, int height)
+{
+	struct renderer_frame frame;
+	odc_renderer_get_frame(renderer, &frame);
+
+	FILE *file = fopen(path, "wb");
+	if (!file) {
+		fprintf(stderr, "ERROR::FRAME_CAPTURE: Failed to open %s\n",
+			path);
+		return -1;
+	}
+
+	struct writer w = {file, 1};
+	int flags = 0;
+	if (odc_renderer_get_depth_sorting(renderer))
+		flags |= CAPTURE_DEPTH_SORTING;
+	if (odc_renderer_get_overdraw_mode(renderer))
+		flags |= CAPTURE_OVERDRAW;
+	if (frame.font_bitmap && has_text(&frame))
+		flags |= CAPTURE_FONT;
+	if (frame.font_sdf)
+		flags |= CAPTURE_SDF_FONT;
+
+	write_data(&w, FRAME_CAPTURE_MAGIC, 4);
+	write_int(&w, FRAME_CAPTURE_VERSION);
+	write_int(&w, width);
+	write_int(&w, height);
+	write_float(&w, frame.time);
+	write_int(&w, flags);
+
+	write_int(&w, frame.animation_count);
+	write_data(&w, frame.animation_frames,
+		   sizeof(float[4]) * frame.animation_count);
+	write_data(&w, frame.animation_params,
+		   sizeof(float[4]) * frame.animation_count);
+
+	int custom_shape_count = odc_renderer_get_custom_shape_count(renderer);
+	write_int(&w, custom_shape_count);
+	for (int i = 0; i < custom_shape_count; ++i) {
+		const char *source = odc_renderer_get_custom_shape(renderer, i);
+		int length = (int)strlen(source);
+		write_int(&w, length);
+		write_data(&w, source, length);
+	}
+
+	int colors_per_palette, palette_count;
+	unsigned char *palettes = odc_renderer_read_palettes(
+		renderer, &colors_per_palette, &palette_count);
+	if (!palettes)
+		palette_count = 0;
+	write_int(&w, colors_per_palette);
+	write_int(&w, palette_count);
+	write_data(&w, palettes,
+		   (size_t)colors_per_palette * palette_count * 4);
+	free(palettes);
+
+	if (flags & CAPTURE_FONT)
+		write_data(&w, frame.font_bitmap, ATLAS_WIDTH * ATLAS_HEIGHT);
+
+	write_textures(&w, renderer, &frame);
+
+	write_int(&w, frame.batch_count);
+	for (int i = 0; i < frame.batch_count; ++i) {
+		write_int(&w, frame.batches[i].first_shape);
+		write_int(&w, (int32_t)frame.batches[i].texture);
+	}
+
+	write_int(&w, frame.shape_count);
+	for (int i = 0; i < frame.shape_count && w.ok; ++i) {
+		struct shape_record record;
+		pack_shape(&frame.vertices[i * 6], &record);
+		write_data(&w, &record, sizeof(record));
+	}
+
+	w.ok = fclose(file) == 0 && w.ok;
+	if (!w.ok) {
+		fprintf(stderr, "ERROR::FRAME_CAPTURE: Failed to write %s\n",
+			path);
+		remove(path);
+		return -1;
+	}
+
+	return 0;
+}
+
+static unsigned char *read_file(const char *path, size_t *size)
+{
+	FILE *file = fopen(path, "rb");
+	if (!file)
+		return NULL;
+
+	fseek(file, 0, SEEK_END);
+	long length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	unsigned char *data =
+		length > 0 ? (unsigned char *)malloc(length) : NULL;
+	if (!data || fread(data, 1, length, file) != (size_t)length) {
+		free(data);
+		fclose(file);
+		return NULL;
+	}
+
+	fclose(file);
+	*size = (size_t)length;
+	return data;
+}
+
+static void read_textures(struct reader *r, struct frame_capture *capture)
+{
+	capture->texture_count = read_count(r, MAX_DRAW_BATCHES);
+	if (!r->ok || capture->texture_count == 0)
+		return;
+
+	capture->textures = (struct captured_texture *)calloc(
+		capture->texture_count, sizeof(struct captured_texture));
+	if (!capture->textures) {
+		r->ok = 0;
+		return;
+	}
+
+	for (int i = 0; i < capture->texture_count && r->ok; ++i) {
+		struct captured_texture *texture = &capture->textures[i];
+		struct renderer_texture_info *info = &texture->info;
+		texture->handle = (GLuint)read_int(r);
+		info->width = read_count(r, MAX_CAPTURE_TEXTURE_SIZE);
+		info->height = read_count(r, MAX_CAPTURE_TEXTURE_SIZE);
+		info->channels = read_int(r);
+		info->min_filter = (GLenum)read_int(r);
+		info->mag_filter = (GLenum)read_int(r);
+		info->opaque = read_int(r);
+		if (info->channels != 1 && info->channels != 4) {
+			r->ok = 0;
+			return;
+		}
+		texture->pixels = (const unsigned char *)read_data(
+			r, (size_t)info->width * info->height * info->channels);
+	}
+}
+
+static void read_shapes(struct reader *r, struct frame_capture *capture)
+{
+	capture->batch_count = read_count(r, MAX_DRAW_BATCHES);
+	capture->batches = (struct draw_batch *)calloc(
+		capture->batch_count + 1, sizeof(struct draw_batch));
+	capture->batch_textures =
+		(GLuint *)calloc(capture->batch_count + 1, sizeof(GLuint));
+	if (!capture->batches || !capture->batch_textures) {
+		r->ok = 0;
+		return;
+	}
+	for (int i = 0; i < capture->batch_count; ++i) {
+		capture->batches[i].first_shape = read_int(r);
+		capture->batches[i].texture = (GLuint)read_int(r);
+	}
+
+	capture->shape_count = read_count(r, MAX_SHAPES);
+	for (int i = 0; i < capture->batch_count; ++i) {
+		int first = capture->batches[i].first_shape;
+		int next = i + 1 < capture->batch_count
+				   ? capture->batches[i + 1].first_shape
+				   : capture->shape_count;
+		if (first < 0 || first > next || next > capture->shape_count)
+			r->ok = 0;
+	}
+	if (!r->ok || capture->shape_count == 0)
+		return;
+
+	capture->vertices = (struct vertex *)malloc(
+		sizeof(struct vertex) * capture->shape_count * 6);
+	if (!capture->vertices) {
+		r->ok = 0;
+		return;
+	}
+	for (int i = 0; i < capture->shape_count && r->ok; ++i) {
+		const void *record = read_data(r, sizeof(struct shape_record));
+		if (record)
+			unpack_shape((const struct shape_record *)record,
+				     &capture->vertices[i * 6]);
+	}
+}
+
+struct frame_capture *odc_frame_capture_load(const char *path)
+{
+	size_t size;
+	unsigned char *data = read_file(path, &size);
+	if (!data) {
+		fprintf(stderr, "ERROR::FRAME_CAPTURE: Failed to read %s\n",
+			path);
+		return NULL;
+	}
+
+	struct frame_capture *capture =
+		(struct frame_capture *)calloc(1, sizeof(struct frame_capture));
+	if (!capture) {
+		free(data);
+		return NULL;
+	}
+	capture->data = data;
+
+	struct reader r = {data, size, 0, 1};
+	const void *magic = read_data(&r, 4);
+	if (!magic || memcmp(magic, FRAME_CAPTURE_MAGIC, 4) != 0 ||
+	    read_int(&r) != FRAME_CAPTURE_VERSION) {
+		fprintf(stderr,
+			"ERROR::FRAME_CAPTURE: %s is not a version %d "
+			"capture\n",
+			path, FRAME_CAPTURE_VERSION);
+		odc_frame_capture_destroy(capture);
+		return NULL;
+	}
+
+	capture->width = read_int(&r);
+	capture->height = read_int(&r);
+	capture->time = read_float(&r);
+	capture->flags = read_int(&r);
+
+	capture->animation_count = read_count(&r, MAX_SPRITE_ANIMATIONS);
+	const void *frames =
+		read_data(&r, sizeof(float[4]) * capture->animation_count);
+	const void *params =
+		read_data(&r, sizeof(float[4]) * capture->animation_count);
+	if (frames && params) {
+		memcpy(capture->animation_frames, frames,
+		       sizeof(float[4]) * capture->animation_count);
+		memcpy(capture->animation_params, params,
+		       sizeof(float[4]) * capture->animation_count);
+	}
+
+	capture->custom_shape_count = read_count(&r, MAX_CUSTOM_SHAPES);
+	for (int i = 0; i < capture->custom_shape_count && r.ok; ++i) {
+		int length = read_count(&r, INT32_MAX - 1);
+		const void *source = read_data(&r, length);
+		capture->custom_shapes[i] = (char *)malloc(length + 1);
+		if (!source || !capture->custom_shapes[i]) {
+			r.ok = 0;
+			break;
+		}
+		memcpy(capture->custom_shapes[i], source, length);
+		capture->custom_shapes[i][length] = '\0';
+	}
+
+	capture->colors_per_palette = read_count(&r, MAX_PALETTE_COLORS);
+	capture->palette_count = read_count(&r, INT32_MAX);
+	capture->palettes = (const unsigned char *)read_data(
+		&r, (size_t)capture->colors_per_palette *
+			    capture->palette_count * 4);
+
+	if (capture->flags & CAPTURE_FONT)
+		capture->font_bitmap = (const unsigned char *)read_data(
+			&r, ATLAS_WIDTH * ATLAS_HEIGHT);
+
+	read_textures(&r, capture);
+	read_shapes(&r, capture);
+
+	if (!r.ok || capture->width <= 0 || capture->height <= 0) {
+		fprintf(stderr, "ERROR::FRAME_CAPTURE: %s is truncated or "
+				"corrupt\n",
+			path);
+		odc_frame_capture_destroy(capture);
+		return NULL;
+	}
+
+	return capture;
+}
+
+void odc_frame_capture_destroy(struct frame_capture *capture)
+{
+	if (!capture)
+		return;
+
+	for (int i = 0; i < capture->custom_shape_count; ++i)
+		free(capture->custom_shapes[i]);
+	free(capture->textures);
+	free(capture->batches);
+	free(capture->batch_textures);
+	free(capture->vertices);
+	free(capture->data);
+	free(capture);
+}
+
+void odc_frame_capture_get_size(struct frame_capture *capture, int *width,
+				int *height)
+{
+	*width = capture->width;
+	*height = capture->height;
+}
+
+int odc_frame_capture_get_shape_count(struct frame_capture *capture)
+{
+	return capture->shape_count;
+}
+
+static int prepare_textures(struct frame_capture *capture,
+			    struct renderer *renderer)
+{
+	for (int i = 0; i < capture->texture_count; ++i) {
+		struct captured_texture *texture = &capture->textures[i];
+		const struct renderer_texture_info *info = &texture->info;
+		if (info->channels == 1)
+			texture->replay_handle =
+				odc_renderer_upload_indexed_texture(
+					renderer, texture->pixels, info->width,
+					info->height);
+		else
+			texture->replay_handle = odc_renderer_upload_texture(
+				renderer, texture->pixels, info->width,
+				info->height);
+		if (!texture->replay_handle)
+			return -1;
+
+		odc_renderer_set_texture_filter(renderer,
+						texture->replay_handle,
+						info->min_filter,
+						info->mag_filter);
+		odc_renderer_set_texture_opaque(
+			renderer, texture->replay_handle, info->opaque);
+	}
+
+	for (int i = 0; i < capture->batch_count; ++i) {
+		for (int j = 0; j < capture->texture_count; ++j) {
+			if (capture->textures[j].handle ==
+			    capture->batches[i].texture)
+				capture->batch_textures[i] =
+					capture->textures[j].replay_handle;
+		}
+	}
+
+	return 0;
+}
+
+int odc_frame_capture_prepare(struct frame_capture *capture,
+			      struct renderer *renderer)
+{
+	if (capture->prepared) {
+		fprintf(stderr,
+			"ERROR::FRAME_CAPTURE: Capture is already prepared\n");
+		return -1;
+	}
+
+	// A 1x1 sheet makes the stored sheet fractions come back unchanged
+	for (int i = 0; i < capture->animation_count; ++i) {
+		const float *frames = capture->animation_frames[i];
+		const float *params = capture->animation_params[i];
+		struct sprite_animation animation = {
+			.sheet_width = 1.0f,
+			.sheet_height = 1.0f,
+			.frame_x = frames[0],
+			.frame_y = frames[1],
+			.frame_width = frames[2],
+			.frame_height = frames[3],
+			.columns = (int)params[0],
+			.frame_count = (int)params[1],
+			.fps = params[2],
+			.loop_mode = (enum sprite_loop_mode)params[3],
+		};
+		if (odc_renderer_register_animation(renderer, &animation) != i)
+			return -1;
+	}
+
+	for (int i = 0; i < capture->custom_shape_count; ++i) {
+		if (odc_renderer_register_shape(renderer,
+						capture->custom_shapes[i]) != i)
+			return -1;
+	}
+	if (capture->custom_shape_count > 0 &&
+	    odc_renderer_rebuild_shaders(renderer) != 0)
+		return -1;
+
+	if (capture->palette_count > 0 &&
+	    odc_renderer_upload_palettes(renderer, capture->palettes,
+					 capture->colors_per_palette,
+					 capture->palette_count) != 0)
+		return -1;
+
+	if (capture->font_bitmap &&
+	    odc_renderer_load_font_bitmap(
+		    renderer, capture->font_bitmap,
+		    (capture->flags & CAPTURE_SDF_FONT) != 0) != 0)
+		return -1;
+
+	if (prepare_textures(capture, renderer) != 0)
+		return -1;
+
+	capture->prepared = 1;
+	return 0;
+}
+
+int odc_frame_capture_submit(struct frame_capture *capture,
+			     struct renderer *renderer)
+{
+	if (!capture->prepared) {
+		fprintf(stderr,
+			"ERROR::FRAME_CAPTURE: Capture is not prepared\n");
+		return -1;
+	}
+
+	odc_renderer_set_time(renderer, capture->time);
+	odc_renderer_set_depth_sorting(
+		renderer, (capture->flags & CAPTURE_DEPTH_SORTING) != 0);
+	odc_renderer_set_overdraw_mode(
+		renderer, (capture->flags & CAPTURE_OVERDRAW) != 0);
+
+	struct shape_batch *batch = odc_renderer_get_batch(renderer);
+	for (int i = 0; i < capture->batch_count; ++i) {
+		int first = capture->batches[i].first_shape;
+		int next = i + 1 < capture->batch_count
+				   ? capture->batches[i + 1].first_shape
+				   : capture->shape_count;
+		odc_shape_batch_add_shapes(batch, &capture->vertices[first * 6],
+					   next - first,
+					   capture->batch_textures[i]);
+	}
+
+	return 0;
+}
@@ -0,0 +1,315 @@
+#include "glad.h"
+
+#include <string.h>
+
+#include "odc_gl_state.h"
+
+#define UNKNOWN_BINDING 0xffffffffu
+#define CACHED_BUFFER_TARGETS 4
+#define CACHED_TEXTURE_TARGETS 2
+
+struct gl_state {
+	GLuint program;
+	GLuint vertex_array;
+	GLuint buffers[CACHED_BUFFER_TARGETS];
+	int active_unit;
+	GLuint textures[GL_STATE_MAX_TEXTURE_UNITS][CACHED_TEXTURE_TARGETS];
+	GLuint samplers[GL_STATE_MAX_TEXTURE_UNITS];
+	int blend_enabled;
+	GLenum blend_src;
+	GLenum blend_dst;
+	int depth_test;
+	int depth_write;
+	struct gl_state_stats frame;
+	struct gl_state_stats last_frame;
+};
+
+static struct gl_state state = {
+	.program = UNKNOWN_BINDING,
+	.vertex_array = UNKNOWN_BINDING,
+	.buffers = { UNKNOWN_BINDING, UNKNOWN_BINDING, UNKNOWN_BINDING,
+		     UNKNOWN_BINDING },
+	.active_unit = -1,
+	.blend_enabled = -1,
+	.blend_src = UNKNOWN_BINDING,
+	.blend_dst = UNKNOWN_BINDING,
+	.depth_test = -1,
+	.depth_write = -1,
+};
+static int textures_known = 0;
+
+static int buffer_index(GLenum target)
+{
+	switch (target) {
+	case GL_ARRAY_BUFFER:
+		return 0;
+	case GL_ELEMENT_ARRAY_BUFFER:
+		return 1;
+	case GL_PIXEL_PACK_BUFFER:
+		return 2;
+	case GL_PIXEL_UNPACK_BUFFER:
+		return 3;
+	default:
+		return -1;
+	}
+}
+
+static int texture_index(GLenum target)
+{
+	switch (target) {
+	case GL_TEXTURE_2D:
+		return 0;
+	case GL_TEXTURE_2D_ARRAY:
+		return 1;
+	default:
+		return -1;
+	}
+}
+
+static void forget_textures(void)
+{
+	for (int unit = 0; unit < GL_STATE_MAX_TEXTURE_UNITS; ++unit) {
+		for (int t = 0; t < CACHED_TEXTURE_TARGETS; ++t)
+			state.textures[unit][t] = UNKNOWN_BINDING;
+		state.samplers[unit] = UNKNOWN_BINDING;
+	}
+	textures_known = 1;
+}
+
+void odc_gl_state_invalidate(void)
+{
+	state.program = UNKNOWN_BINDING;
+	state.vertex_array = UNKNOWN_BINDING;
+	for (int i = 0; i < CACHED_BUFFER_TARGETS; ++i)
+		state.buffers[i] = UNKNOWN_BINDING;
+	state.active_unit = -1;
+	state.blend_enabled = -1;
+	state.blend_src = UNKNOWN_BINDING;
+	state.blend_dst = UNKNOWN_BINDING;
+	state.depth_test = -1;
+	state.depth_write = -1;
+	forget_textures();
+}
+
+void odc_gl_state_use_program(GLuint program)
+{
+	if (state.program == program) {
+		state.frame.skipped++;
+		return;
+	}
+
+	glUseProgram(program);
+	state.program = program;
+	state.frame.program_changes++;
+}
+
+void odc_gl_state_bind_vertex_array(GLuint vertex_array)
+{
+	if (state.vertex_array == vertex_array) {
+		state.frame.skipped++;
+		return;
+	}
+
+	glBindVertexArray(vertex_array);
+	state.vertex_array = vertex_array;
+	// The element buffer binding lives in the vertex array
+	state.buffers[buffer_index(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN_BINDING;
+	state.frame.vertex_array_changes++;
+}
+
+void odc_gl_state_bind_buffer(GLenum target, GLuint buffer)
+{
+	int index = buffer_index(target);
+	if (index >= 0 && state.buffers[index] == buffer) {
+		state.frame.skipped++;
+		return;
+	}
+
+	glBindBuffer(target, buffer);
+	if (index >= 0)
+		state.buffers[index] = buffer;
+	state.frame.buffer_changes++;
+}
+
+void odc_gl_state_active_texture(int unit)
+{
+	if (state.active_unit == unit) {
+		state.frame.skipped++;
+		return;
+	}
+
+	glActiveTexture(GL_TEXTURE0 + unit);
+	state.active_unit = unit;
+	state.frame.active_texture_changes++;
+}
+
+void odc_gl_state_bind_texture(GLenum target, GLuint texture)
+{
+	if (!textures_known)
+		forget_textures();
+
+	if (state.active_unit < 0)
+		odc_gl_state_active_texture(0);
+
+	int index = texture_index(target);
+	int unit = state.active_unit;
+	if (index >= 0 && unit < GL_STATE_MAX_TEXTURE_UNITS &&
+	    state.textures[unit][index] == texture) {
+		state.frame.skipped++;
+		return;
+	}
+
+	glBindTexture(target, texture);
+	if (index >= 0 && unit < GL_STATE_MAX_TEXTURE_UNITS)
+		state.textures[unit][index] = texture;
+	state.frame.texture_changes++;
+}
+
+void odc_gl_state_bind_texture_unit(int unit, GLenum target, GLuint texture)
+{
+	if (!textures_known)
+		forget_textures();
+
+	int index = texture_index(target);
+	if (index >= 0 && unit < GL_STATE_MAX_TEXTURE_UNITS &&
+	    state.textures[unit][index] == texture) {
+		state.frame.skipped++;
+		return;
+	}
+
+	odc_gl_state_active_texture(unit);
+	odc_gl_state_bind_texture(target, texture);
+}
+
+void odc_gl_state_bind_sampler(int unit, GLuint sampler)
+{
+	if (!textures_known)
+		forget_textures();
+
+	if (unit < GL_STATE_MAX_TEXTURE_UNITS &&
+	    state.samplers[unit] == sampler) {
+		state.frame.skipped++;
+		return;
+	}
+
+	glBindSampler(unit, sampler);
+	if (unit < GL_STATE_MAX_TEXTURE_UNITS)
+		state.samplers[unit] = sampler;
+	state.frame.sampler_changes++;
+}
+
+void odc_gl_state_set_blend(int enabled, GLenum src_factor,
+			    GLenum dst_factor)
+{
+	if (state.blend_enabled != enabled) {
+		if (enabled)
+			glEnable(GL_BLEND);
+		else
+			glDisable(GL_BLEND);
+		state.blend_enabled = enabled;
+		state.frame.blend_changes++;
+	} else {
+		state.frame.skipped++;
+	}
+
+	if (!enabled)
+		return;
+
+	if (state.blend_src != src_factor || state.blend_dst != dst_factor) {
+		glBlendFunc(src_factor, dst_factor);
+		state.blend_src = src_factor;
+		state.blend_dst = dst_factor;
+		state.frame.blend_changes++;
+	} else {
+		state.frame.skipped++;
+	}
+}
+
+void odc_gl_state_set_depth(int test_enabled, int write_enabled)
+{
+	if (state.depth_test != test_enabled) {
+		if (test_enabled)
+			glEnable(GL_DEPTH_TEST);
+		else
+			glDisable(GL_DEPTH_TEST);
+		state.depth_test = test_enabled;
+		state.frame.depth_changes++;
+	} else {
+		state.frame.skipped++;
+	}
+
+	if (state.depth_write != write_enabled) {
+		glDepthMask(write_enabled ? GL_TRUE : GL_FALSE);
+		state.depth_write = write_enabled;
+		state.frame.depth_changes++;
+	} else {
+		state.frame.skipped++;
+	}
+}
+
+void odc_gl_state_delete_program(GLuint program)
+{
+	// A deleted program stays in use until another replaces it, but its
+	// name may be recycled afterwards
+	if (state.program == program)
+		state.program = UNKNOWN_BINDING;
+	glDeleteProgram(program);
+}
+
+void odc_gl_state_delete_vertex_arrays(int count, const GLuint *vertex_arrays)
+{
+	for (int i = 0; i < count; ++i) {
+		if (state.vertex_array == vertex_arrays[i]) {
+			state.vertex_array = 0;
+			state.buffers[buffer_index(GL_ELEMENT_ARRAY_BUFFER)] =
+				UNKNOWN_BINDING;
+		}
+	}
+	glDeleteVertexArrays(count, vertex_arrays);
+}
+
+void odc_gl_state_delete_buffers(int count, const GLuint *buffers)
+{
+	for (int i = 0; i < count; ++i) {
+		for (int b = 0; b < CACHED_BUFFER_TARGETS; ++b) {
+			if (state.buffers[b] == buffers[i])
+				state.buffers[b] = 0;
+		}
+	}
+	glDeleteBuffers(count, buffers);
+}
+
+void odc_gl_state_delete_textures(int count, const GLuint *textures)
+{
+	for (int i = 0; i < count; ++i) {
+		for (int unit = 0; unit < GL_STATE_MAX_TEXTURE_UNITS; ++unit) {
+			for (int t = 0; t < CACHED_TEXTURE_TARGETS; ++t) {
+				if (state.textures[unit][t] == textures[i])
+					state.textures[unit][t] = 0;
+			}
+		}
+	}
+	glDeleteTextures(count, textures);
+}
+
+void odc_gl_state_delete_samplers(int count, const GLuint *samplers)
+{
+	for (int i = 0; i < count; ++i) {
+		for (int unit = 0; unit < GL_STATE_MAX_TEXTURE_UNITS; ++unit) {
+			if (state.samplers[unit] == samplers[i])
+				state.samplers[unit] = 0;
+		}
+	}
+	glDeleteSamplers(count, samplers);
+}
+
+void odc_gl_state_end_frame(void)
+{
+	state.last_frame = state.frame;
+	memset(&state.frame, 0, sizeof(state.frame));
+}
+
+struct gl_state_stats odc_gl_state_get_stats(void)
+{
+	return state.last_frame;
+}
@@ -0,0 +1,216 @@
+#include "glad.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "odc_gpu_timer.h"
+
+struct timer_frame {
+	GLuint elapsed_query;
+	GLuint begin_queries[GPU_TIMER_MAX_SECTIONS];
+	GLuint end_queries[GPU_TIMER_MAX_SECTIONS];
+	struct gpu_timer_section sections[GPU_TIMER_MAX_SECTIONS];
+	double cpu_begin[GPU_TIMER_MAX_SECTIONS];
+	int ended[GPU_TIMER_MAX_SECTIONS];
+	int section_count;
+	double cpu_frame_begin;
+	double cpu_frame_ms;
+	int pending;
+};
+
+struct gpu_timer {
+	struct timer_frame frames[GPU_TIMER_FRAMES];
+	struct timer_frame *current;
+	int next;
+	int depth;
+	struct gpu_timer_section results[GPU_TIMER_MAX_SECTIONS];
+	int result_count;
+	double gpu_frame_ms;
+	double cpu_frame_ms;
+	unsigned long dropped_frames;
+};
+
+static double now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static GLuint64 query_result(GLuint query)
+{
+	GLuint64 value = 0;
+	glGetQueryObjectui64v(query, GL_QUERY_RESULT, &value);
+	return value;
+}
+
+static int is_available(GLuint query)
+{
+	GLint available = 0;
+	glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+	return available;
+}
+
+// Copies a frame's results out once the GPU has finished with it. Every
+// query is checked, since drivers needn't make them available in order.
+static int resolve_frame(struct gpu_timer *timer, struct timer_frame *frame)
+{
+	if (!frame->pending)
+		return 1;
+
+	if (!is_available(frame->elapsed_query))
+		return 0;
+	for (int i = 0; i < frame->section_count; ++i) {
+		if (!is_available(frame->begin_queries[i]) ||
+		    (frame->ended[i] && !is_available(frame->end_queries[i])))
+			return 0;
+	}
+
+	for (int i = 0; i < frame->section_count; ++i) {
+		timer->results[i] = frame->sections[i];
+		// A section left open has no end timestamp to read
+		if (!frame->ended[i])
+			continue;
+		GLuint64 begin = query_result(frame->begin_queries[i]);
+		GLuint64 end = query_result(frame->end_queries[i]);
+		timer->results[i].gpu_ms =
+			end > begin ? (double)(end - begin) / 1000000.0 : 0.0;
+	}
+
+	timer->result_count = frame->section_count;
+	timer->gpu_frame_ms =
+		(double)query_result(frame->elapsed_query) / 1000000.0;
+	timer->cpu_frame_ms = frame->cpu_frame_ms;
+	frame->pending = 0;
+	return 1;
+}
+
+struct gpu_timer *odc_gpu_timer_new(void)
+{
+	struct gpu_timer *timer =
+		(struct gpu_timer *)calloc(1, sizeof(*timer));
+	if (!timer) {
+		fprintf(stderr, "ERROR::GPU_TIMER: Failed to allocate timer\n");
+		return NULL;
+	}
+
+	for (int i = 0; i < GPU_TIMER_FRAMES; ++i) {
+		struct timer_frame *frame = &timer->frames[i];
+		glGenQueries(1, &frame->elapsed_query);
+		glGenQueries(GPU_TIMER_MAX_SECTIONS, frame->begin_queries);
+		glGenQueries(GPU_TIMER_MAX_SECTIONS, frame->end_queries);
+	}
+
+	return timer;
+}
+
+void odc_gpu_timer_destroy(struct gpu_timer *timer)
+{
+	if (!timer)
+		return;
+
+	if (timer->current)
+		glEndQuery(GL_TIME_ELAPSED);
+
+	for (int i = 0; i < GPU_TIMER_FRAMES; ++i) {
+		struct timer_frame *frame = &timer->frames[i];
+		glDeleteQueries(1, &frame->elapsed_query);
+		glDeleteQueries(GPU_TIMER_MAX_SECTIONS, frame->begin_queries);
+		glDeleteQueries(GPU_TIMER_MAX_SECTIONS, frame->end_queries);
+	}
+
+	free(timer);
+}
+
+void odc_gpu_timer_begin_frame(struct gpu_timer *timer)
+{
+	if (!timer || timer->current)
+		return;
+
+	struct timer_frame *frame = &timer->frames[timer->next];
+	if (!resolve_frame(timer, frame)) {
+		timer->dropped_frames++;
+		return;
+	}
+
+	frame->section_count = 0;
+	frame->cpu_frame_begin = now_ms();
+	timer->depth = 0;
+	timer->current = frame;
+	glBeginQuery(GL_TIME_ELAPSED, frame->elapsed_query);
+}
+
+void odc_gpu_timer_end_frame(struct gpu_timer *timer)
+{
+	if (!timer || !timer->current)
+		return;
+
+	struct timer_frame *frame = timer->current;
+	glEndQuery(GL_TIME_ELAPSED);
+	frame->cpu_frame_ms = now_ms() - frame->cpu_frame_begin;
+	frame->pending = 1;
+	timer->current = NULL;
+	timer->next = (timer->next + 1) % GPU_TIMER_FRAMES;
+
+	// Oldest first, so the newest finished frame ends up in the results
+	for (int i = 0; i < GPU_TIMER_FRAMES; ++i) {
+		struct timer_frame *pending =
+			&timer->frames[(timer->next + i) % GPU_TIMER_FRAMES];
+		if (!resolve_frame(timer, pending))
+			break;
+	}
+}
+
+int odc_gpu_timer_begin(struct gpu_timer *timer, const char *name)
+{
+	if (!timer || !timer->current ||
+	    timer->current->section_count >= GPU_TIMER_MAX_SECTIONS)
+		return -1;
+
+	struct timer_frame *frame = timer->current;
+	int section = frame->section_count++;
+	frame->sections[section].name = name;
+	frame->sections[section].depth = timer->depth++;
+	frame->sections[section].gpu_ms = 0.0;
+	frame->sections[section].cpu_ms = 0.0;
+	frame->cpu_begin[section] = now_ms();
+	frame->ended[section] = 0;
+	glQueryCounter(frame->begin_queries[section], GL_TIMESTAMP);
+	return section;
+}
+
+void odc_gpu_timer_end(struct gpu_timer *timer, int section)
+{
+	if (!timer || !timer->current || section < 0 ||
+	    section >= timer->current->section_count)
+		return;
+
+	struct timer_frame *frame = timer->current;
+	glQueryCounter(frame->end_queries[section], GL_TIMESTAMP);
+	frame->ended[section] = 1;
+	frame->sections[section].cpu_ms = now_ms() - frame->cpu_begin[section];
+	timer->depth--;
+}
+
+int odc_gpu_timer_get_sections(struct gpu_timer *timer,
+			       const struct gpu_timer_section **sections)
+{
+	*sections = timer->results;
+	return timer->result_count;
+}
+
+double odc_gpu_timer_get_gpu_frame_time(struct gpu_timer *timer)
+{
+	return timer->gpu_frame_ms;
+}
+
+double odc_gpu_timer_get_cpu_frame_time(struct gpu_timer *timer)
+{
+	return timer->cpu_frame_ms;
+}
+
+unsigned long odc_gpu_timer_get_dropped_frames(struct gpu_timer *timer)
+{
+	return timer->dropped_frames;
+}
@@ -0,0 +1,714 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "odc_image.h"
+
+#define MAX_IMAGE_DIMENSION 16384
+
+static uint32_t read_be32(const unsigned char *p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+	       ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static int valid_size(uint32_t width, uint32_t height)
+{
+	return width > 0 && height > 0 && width <= MAX_IMAGE_DIMENSION &&
+	       height <= MAX_IMAGE_DIMENSION;
+}
+
+// QOI
+
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF 0x40
+#define QOI_OP_LUMA 0x80
+#define QOI_OP_RUN 0xc0
+#define QOI_OP_RGB 0xfe
+#define QOI_OP_RGBA 0xff
+#define QOI_MASK_2 0xc0
+#define QOI_HEADER_SIZE 14
+
+static unsigned char *decode_qoi(const unsigned char *data, size_t size,
+				 int *width, int *height)
+{
+	if (size < QOI_HEADER_SIZE)
+		return NULL;
+
+	uint32_t w = read_be32(data + 4);
+	uint32_t h = read_be32(data + 8);
+	if (!valid_size(w, h))
+		return NULL;
+
+	size_t pixel_count = (size_t)w * h;
+	unsigned char *pixels = (unsigned char *)malloc(pixel_count * 4);
+	if (!pixels)
+		return NULL;
+
+	unsigned char index[64][4];
+	memset(index, 0, sizeof(index));
+	unsigned char px[4] = { 0, 0, 0, 255 };
+	size_t p = QOI_HEADER_SIZE;
+	int run = 0;
+
+	for (size_t i = 0; i < pixel_count; ++i) {
+		if (run > 0) {
+			run--;
+		} else {
+			if (p >= size)
+				goto fail;
+
+			int b1 = data[p++];
+			if (b1 == QOI_OP_RGB) {
+				if (p + 3 > size)
+					goto fail;
+				px[0] = data[p++];
+				px[1] = data[p++];
+				px[2] = data[p++];
+			} else if (b1 == QOI_OP_RGBA) {
+				if (p + 4 > size)
+					goto fail;
+				memcpy(px, data + p, 4);
+				p += 4;
+			} else if ((b1 & QOI_MASK_2) == QOI_OP_INDEX) {
+				memcpy(px, index[b1], 4);
+			} else if ((b1 & QOI_MASK_2) == QOI_OP_DIFF) {
+				px[0] += ((b1 >> 4) & 0x03) - 2;
+				px[1] += ((b1 >> 2) & 0x03) - 2;
+				px[2] += (b1 & 0x03) - 2;
+			} else if ((b1 & QOI_MASK_2) == QOI_OP_LUMA) {
+				if (p >= size)
+					goto fail;
+				int b2 = data[p++];
+				int vg = (b1 & 0x3f) - 32;
+				px[0] += vg - 8 + ((b2 >> 4) & 0x0f);
+				px[1] += vg;
+				px[2] += vg - 8 + (b2 & 0x0f);
+			} else {
+				run = b1 & 0x3f;
+			}
+
+			int hash = (px[0] * 3 + px[1] * 5 + px[2] * 7 +
+				    px[3] * 11) % 64;
+			memcpy(index[hash], px, 4);
+		}
+
+		memcpy(pixels + i * 4, px, 4);
+	}
+
+	*width = (int)w;
+	*height = (int)h;
+	return pixels;
+
+fail:
+	fprintf(stderr, "ERROR::IMAGE: Truncated QOI image\n");
+	free(pixels);
+	return NULL;
+}
+
+// Inflate (RFC 1951), used by the PNG decoder
+
+struct bit_reader {
+	const unsigned char *data;
+	size_t size;
+	size_t pos;
+	uint32_t bits;
+	int count;
+	int overflow;
+};
+
+struct huffman {
+	unsigned short counts[16];
+	unsigned short symbols[288];
+};
+
+struct inflate_output {
+	unsigned char *data;
+	size_t size;
+	size_t capacity;
+};
+
+static const unsigned short length_base[29] = {
+	3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+	31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const unsigned char length_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+						1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+						4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const unsigned short dist_base[30] = {
+	1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+	33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+	1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const unsigned char dist_extra[30] = { 0, 0, 0,	0,  1,	1,  2,	2,
+					      3, 3, 4,	4,  5,	5,  6,	6,
+					      7, 7, 8,	8,  9,	9,  10, 10,
+					      11, 11, 12, 12, 13, 13 };
+static const unsigned char code_length_order[19] = {
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+static int read_bits(struct bit_reader *br, int n)
+{
+	while (br->count < n) {
+		if (br->pos >= br->size) {
+			br->overflow = 1;
+			return 0;
+		}
+		br->bits |= (uint32_t)br->data[br->pos++] << br->count;
+		br->count += 8;
+	}
+
+	int value = (int)(br->bits & ((1u << n) - 1));
+	br->bits >>= n;
+	br->count -= n;
+	return value;
+}
+
+static void build_huffman(struct huffman *h, const unsigned char *lengths,
+			 int n)
+{
+	unsigned short offsets[16];
+
+	memset(h->counts, 0, sizeof(h->counts));
+	for (int i = 0; i < n; ++i)
+		h->counts[lengths[i]]++;
+	h->counts[0] = 0;
+
+	offsets[1] = 0;
+	for (int len = 1; len < 15; ++len)
+		offsets[len + 1] = offsets[len] + h->counts[len];
+
+	for (int i = 0; i < n; ++i) {
+		if (lengths[i])
+			h->symbols[offsets[lengths[i]]++] = (unsigned short)i;
+	}
+}
+
+static int decode_symbol(struct bit_reader *br, const struct huffman *h)
+{
+	int code = 0, first = 0, index = 0;
+
+	for (int len = 1; len < 16; ++len) {
+		code |= read_bits(br, 1);
+		int count = h->counts[len];
+		if (code - count < first)
+			return h->symbols[index + (code - first)];
+		index += count;
+		first = (first + count) << 1;
+		code <<= 1;
+	}
+
+	return -1;
+}
+
+static int inflate_codes(struct bit_reader *br, struct inflate_output *out,
+			 const struct huffman *lengths,
+			 const struct huffman *distances)
+{
+	for (;;) {
+		int symbol = decode_symbol(br, lengths);
+		if (symbol < 0 || br->overflow)
+			return -1;
+
+		if (symbol < 256) {
+			if (out->size >= out->capacity)
+				return -1;
+			out->data[out->size++] = (unsigned char)symbol;
+			continue;
+		}
+		if (symbol == 256)
+			return 0;
+
+		symbol -= 257;
+		if (symbol >= 29)
+			return -1;
+		int length = length_base[symbol] +
+			     read_bits(br, length_extra[symbol]);
+
+		symbol = decode_symbol(br, distances);
+		if (symbol < 0 || symbol >= 30)
+			return -1;
+		size_t distance = dist_base[symbol] +
+				  read_bits(br, dist_extra[symbol]);
+
+		if (br->overflow || distance > out->size ||
+		    out->size + length > out->capacity)
+			return -1;
+		// Byte by byte because the copy may overlap its own output
+		for (int i = 0; i < length; ++i) {
+			out->data[out->size] = out->data[out->size - distance];
+			out->size++;
+		}
+	}
+}
+
+static int inflate_stored(struct bit_reader *br, struct inflate_output *out)
+{
+	// Stored blocks start on a byte boundary
+	br->bits = 0;
+	br->count = 0;
+
+	if (br->pos + 4 > br->size)
+		return -1;
+	unsigned int len = br->data[br->pos] | (br->data[br->pos + 1] << 8);
+	unsigned int nlen = br->data[br->pos + 2] |
+			    (br->data[br->pos + 3] << 8);
+	br->pos += 4;
+
+	if (len != (~nlen & 0xffff) || br->pos + len > br->size ||
+	    out->size + len > out->capacity)
+		return -1;
+
+	memcpy(out->data + out->size, br->data + br->pos, len);
+	br->pos += len;
+	out->size += len;
+	return 0;
+}
+
+static int inflate_fixed(struct bit_reader *br, struct inflate_output *out)
+{
+	struct huffman lengths, distances;
+	unsigned char l[288];
+
+	int i = 0;
+	for (; i < 144; ++i)
+		l[i] = 8;
+	for (; i < 256; ++i)
+		l[i] = 9;
+	for (; i < 280; ++i)
+		l[i] = 7;
+	for (; i < 288; ++i)
+		l[i] = 8;
+	build_huffman(&lengths, l, 288);
+
+	for (i = 0; i < 30; ++i)
+		l[i] = 5;
+	build_huffman(&distances, l, 30);
+
+	return inflate_codes(br, out, &lengths, &distances);
+}
+
+static int inflate_dynamic(struct bit_reader *br, struct inflate_output *out)
+{
+	struct huffman lengths, distances;
+	unsigned char l[320];
+
+	int nlen = read_bits(br, 5) + 257;
+	int ndist = read_bits(br, 5) + 1;
+	int ncode = read_bits(br, 4) + 4;
+	if (nlen > 286 || ndist > 30)
+		return -1;
+
+	memset(l, 0, 19);
+	for (int i = 0; i < ncode; ++i)
+		l[code_length_order[i]] = (unsigned char)read_bits(br, 3);
+	build_huffman(&lengths, l, 19);
+
+	int index = 0;
+	while (index < nlen + ndist) {
+		int symbol = decode_symbol(br, &lengths);
+		if (symbol < 0 || br->overflow)
+			return -1;
+
+		if (symbol < 16) {
+			l[index++] = (unsigned char)symbol;
+			continue;
+		}
+
+		int repeat;
+		unsigned char value = 0;
+		if (symbol == 16) {
+			if (index == 0)
+				return -1;
+			value = l[index - 1];
+			repeat = 3 + read_bits(br, 2);
+		} else if (symbol == 17) {
+			repeat = 3 + read_bits(br, 3);
+		} else {
+			repeat = 11 + read_bits(br, 7);
+		}
+
+		if (index + repeat > nlen + ndist)
+			return -1;
+		while (repeat--)
+			l[index++] = value;
+	}
+
+	if (l[256] == 0)
+		return -1;
+
+	build_huffman(&lengths, l, nlen);
+	build_huffman(&distances, l + nlen, ndist);
+	return inflate_codes(br, out, &lengths, &distances);
+}
+
+static int zlib_inflate(const unsigned char *data, size_t size,
+			unsigned char *out_data, size_t out_size)
+{
+	// Two byte zlib header: deflate method, no preset dictionary
+	if (size < 2 || (data[0] & 0x0f) != 8 || (data[1] & 0x20) ||
+	    ((data[0] << 8) | data[1]) % 31 != 0)
+		return -1;
+
+	struct bit_reader br = { data + 2, size - 2, 0, 0, 0, 0 };
+	struct inflate_output out = { out_data, 0, out_size };
+
+	int last;
+	do {
+		last = read_bits(&br, 1);
+		int type = read_bits(&br, 2);
+
+		int result;
+		if (type == 0)
+			result = inflate_stored(&br, &out);
+		else if (type == 1)
+			result = inflate_fixed(&br, &out);
+		else if (type == 2)
+			result = inflate_dynamic(&br, &out);
+		else
+			result = -1;
+
+		if (result != 0 || br.overflow)
+			return -1;
+	} while (!last);
+
+	return out.size == out_size ? 0 : -1;
+}
+
+// PNG
+
+static const unsigned char png_signature[8] = { 137, 80, 78, 71,
+						13,  10, 26, 10 };
+
+static int paeth(int a, int b, int c)
+{
+	int p = a + b - c;
+	int pa = abs(p - a);
+	int pb = abs(p - b);
+	int pc = abs(p - c);
+	if (pa <= pb && pa <= pc)
+		return a;
+	return pb <= pc ? b : c;
+}
+
+static int png_unfilter(unsigned char *data, int width, int height,
+			int channels)
+{
+	size_t stride = (size_t)width * channels;
+	unsigned char *prev = NULL;
+
+	for (int y = 0; y < height; ++y) {
+		unsigned char *row = data + y * (stride + 1);
+		int filter = row[0];
+		unsigned char *cur = row + 1;
+
+		for (size_t x = 0; x < stride; ++x) {
+			int a = x >= (size_t)channels ? cur[x - channels] : 0;
+			int b = prev ? prev[x] : 0;
+			int c = prev && x >= (size_t)channels
+					? prev[x - channels]
+					: 0;
+
+			switch (filter) {
+			case 0:
+				break;
+			case 1:
+				cur[x] += a;
+				break;
+			case 2:
+				cur[x] += b;
+				break;
+			case 3:
+				cur[x] += (a + b) / 2;
+				break;
+			case 4:
+				cur[x] += paeth(a, b, c);
+				break;
+			default:
+				return -1;
+			}
+		}
+		prev = cur;
+	}
+
+	return 0;
+}
+
+static unsigned char *decode_png(const unsigned char *data, size_t size,
+				 int *width, int *height)
+{
+	uint32_t w = 0, h = 0;
+	int color_type = -1, channels = 0;
+	unsigned char palette[256][4];
+	int palette_size = 0;
+	unsigned char *idat = NULL;
+	size_t idat_size = 0;
+	unsigned char *pixels = NULL;
+	unsigned char *raw = NULL;
+
+	memset(palette, 255, sizeof(palette));
+
+	size_t p = 8;
+	while (p + 12 <= size) {
+		uint32_t length = read_be32(data + p);
+		const unsigned char *type = data + p + 4;
+		const unsigned char *chunk = data + p + 8;
+		if (length > size - p - 12)
+			goto fail;
+
+		if (!memcmp(type, "IHDR", 4)) {
+			if (length < 13)
+				goto fail;
+			w = read_be32(chunk);
+			h = read_be32(chunk + 4);
+			color_type = chunk[9];
+			if (!valid_size(w, h) || chunk[8] != 8 ||
+			    chunk[10] != 0 || chunk[11] != 0 ||
+			    chunk[12] != 0) {
+				fprintf(stderr,
+					"ERROR::IMAGE: Only 8-bit non-interlaced "
+					"PNG images are supported\n");
+				goto fail;
+			}
+			static const int channel_counts[7] = { 1, 0, 3, 1,
+								2, 0, 4 };
+			if (color_type > 6 || !channel_counts[color_type])
+				goto fail;
+			channels = channel_counts[color_type];
+		} else if (!memcmp(type, "PLTE", 4)) {
+			palette_size = length / 3;
+			if (palette_size > 256)
+				goto fail;
+			for (int i = 0; i < palette_size; ++i)
+				memcpy(palette[i], chunk + i * 3, 3);
+		} else if (!memcmp(type, "tRNS", 4)) {
+			if (color_type == 3) {
+				for (uint32_t i = 0; i < length && i < 256; ++i)
+					palette[i][3] = chunk[i];
+			}
+		} else if (!memcmp(type, "IDAT", 4)) {
+			unsigned char *grown =
+				(unsigned char *)realloc(idat, idat_size + length);
+			if (!grown)
+				goto fail;
+			idat = grown;
+			memcpy(idat + idat_size, chunk, length);
+			idat_size += length;
+		} else if (!memcmp(type, "IEND", 4)) {
+			break;
+		}
+
+		p += length + 12;
+	}
+
+	if (!channels || !idat)
+		goto fail;
+
+	size_t raw_size = (size_t)h * ((size_t)w * channels + 1);
+	raw = (unsigned char *)malloc(raw_size);
+	pixels = (unsigned char *)malloc((size_t)w * h * 4);
+	if (!raw || !pixels)
+		goto fail;
+
+	if (zlib_inflate(idat, idat_size, raw, raw_size) != 0 ||
+	    png_unfilter(raw, (int)w, (int)h, channels) != 0) {
+		fprintf(stderr, "ERROR::IMAGE: Corrupt PNG image data\n");
+		goto fail;
+	}
+
+	for (uint32_t y = 0; y < h; ++y) {
+		const unsigned char *src = raw + y * ((size_t)w * channels + 1) + 1;
+		unsigned char *dst = pixels + (size_t)y * w * 4;
+		for (uint32_t x = 0; x < w; ++x, src += channels, dst += 4) {
+			switch (color_type) {
+			case 0:
+				dst[0] = dst[1] = dst[2] = src[0];
+				dst[3] = 255;
+				break;
+			case 2:
+				memcpy(dst, src, 3);
+				dst[3] = 255;
+				break;
+			case 3:
+				memcpy(dst, palette[src[0]], 4);
+				break;
+			case 4:
+				dst[0] = dst[1] = dst[2] = src[0];
+				dst[3] = src[1];
+				break;
+			default:
+				memcpy(dst, src, 4);
+				break;
+			}
+		}
+	}
+
+	free(raw);
+	free(idat);
+	*width = (int)w;
+	*height = (int)h;
+	return pixels;
+
+fail:
+	free(raw);
+	free(idat);
+	free(pixels);
+	return NULL;
+}
+
+// TGA
+
+#define TGA_HEADER_SIZE 18
+
+static unsigned char *decode_tga(const unsigned char *data, size_t size,
+				 int *width, int *height)
+{
+	if (size < TGA_HEADER_SIZE)
+		return NULL;
+
+	int id_length = data[0];
+	int colormap_type = data[1];
+	int image_type = data[2];
+	int w = data[12] | (data[13] << 8);
+	int h = data[14] | (data[15] << 8);
+	int bits = data[16];
+	int descriptor = data[17];
+
+	int rle = image_type == 10 || image_type == 11;
+	int gray = image_type == 3 || image_type == 11;
+	int bytes = bits / 8;
+	if (colormap_type != 0 || !valid_size(w, h) ||
+	    (image_type != 2 && image_type != 3 && !rle) ||
+	    (gray && bits != 8) || (!gray && bits != 24 && bits != 32)) {
+		fprintf(stderr, "ERROR::IMAGE: Unsupported TGA image\n");
+		return NULL;
+	}
+
+	unsigned char *pixels = (unsigned char *)malloc((size_t)w * h * 4);
+	if (!pixels)
+		return NULL;
+
+	size_t p = TGA_HEADER_SIZE + id_length;
+	size_t pixel_count = (size_t)w * h;
+	size_t i = 0;
+	while (i < pixel_count) {
+		size_t count = 1;
+		int repeat = 0;
+		if (rle) {
+			if (p >= size)
+				break;
+			int packet = data[p++];
+			count = (packet & 0x7f) + 1;
+			repeat = packet & 0x80;
+		} else {
+			count = pixel_count;
+		}
+
+		for (size_t n = 0; n < count && i < pixel_count; ++n, ++i) {
+			if (p + bytes > size)
+				goto fail;
+
+			const unsigned char *src = data + p;
+			unsigned char *dst = pixels + i * 4;
+			if (gray) {
+				dst[0] = dst[1] = dst[2] = src[0];
+				dst[3] = 255;
+			} else {
+				dst[0] = src[2];
+				dst[1] = src[1];
+				dst[2] = src[0];
+				dst[3] = bytes == 4 ? src[3] : 255;
+			}
+
+			if (!repeat || n + 1 == count)
+				p += bytes;
+		}
+	}
+
+	if (i < pixel_count)
+		goto fail;
+
+	// Bottom-up is the TGA default unless the descriptor says otherwise
+	if (!(descriptor & 0x20))
+		odc_image_flip_rows(pixels, w, h);
+
+	*width = w;
+	*height = h;
+	return pixels;
+
+fail:
+	fprintf(stderr, "ERROR::IMAGE: Truncated TGA image\n");
+	free(pixels);
+	return NULL;
+}
+
+unsigned char *odc_image_decode(const unsigned char *data, size_t size,
+				int *width, int *height)
+{
+	if (size >= 4 && !memcmp(data, "qoif", 4))
+		return decode_qoi(data, size, width, height);
+	if (size >= 8 && !memcmp(data, png_signature, 8))
+		return decode_png(data, size, width, height);
+
+	// TGA has no magic number, so it is the fallback
+	return decode_tga(data, size, width, height);
+}
+
+unsigned char *odc_image_load(const char *path, int *width, int *height)
+{
+	FILE *file = fopen(path, "rb");
+	if (!file) {
+		fprintf(stderr, "ERROR::IMAGE: Failed to open %s\n", path);
+		return NULL;
+	}
+
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	unsigned char *data = size > 0 ? (unsigned char *)malloc(size) : NULL;
+	if (!data || fread(data, 1, size, file) != (size_t)size) {
+		fprintf(stderr, "ERROR::IMAGE: Failed to read %s\n", path);
+		free(data);
+		fclose(file);
+		return NULL;
+	}
+	fclose(file);
+
+	unsigned char *pixels = odc_image_decode(data, size, width, height);
+	if (!pixels)
+		fprintf(stderr, "ERROR::IMAGE: Failed to decode %s\n", path);
+
+	free(data);
+	return pixels;
+}
+
+void odc_image_flip_rows(unsigned char *pixels, int width, int height)
+{
+	size_t stride = (size_t)width * 4;
+	unsigned char *row = (unsigned char *)malloc(stride);
+	if (!row)
+		return;
+
+	for (int y = 0; y < height / 2; ++y) {
+		unsigned char *top = pixels + y * stride;
+		unsigned char *bottom = pixels + (height - 1 - y) * stride;
+		memcpy(row, top, stride);
+		memcpy(top, bottom, stride);
+		memcpy(bottom, row, stride);
+	}
+
+	free(row);
+}
+
+int odc_image_is_opaque(const unsigned char *pixels, int width, int height)
+{
+	size_t count = (size_t)width * height;
+	for (size_t i = 0; i < count; ++i) {
+		if (pixels[i * 4 + 3] != 255)
+			return 0;
+	}
+	return 1;
+}
@@ -0,0 +1,334 @@
+#include "glad.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "odc_gl_state.h"
+#include "odc_render_target.h"
+
+struct render_target {
+	GLuint framebuffer;
+	GLuint color;
+	GLuint depth;
+	int storage_width;
+	int storage_height;
+	int width;
+	int height;
+	int output_width;
+	int output_height;
+	GLint output_framebuffer;
+	float scale;
+	int fixed_width;
+	int fixed_height;
+	enum render_target_filter filter;
+	int integer_scaling;
+	double target_time;
+	float min_scale;
+	float max_scale;
+	double average_time;
+	int settle_frames;
+};
+
+static float clamp_scale(float scale, float min_scale, float max_scale)
+{
+	if (scale < min_scale)
+		return min_scale;
+	if (scale > max_scale)
+		return max_scale;
+	return scale;
+}
+
+static void release_storage(struct render_target *target)
+{
+	if (target->framebuffer)
+		glDeleteFramebuffers(1, &target->framebuffer);
+	if (target->depth)
+		glDeleteRenderbuffers(1, &target->depth);
+	if (target->color)
+		odc_gl_state_delete_textures(1, &target->color);
+
+	target->framebuffer = 0;
+	target->color = 0;
+	target->depth = 0;
+	target->storage_width = 0;
+	target->storage_height = 0;
+}
+
+static int allocate_storage(struct render_target *target, int width,
+			    int height)
+{
+	release_storage(target);
+
+	glGenTextures(1, &target->color);
+	odc_gl_state_bind_texture(GL_TEXTURE_2D, target->color);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA,
+		     GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glGenRenderbuffers(1, &target->depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, target->depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width,
+			      height);
+
+	glGenFramebuffers(1, &target->framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+			       GL_TEXTURE_2D, target->color, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+				  GL_RENDERBUFFER, target->depth);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) !=
+	    GL_FRAMEBUFFER_COMPLETE) {
+		fprintf(stderr,
+			"ERROR::RENDER_TARGET: Framebuffer %dx%d is incomplete\n",
+			width, height);
+		release_storage(target);
+		return -1;
+	}
+
+	target->storage_width = width;
+	target->storage_height = height;
+	return 0;
+}
+
+struct render_target *odc_render_target_new(void)
+{
+	struct render_target *target =
+		(struct render_target *)calloc(1, sizeof(*target));
+	if (!target) {
+		fprintf(stderr,
+			"ERROR::RENDER_TARGET: Failed to allocate render target\n");
+		return NULL;
+	}
+
+	target->scale = 1.0f;
+	target->min_scale = RENDER_TARGET_MIN_SCALE;
+	target->max_scale = 1.0f;
+	return target;
+}
+
+void odc_render_target_destroy(struct render_target *target)
+{
+	if (!target)
+		return;
+
+	release_storage(target);
+	free(target);
+}
+
+void odc_render_target_set_scale(struct render_target *target, float scale)
+{
+	target->scale = clamp_scale(scale, RENDER_TARGET_MIN_SCALE, 1.0f);
+}
+
+float odc_render_target_get_scale(struct render_target *target)
+{
+	return target->scale;
+}
+
+void odc_render_target_set_fixed_size(struct render_target *target, int width,
+				      int height)
+{
+	if (width <= 0 || height <= 0) {
+		target->fixed_width = 0;
+		target->fixed_height = 0;
+		return;
+	}
+
+	target->fixed_width = width;
+	target->fixed_height = height;
+}
+
+void odc_render_target_set_filter(struct render_target *target,
+				  enum render_target_filter filter)
+{
+	target->filter = filter;
+}
+
+void odc_render_target_set_integer_scaling(struct render_target *target,
+					   int enabled)
+{
+	target->integer_scaling = enabled;
+}
+
+void odc_render_target_set_frame_time_target(struct render_target *target,
+					     double seconds, float min_scale,
+					     float max_scale)
+{
+	target->target_time = seconds > 0.0 ? seconds : 0.0;
+	target->min_scale =
+		clamp_scale(min_scale, RENDER_TARGET_MIN_SCALE, 1.0f);
+	target->max_scale = clamp_scale(max_scale, target->min_scale, 1.0f);
+	target->average_time = 0.0;
+	target->settle_frames = 0;
+	target->scale = clamp_scale(target->scale, target->min_scale,
+				    target->max_scale);
+}
+
+void odc_render_target_update(struct render_target *target, double frame_time)
+{
+	if (target->target_time <= 0.0 || target->fixed_width ||
+	    frame_time <= 0.0)
+		return;
+
+	target->average_time = target->average_time > 0.0
+				       ? target->average_time * 0.9 +
+						 frame_time * 0.1
+				       : frame_time;
+
+	// Give the new size a few frames to show up in the average
+	if (target->settle_frames > 0) {
+		target->settle_frames--;
+		return;
+	}
+
+	float scale = target->scale;
+	if (target->average_time > target->target_time * 1.05) {
+		// Fill cost follows the pixel count, which is the scale squared
+		float factor =
+			(float)sqrt(target->target_time / target->average_time);
+		scale *= factor < 0.75f ? 0.75f : factor;
+		target->average_time = 0.0;
+	} else if (target->average_time < target->target_time * 1.02) {
+		scale += RENDER_TARGET_SCALE_STEP;
+	}
+
+	scale = clamp_scale(scale, target->min_scale, target->max_scale);
+	if (scale != target->scale) {
+		target->scale = scale;
+		target->settle_frames = RENDER_TARGET_SETTLE_FRAMES;
+	}
+}
+
+int odc_render_target_begin(struct render_target *target, int output_width,
+			    int output_height)
+{
+	if (output_width <= 0 || output_height <= 0)
+		return -1;
+
+	target->output_width = output_width;
+	target->output_height = output_height;
+
+	int storage_width, storage_height;
+	if (target->fixed_width) {
+		storage_width = target->fixed_width;
+		storage_height = target->fixed_height;
+		target->width = target->fixed_width;
+		target->height = target->fixed_height;
+	} else {
+		// The controller only moves the viewport inside storage sized
+		// for its largest scale, so it never reallocates
+		float storage_scale = target->target_time > 0.0
+					      ? target->max_scale
+					      : target->scale;
+		storage_width = (int)ceilf(output_width * storage_scale);
+		storage_height = (int)ceilf(output_height * storage_scale);
+		target->width = (int)(output_width * target->scale + 0.5f);
+		target->height = (int)(output_height * target->scale + 0.5f);
+	}
+
+	if (target->width < 1)
+		target->width = 1;
+	if (target->height < 1)
+		target->height = 1;
+	if (target->width > storage_width)
+		target->width = storage_width;
+	if (target->height > storage_height)
+		target->height = storage_height;
+
+	// Present goes back to whatever was bound, which is the window unless
+	// the caller renders offscreen itself
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &target->output_framebuffer);
+	if ((GLuint)target->output_framebuffer == target->framebuffer)
+		target->output_framebuffer = 0;
+
+	if (storage_width != target->storage_width ||
+	    storage_height != target->storage_height) {
+		if (allocate_storage(target, storage_width, storage_height) !=
+		    0) {
+			glBindFramebuffer(GL_FRAMEBUFFER,
+					  target->output_framebuffer);
+			return -1;
+		}
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer);
+	glViewport(0, 0, target->width, target->height);
+	return 0;
+}
+
+static void get_present_rect(struct render_target *target, int *x, int *y,
+			     int *width, int *height)
+{
+	int ow = target->output_width;
+	int oh = target->output_height;
+	int w = target->width;
+	int h = target->height;
+
+	if (!target->fixed_width) {
+		*x = 0;
+		*y = 0;
+		*width = ow;
+		*height = oh;
+		return;
+	}
+
+	int multiple = ow / w < oh / h ? ow / w : oh / h;
+	if (target->integer_scaling && multiple >= 1) {
+		*width = w * multiple;
+		*height = h * multiple;
+	} else if ((long)ow * h > (long)oh * w) {
+		*width = (int)((long)w * oh / h);
+		*height = oh;
+	} else {
+		*width = ow;
+		*height = (int)((long)h * ow / w);
+	}
+
+	*x = (ow - *width) / 2;
+	*y = (oh - *height) / 2;
+}
+
+void odc_render_target_present(struct render_target *target)
+{
+	if (!target->framebuffer)
+		return;
+
+	int x, y, width, height;
+	get_present_rect(target, &x, &y, &width, &height);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, target->framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target->output_framebuffer);
+	glViewport(0, 0, target->output_width, target->output_height);
+
+	if (width < target->output_width || height < target->output_height) {
+		GLfloat clear_color[4];
+		glGetFloatv(GL_COLOR_CLEAR_VALUE, clear_color);
+		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		glClearColor(clear_color[0], clear_color[1], clear_color[2],
+			     clear_color[3]);
+	}
+
+	glBlitFramebuffer(0, 0, target->width, target->height, x, y,
+			  x + width, y + height, GL_COLOR_BUFFER_BIT,
+			  target->filter == RENDER_TARGET_LINEAR ? GL_LINEAR
+								 : GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, target->output_framebuffer);
+}
+
+void odc_render_target_get_size(struct render_target *target, int *width,
+				int *height)
+{
+	*width = target->width;
+	*height = target->height;
+}
+
+GLuint odc_render_target_get_texture(struct render_target *target)
+{
+	return target->color;
+}
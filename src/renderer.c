@@ -7,37 +7,74 @@
 #include <string.h>
 
 #include "odc_font.h"
+#include "odc_gl_state.h"
+#include "odc_gpu_timer.h"
+#include "odc_image.h"
+#include "odc_render_target.h"
 #include "odc_renderer.h"
 #include "odc_shader.h"
+#include "odc_shape_batch.h"
+#include "odc_text_layout.h"
+#include "odc_texture_manager.h"
+#include "odc_texture_stream.h"
 
-#define ATLAS_WIDTH 512
-#define ATLAS_HEIGHT 512
-#define MAX_TEXTURES 100
+#define MAX_SAMPLERS 16
 
-struct texture {
+#define STRINGIFY(x) #x
+#define TO_STRING(x) STRINGIFY(x)
+
+struct sampler {
 	GLuint id;
+	GLenum min_filter;
+	GLenum mag_filter;
+	GLenum wrap_s;
+	GLenum wrap_t;
 };
 
-struct vertex {
-	float fs_quad_pos[2];
-	float shape_pos[2];
-	float local_pos[2];
-	float op_code;
-	float radius;
-	float width;
-	float height;
-	float color[4];
-	float resolution[2];
-	float tex_coord[2];
+struct renderer_uniforms {
+	GLint resolution;
+	GLint time;
+	GLint anim_frames;
+	GLint anim_params;
+	GLint overdraw;
+	GLint sdf_text;
 };
 
 struct renderer {
-	struct vertex vertices[MAX_SHAPES * 6];
-	struct texture textures[MAX_TEXTURES];
-	int texture_count;
-	unsigned int VAO, VBO;
-	int shape_count;
+	struct shape_batch *batch;
+	struct text_layout_cache *text_layouts;
+	struct texture_manager *textures;
+	struct texture_stream *stream;
+	struct sampler samplers[MAX_SAMPLERS];
+	int sampler_count;
+	unsigned int VAO, VBO, EBO;
+	int depth_sorting;
+	int overdraw;
 	GLuint shader_program;
+	struct renderer_uniforms uniforms;
+	float resolution[2];
+	int viewport_width;
+	int viewport_height;
+	// -1 until the engine says whether its framebuffer has depth; then
+	// draw looks it up once per framebuffer binding instead
+	int output_depth;
+	GLint depth_framebuffer;
+	int depth_framebuffer_has_depth;
+	struct render_target *target;
+	int target_active;
+	struct gpu_timer *timer;
+	struct renderer_stats stats;
+	GLuint palette_texture;
+	int palette_size;
+	int palette_count;
+	float animation_frames[MAX_SPRITE_ANIMATIONS][4];
+	float animation_params[MAX_SPRITE_ANIMATIONS][4];
+	int animation_count;
+	int animations_dirty;
+	float time;
+	char *custom_shapes[MAX_CUSTOM_SHAPES];
+	int custom_shape_count;
+	int compiled_shape_count;
 	struct font font;
 };
 
@@ -70,6 +107,11 @@ const char *vertexShaderSource =
 	"layout(location = 7) in float in_height;\n"
 	"layout(location = 8) in vec2 in_tex_coord;\n"
 	"layout(location = 9) in vec2 in_resolution;\n"
+	"layout(location = 10) in vec2 in_anim;\n"
+
+	"uniform float u_time;\n"
+	"uniform vec4 u_anim_frames[" TO_STRING(MAX_SPRITE_ANIMATIONS) "];\n"
+	"uniform vec4 u_anim_params[" TO_STRING(MAX_SPRITE_ANIMATIONS) "];\n"
 
 	"out vec2 local_pos;\n"
 	"out float op_code;\n"
@@ -81,12 +123,14 @@ const char *vertexShaderSource =
 
 	"void main() {\n"
 	"    vec2 scaledShapePos = in_shape_pos;\n"
+	"    float depth = 1.0 - float(gl_VertexID / 6 + 1) * 2.0 / "
+	"float(" TO_STRING(MAX_SHAPES) " + 2);\n"
 	"    if (in_op_code == 4.0 || in_op_code == 5.0) {\n"
-	"        gl_Position = vec4(in_pos, 0.0, 1.0);\n"
+	"        gl_Position = vec4(in_pos, depth, 1.0);\n"
 	"    } else {\n"
 	"        gl_Position = vec4(scaledShapePos + in_local_pos / "
 	"in_resolution "
-	"* 2.0, 0.0, 1.0);\n"
+	"* 2.0, depth, 1.0);\n"
 	"    }\n"
 	"    local_pos = in_local_pos;\n"
 	"    op_code = in_op_code;\n"
@@ -95,9 +139,28 @@ const char *vertexShaderSource =
 	"    width = in_width;\n"
 	"    height = in_height;\n"
 	"    tex_coord = in_tex_coord;\n"
+	"    if (in_op_code == 8.0) {\n"
+	"        int id = int(in_anim.x + 0.5);\n"
+	"        vec4 rect = u_anim_frames[id];\n"
+	"        vec4 params = u_anim_params[id];\n"
+	"        float count = params.y;\n"
+	"        float frame = floor(max(u_time - in_anim.y, 0.0) * params.z);\n"
+	"        if (params.w == 0.0) {\n"
+	"            frame = min(frame, count - 1.0);\n"
+	"        } else if (params.w == 1.0) {\n"
+	"            frame = mod(frame, count);\n"
+	"        } else {\n"
+	"            float period = max(2.0 * count - 2.0, 1.0);\n"
+	"            frame = mod(frame, period);\n"
+	"            if (frame >= count) frame = period - frame;\n"
+	"        }\n"
+	"        vec2 cell = vec2(mod(frame, params.x), floor(frame / "
+	"params.x));\n"
+	"        tex_coord = rect.xy + (cell + in_tex_coord) * rect.zw;\n"
+	"    }\n"
 	"}\n";
 
-const char *fragmentShaderSource =
+const char *fragmentShaderHeader =
 	"#version 330 core\n"
 	"in vec2 local_pos;\n"
 	"in float op_code;\n"
@@ -111,6 +174,9 @@ const char *fragmentShaderSource =
 
 	"uniform sampler2D font_sampler;\n"
 	"uniform sampler2D texture_sampler;\n"
+	"uniform sampler2D palette_sampler;\n"
+	"uniform float u_overdraw;\n"
+	"uniform float u_sdf_text;\n"
 
 	"const float OP_CODE_CIRCLE = 1.0;\n"
 	"const float OP_CODE_ROUNDED_RECT = 2.0;\n"
@@ -118,6 +184,8 @@ const char *fragmentShaderSource =
 	"const float OP_CODE_REGULAR_TRIANGLE = 4.0;\n"
 	"const float OP_CODE_TEXT = 5.0;\n"
 	"const float OP_CODE_TEXTURE = 6.0;\n"
+	"const float OP_CODE_INDEXED_TEXTURE = 7.0;\n"
+	"const float OP_CODE_ANIMATED_SPRITE = 8.0;\n"
 
 	"float sdCircle(vec2 p, float r) {\n"
 	"    return length(p) - r;\n"
@@ -126,7 +194,7 @@ const char *fragmentShaderSource =
 	"float sdRoundedRect(vec2 p, vec2 bounds, float r) {\n"
 	"    vec2 b = bounds - vec2(r);\n"
 	"    vec2 q = abs(p) - b;\n"
-	"    return length(max(q, 0.0)) - r;\n"
+	"    return length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - r;\n"
 	"}\n"
 
 	"float sdEquilateralTriangle(vec2 p) {\n"
@@ -138,8 +206,11 @@ const char *fragmentShaderSource =
 	"2.0;\n"
 	"    p.x -= clamp(p.x, -1.0, 0.0);\n"
 	"    return -length(p) * sign(p.y);\n"
-	"}\n"
+	"}\n";
 
+// Registered custom shapes are spliced in between these pieces: their SDF
+// functions after the header and their branches after the built-in ones
+const char *fragmentShaderMain =
 	"void main() {\n"
 	"    vec2 p = local_pos;\n"
 	"    fragColor = vec4(color.rgb, 0.0);\n"
@@ -164,15 +235,123 @@ const char *fragmentShaderSource =
 	"        fragColor = color;\n"
 	"    } else if (op_code == OP_CODE_TEXT) {\n"
 	"        float sampled = texture(font_sampler, tex_coord).r;\n"
+	"        if (u_sdf_text > 0.0) {\n"
+	"            float edge = 0.5 * fwidth(sampled);\n"
+	"            sampled = smoothstep(0.5 - edge, 0.5 + edge, sampled);\n"
+	"        }\n"
 	"        fragColor = vec4(color.rgb, sampled);\n"
-	"    } else if (op_code == OP_CODE_TEXTURE) {\n"
+	"    } else if (op_code == OP_CODE_TEXTURE || op_code == "
+	"OP_CODE_ANIMATED_SPRITE) {\n"
 	"        fragColor = texture(texture_sampler, tex_coord);\n"
+	"    } else if (op_code == OP_CODE_INDEXED_TEXTURE) {\n"
+	"        ivec2 size = textureSize(palette_sampler, 0);\n"
+	"        int index = int(texture(texture_sampler, tex_coord).r * "
+	"255.0 + 0.5);\n"
+	"        int row = int(radius + 0.5);\n"
+	"        fragColor = texelFetch(palette_sampler, ivec2(min(index, "
+	"size.x - 1), min(row, size.y - 1)), 0);\n";
+
+const char *fragmentShaderFooter =
+	"    }\n"
+	"    if (u_overdraw > 0.0) {\n"
+	"        fragColor = vec4(1.0);\n"
 	"    }\n"
 	"}\n";
 
+static char *build_fragment_source(struct renderer *renderer)
+{
+	char branch[256];
+	size_t length = strlen(fragmentShaderHeader) +
+			strlen(fragmentShaderMain) +
+			strlen(fragmentShaderFooter) + 1;
+	for (int i = 0; i < renderer->custom_shape_count; ++i) {
+		length += strlen(renderer->custom_shapes[i]) + sizeof(branch) * 2;
+	}
+
+	char *source = (char *)malloc(length);
+	if (!source)
+		return NULL;
+
+	char *end = source;
+	end += sprintf(end, "%s", fragmentShaderHeader);
+	for (int i = 0; i < renderer->custom_shape_count; ++i) {
+		end += sprintf(end,
+			       "float sdCustom%d(vec2 p, vec2 half_size, "
+			       "float param) {\n%s\n}\n",
+			       i, renderer->custom_shapes[i]);
+	}
+
+	end += sprintf(end, "%s", fragmentShaderMain);
+	for (int i = 0; i < renderer->custom_shape_count; ++i) {
+		snprintf(branch, sizeof(branch),
+			 "    } else if (op_code == %d.0) {\n"
+			 "        float sdf = sdCustom%d(p, vec2(width, height) "
+			 "* 0.5, radius);\n"
+			 "        if (sdf < 0.0) {\n"
+			 "            fragColor = color;\n"
+			 "        }\n",
+			 (int)OP_CODE_CUSTOM_BASE + i, i);
+		end += sprintf(end, "%s", branch);
+	}
+	sprintf(end, "%s", fragmentShaderFooter);
+
+	return source;
+}
+
+static void bind_program(struct renderer *renderer, GLuint program)
+{
+	renderer->shader_program = program;
+	renderer->uniforms.resolution =
+		glGetUniformLocation(program, "u_resolution");
+	renderer->uniforms.time = glGetUniformLocation(program, "u_time");
+	renderer->uniforms.anim_frames =
+		glGetUniformLocation(program, "u_anim_frames");
+	renderer->uniforms.anim_params =
+		glGetUniformLocation(program, "u_anim_params");
+	renderer->uniforms.overdraw =
+		glGetUniformLocation(program, "u_overdraw");
+	renderer->uniforms.sdf_text =
+		glGetUniformLocation(program, "u_sdf_text");
+
+	// Uniforms live in the program, so a new one needs everything again
+	renderer->resolution[0] = 0.0f;
+	renderer->resolution[1] = 0.0f;
+	renderer->animations_dirty = renderer->animation_count > 0;
+
+	// Sampler units never change, so they are set once here
+	odc_gl_state_use_program(program);
+	glUniform1i(glGetUniformLocation(program, "font_sampler"), 0);
+	glUniform1i(glGetUniformLocation(program, "texture_sampler"), 1);
+	glUniform1i(glGetUniformLocation(program, "palette_sampler"), 2);
+	glUniform1f(renderer->uniforms.overdraw,
+		    renderer->overdraw ? 1.0f : 0.0f);
+	glUniform1f(renderer->uniforms.sdf_text,
+		    renderer->font.sdf ? 1.0f : 0.0f);
+}
+
 struct renderer *odc_renderer_new()
 {
-	return (struct renderer *)malloc(sizeof(struct renderer));
+	struct renderer *renderer =
+		(struct renderer *)calloc(1, sizeof(struct renderer));
+	if (!renderer)
+		return NULL;
+
+	renderer->batch = odc_shape_batch_new();
+	renderer->text_layouts =
+		odc_text_layout_cache_new(TEXT_LAYOUT_CACHE_DEFAULT_ENTRIES);
+	renderer->textures = odc_texture_manager_new();
+	if (!renderer->batch || !renderer->text_layouts ||
+	    !renderer->textures) {
+		odc_shape_batch_destroy(renderer->batch);
+		odc_text_layout_cache_destroy(renderer->text_layouts);
+		odc_texture_manager_destroy(renderer->textures);
+		free(renderer);
+		return NULL;
+	}
+
+	renderer->output_depth = -1;
+	renderer->depth_framebuffer = -1;
+	return renderer;
 }
 
 void odc_renderer_init(struct renderer *renderer)
@@ -182,27 +361,36 @@ void odc_renderer_init(struct renderer *renderer)
 		return;
 	}
 
-	char error[256] = {0};
-	GLuint shader_program = odc_shader_new_program(
-		vertexShaderSource, fragmentShaderSource, error);
+	char error[MAX_SHADER_ERROR] = {0};
+	char *fragment_source = build_fragment_source(renderer);
+	GLuint shader_program =
+		fragment_source ? odc_shader_new_program(vertexShaderSource,
+							 fragment_source, error)
+				: 0;
+	free(fragment_source);
 	if (!shader_program) {
 		fprintf(stderr, "Shader compilation or linking error: %s\n",
 			error);
 		return;
 	}
 
-	renderer->shape_count = 0;
-	renderer->shader_program = shader_program;
+	odc_shape_batch_reset(renderer->batch);
+	renderer->depth_sorting = 1;
 
 	glGenVertexArrays(1, &(renderer->VAO));
 	glGenBuffers(1, &(renderer->VBO));
+	glGenBuffers(1, &(renderer->EBO));
 
-	glBindVertexArray(renderer->VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, renderer->VBO);
+	odc_gl_state_bind_vertex_array(renderer->VAO);
+	odc_gl_state_bind_buffer(GL_ARRAY_BUFFER, renderer->VBO);
 
 	glBufferData(GL_ARRAY_BUFFER, sizeof(struct vertex) * MAX_SHAPES * 6,
 		     NULL, GL_DYNAMIC_DRAW);
 
+	odc_gl_state_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, renderer->EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * MAX_SHAPES * 6,
+		     NULL, GL_DYNAMIC_DRAW);
+
 	glVertexAttribPointer(ATTRIB_POS_LOCATION, 2, GL_FLOAT, GL_FALSE,
 			      sizeof(struct vertex),
 			      (void *)offsetof(struct vertex, fs_quad_pos));
@@ -253,8 +441,15 @@ void odc_renderer_init(struct renderer *renderer)
 			      (void *)offsetof(struct vertex, resolution));
 	glEnableVertexAttribArray(ATTRIB_RESOLUTION_LOCATION);
 
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	glVertexAttribPointer(ATTRIB_ANIM_LOCATION, 2, GL_FLOAT, GL_FALSE,
+			      sizeof(struct vertex),
+			      (void *)offsetof(struct vertex, anim));
+	glEnableVertexAttribArray(ATTRIB_ANIM_LOCATION);
+
+	odc_gl_state_bind_buffer(GL_ARRAY_BUFFER, 0);
+	odc_gl_state_bind_vertex_array(0);
+
+	bind_program(renderer, shader_program);
 }
 
 void odc_renderer_destroy(struct renderer *renderer)
@@ -262,14 +457,27 @@ void odc_renderer_destroy(struct renderer *renderer)
 	if (!renderer)
 		return;
 
-	glDeleteVertexArrays(1, &(renderer->VAO));
-	glDeleteBuffers(1, &(renderer->VBO));
-	glDeleteProgram(renderer->shader_program);
+	odc_gl_state_delete_vertex_arrays(1, &(renderer->VAO));
+	odc_gl_state_delete_buffers(1, &(renderer->VBO));
+	odc_gl_state_delete_buffers(1, &(renderer->EBO));
+	odc_gl_state_delete_program(renderer->shader_program);
 
-	for (int i = 0; i < renderer->texture_count; ++i) {
-		glDeleteTextures(1, &(renderer->textures[i].id));
+	odc_texture_stream_destroy(renderer->stream);
+	odc_gpu_timer_destroy(renderer->timer);
+	odc_texture_manager_destroy(renderer->textures);
+	odc_gl_state_delete_textures(1, &(renderer->palette_texture));
+
+	for (int i = 0; i < renderer->sampler_count; ++i) {
+		odc_gl_state_delete_samplers(1, &(renderer->samplers[i].id));
+	}
+
+	for (int i = 0; i < renderer->custom_shape_count; ++i) {
+		free(renderer->custom_shapes[i]);
 	}
 
+	odc_font_free(&renderer->font);
+	odc_text_layout_cache_destroy(renderer->text_layouts);
+	odc_shape_batch_destroy(renderer->batch);
 	free(renderer);
 }
 
@@ -280,207 +488,386 @@ GLuint odc_renderer_get_shader(struct renderer *renderer)
 
 void odc_renderer_reset_shape_count(struct renderer *renderer)
 {
-	renderer->shape_count = 0;
+	odc_shape_batch_reset(renderer->batch);
 }
 
-void odc_renderer_draw(struct renderer *renderer)
+struct shape_batch *odc_renderer_get_batch(struct renderer *renderer)
 {
-	check_gl_errors();
-
-	glUseProgram(renderer->shader_program);
-
-	int screen_width, screen_height;
-	glfwGetFramebufferSize(glfwGetCurrentContext(), &screen_width,
-			       &screen_height);
-	glUniform2f(
-		glGetUniformLocation(renderer->shader_program, "u_resolution"),
-		(float)screen_width, (float)screen_height);
-
-	glBindVertexArray(renderer->VAO);
-	check_gl_errors();
-
-	glBindBuffer(GL_ARRAY_BUFFER, renderer->VBO);
-	glBufferSubData(GL_ARRAY_BUFFER, 0,
-			sizeof(struct vertex) * renderer->shape_count * 6,
-			renderer->vertices);
-	check_gl_errors();
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, renderer->font.texture_id);
-	glUniform1i(
-		glGetUniformLocation(renderer->shader_program, "font_sampler"),
-		0);
+	return renderer->batch;
+}
 
-	for (int i = 0; i < renderer->texture_count; ++i) {
-		glActiveTexture(GL_TEXTURE1 + i);
-		glBindTexture(GL_TEXTURE_2D, renderer->textures[i].id);
+static void get_output_size(struct renderer *renderer, int *width,
+			    int *height)
+{
+	if (renderer->viewport_width <= 0 || renderer->viewport_height <= 0) {
+		glfwGetFramebufferSize(glfwGetCurrentContext(), width, height);
+		return;
 	}
+	*width = renderer->viewport_width;
+	*height = renderer->viewport_height;
+}
 
-	glUniform1i(glGetUniformLocation(renderer->shader_program,
-					 "texture_sampler"),
-		    1);
-
-	glDrawArrays(GL_TRIANGLES, 0, renderer->shape_count * 6);
-	check_gl_errors();
+void odc_renderer_set_viewport_size(struct renderer *renderer, int width,
+				    int height)
+{
+	renderer->viewport_width = width;
+	renderer->viewport_height = height;
+}
 
-	glBindVertexArray(0);
+void odc_renderer_set_render_target(struct renderer *renderer,
+				    struct render_target *target)
+{
+	renderer->target = target;
 }
 
-void odc_renderer_clear_vertices(struct renderer *renderer)
+struct render_target *odc_renderer_get_render_target(struct renderer *renderer)
 {
-	memset(renderer->vertices, 0, sizeof(renderer->vertices));
+	return renderer->target;
 }
 
-void odc_renderer_clear(struct renderer *renderer, float r, float g, float b,
-			float a)
+void odc_renderer_begin_frame(struct renderer *renderer)
 {
-	glClearColor(r, g, b, a);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	odc_gpu_timer_begin_frame(renderer->timer);
+	if (!renderer->target)
+		return;
+
+	int width, height;
+	get_output_size(renderer, &width, &height);
+	renderer->target_active =
+		odc_render_target_begin(renderer->target, width, height) == 0;
+	if (!renderer->target_active)
+		glViewport(0, 0, width, height);
 }
 
-static void normalize_coordinates(float x, float y, int screen_width,
-				  int screen_height, float *norm_x,
-				  float *norm_y)
+void odc_renderer_present(struct renderer *renderer)
 {
-	*norm_x = (x / (float)screen_width) * 2.0f - 1.0f;
-	*norm_y = 1.0f - (y / (float)screen_height) * 2.0f;
+	if (renderer->target_active) {
+		int section = odc_gpu_timer_begin(renderer->timer, "present");
+		odc_render_target_present(renderer->target);
+		odc_gpu_timer_end(renderer->timer, section);
+		renderer->target_active = 0;
+	}
+	odc_gpu_timer_end_frame(renderer->timer);
+	odc_font_end_frame(&renderer->font);
 }
 
-void odc_renderer_add_equilateral_triangle(struct renderer *renderer, float x,
-					   float y, float size,
-					   int screen_width, int screen_height,
-					   float *color)
+void odc_renderer_get_frame(struct renderer *renderer,
+			    struct renderer_frame *frame)
 {
-	if (renderer->shape_count >= MAX_SHAPES)
-		return;
+	odc_shape_batch_get_frame(renderer->batch, frame);
+	frame->font_bitmap = renderer->font.bitmap;
+	frame->font_version = renderer->font.version;
+	frame->font_row_versions = renderer->font.row_versions;
+	frame->font_sdf = renderer->font.sdf;
+	frame->time = renderer->time;
+	frame->animation_frames =
+		(const float(*)[4])renderer->animation_frames;
+	frame->animation_params =
+		(const float(*)[4])renderer->animation_params;
+	frame->animation_count = renderer->animation_count;
+}
 
-	float norm_x, norm_y;
-	normalize_coordinates(x, y, screen_width, screen_height, &norm_x,
-			      &norm_y);
+void odc_renderer_set_gpu_timing(struct renderer *renderer, int enabled)
+{
+	if (enabled && !renderer->timer) {
+		renderer->timer = odc_gpu_timer_new();
+	} else if (!enabled && renderer->timer) {
+		odc_gpu_timer_destroy(renderer->timer);
+		renderer->timer = NULL;
+	}
+}
 
-	float half_size = size / 2.0f;
-	float height = size;
+struct gpu_timer *odc_renderer_get_gpu_timer(struct renderer *renderer)
+{
+	return renderer->timer;
+}
 
-	float vertices[12] = {-half_size,     -height / 2.0f, half_size,
-			      -height / 2.0f, 0.0f,	      height / 2.0f,
-			      -half_size,     -height / 2.0f, half_size,
-			      -height / 2.0f, 0.0f,	      height / 2.0f};
+void odc_renderer_get_stats(struct renderer *renderer,
+			    struct renderer_stats *stats)
+{
+	*stats = renderer->stats;
+}
 
-	for (int i = 0; i < 6; ++i) {
-		struct vertex *v =
-			&renderer->vertices[renderer->shape_count * 6 + i];
+static int batch_end(const struct draw_batch *batches, int batch_count,
+		     int shape_count, int batch)
+{
+	return batch + 1 < batch_count ? batches[batch + 1].first_shape
+				       : shape_count;
+}
 
-		v->fs_quad_pos[0] = vertices[i * 2];
-		v->fs_quad_pos[1] = vertices[i * 2 + 1];
+static int bind_batch_texture(struct renderer *renderer,
+			      const struct draw_batch *batch)
+{
+	GLuint texture = batch->texture;
+	struct managed_texture *managed =
+		odc_texture_manager_find(renderer->textures, texture);
+	if (managed && odc_texture_manager_use(renderer->textures, texture) != 0)
+		return -1;
+
+	odc_gl_state_bind_texture_unit(1, GL_TEXTURE_2D, texture);
+	odc_gl_state_bind_sampler(1, managed ? managed->sampler : 0);
+	return 0;
+}
 
-		v->shape_pos[0] = norm_x;
-		v->shape_pos[1] = norm_y;
+static int is_texture_opaque(GLuint texture, void *user_data)
+{
+	struct managed_texture *managed = odc_texture_manager_find(
+		(struct texture_manager *)user_data, texture);
+	return managed && managed->opaque;
+}
 
-		v->local_pos[0] = vertices[i * 2];
-		v->local_pos[1] = vertices[i * 2 + 1];
+// Attachment queries can be a round trip to the driver, so they run only
+// when the binding changes
+static int framebuffer_has_depth(struct renderer *renderer)
+{
+	if (renderer->output_depth >= 0)
+		return renderer->output_depth;
+
+	GLint framebuffer = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+	if (framebuffer == renderer->depth_framebuffer)
+		return renderer->depth_framebuffer_has_depth;
+
+	GLint type = GL_NONE;
+	GLenum attachment = framebuffer ? GL_DEPTH_ATTACHMENT : GL_DEPTH;
+	glGetFramebufferAttachmentParameteriv(
+		GL_DRAW_FRAMEBUFFER, attachment,
+		GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE, &type);
+	renderer->depth_framebuffer = framebuffer;
+	renderer->depth_framebuffer_has_depth = type != GL_NONE;
+	return renderer->depth_framebuffer_has_depth;
+}
 
-		v->op_code = OP_CODE_EQUILATERAL_TRIANGLE;
-		v->radius = 0.0f;
-		v->width = size;
-		v->height = size;
+void odc_renderer_set_output_depth(struct renderer *renderer, int has_depth)
+{
+	renderer->output_depth = has_depth;
+}
 
-		for (int j = 0; j < 4; ++j)
-			v->color[j] = color[j];
+void odc_renderer_set_depth_sorting(struct renderer *renderer, int enabled)
+{
+	renderer->depth_sorting = enabled;
+}
 
-		v->resolution[0] = (float)screen_width;
-		v->resolution[1] = (float)screen_height;
-	}
+int odc_renderer_get_depth_sorting(struct renderer *renderer)
+{
+	return renderer->depth_sorting;
+}
 
-	renderer->shape_count++;
+void odc_renderer_set_overdraw_mode(struct renderer *renderer, int enabled)
+{
+	renderer->overdraw = enabled;
+	odc_gl_state_use_program(renderer->shader_program);
+	glUniform1f(renderer->uniforms.overdraw, enabled ? 1.0f : 0.0f);
 }
 
-void odc_renderer_add_triangle(struct renderer *renderer, float x1, float y1,
-			       float x2, float y2, float x3, float y3,
-			       int screen_width, int screen_height,
-			       float *color)
+int odc_renderer_get_overdraw_mode(struct renderer *renderer)
 {
-	if (renderer->shape_count >= MAX_SHAPES)
-		return;
+	return renderer->overdraw;
+}
 
-	float norm_x1, norm_y1, norm_x2, norm_y2, norm_x3, norm_y3;
-	normalize_coordinates(x1, y1, screen_width, screen_height, &norm_x1,
-			      &norm_y1);
-	normalize_coordinates(x2, y2, screen_width, screen_height, &norm_x2,
-			      &norm_y2);
-	normalize_coordinates(x3, y3, screen_width, screen_height, &norm_x3,
-			      &norm_y3);
+static void set_pass_blend(struct renderer *renderer, int opaque)
+{
+	// Overdraw mode adds one per shaded fragment instead of compositing
+	if (renderer->overdraw)
+		odc_gl_state_set_blend(1, GL_ONE, GL_ONE);
+	else if (opaque)
+		odc_gl_state_set_blend(0, GL_ONE, GL_ZERO);
+	else
+		odc_gl_state_set_blend(1, GL_SRC_ALPHA,
+				       GL_ONE_MINUS_SRC_ALPHA);
+}
 
-	float vertices[6] = {norm_x1, norm_y1, norm_x2,
-			     norm_y2, norm_x3, norm_y3};
+static void draw_queued(struct renderer *renderer, int redraw)
+{
+	struct gpu_timer *timer = redraw ? NULL : renderer->timer;
+	struct renderer_stats redraw_stats;
+	struct renderer_stats *stats = redraw ? &redraw_stats
+					      : &renderer->stats;
 
-	for (int i = 0; i < 3; ++i) {
-		struct vertex *v =
-			&renderer->vertices[renderer->shape_count * 6 + i];
+	int section = odc_gpu_timer_begin(timer, "upload");
+	if (renderer->stream && !redraw)
+		odc_texture_stream_update(renderer->stream);
 
-		v->fs_quad_pos[0] = vertices[i * 2];
-		v->fs_quad_pos[1] = vertices[i * 2 + 1];
+	odc_gl_state_use_program(renderer->shader_program);
 
-		v->shape_pos[0] = 0.0f;
-		v->shape_pos[1] = 0.0f;
+	int screen_width, screen_height;
+	if (renderer->target_active) {
+		odc_render_target_get_size(renderer->target, &screen_width,
+					   &screen_height);
+	} else {
+		get_output_size(renderer, &screen_width, &screen_height);
+	}
+	if (renderer->resolution[0] != (float)screen_width ||
+	    renderer->resolution[1] != (float)screen_height) {
+		renderer->resolution[0] = (float)screen_width;
+		renderer->resolution[1] = (float)screen_height;
+		glUniform2f(renderer->uniforms.resolution,
+			    renderer->resolution[0], renderer->resolution[1]);
+	}
+	glUniform1f(renderer->uniforms.time, renderer->time);
+
+	if (renderer->animations_dirty) {
+		glUniform4fv(renderer->uniforms.anim_frames,
+			     renderer->animation_count,
+			     &renderer->animation_frames[0][0]);
+		glUniform4fv(renderer->uniforms.anim_params,
+			     renderer->animation_count,
+			     &renderer->animation_params[0][0]);
+		renderer->animations_dirty = 0;
+	}
 
-		v->local_pos[0] = vertices[i * 2];
-		v->local_pos[1] = vertices[i * 2 + 1];
+	int shape_count = odc_shape_batch_get_shape_count(renderer->batch);
+	int batch_count;
+	const struct draw_batch *batches =
+		odc_shape_batch_get_draw_batches(renderer->batch, &batch_count);
 
-		v->op_code = OP_CODE_TRIANGLE;
-		v->radius = 0.0f;
-		v->width = 0.0f;
-		v->height = 0.0f;
+	memset(stats, 0, sizeof(*stats));
+	stats->shape_count = shape_count;
+	stats->batch_count = batch_count;
 
-		for (int j = 0; j < 4; ++j)
-			v->color[j] = color[j];
+	odc_gl_state_bind_vertex_array(renderer->VAO);
+	odc_gl_state_bind_buffer(GL_ARRAY_BUFFER, renderer->VBO);
+	glBufferSubData(GL_ARRAY_BUFFER, 0,
+			sizeof(struct vertex) * shape_count * 6,
+			odc_shape_batch_get_vertices(renderer->batch));
+	stats->upload_bytes += sizeof(struct vertex) * shape_count * 6;
+	odc_gpu_timer_end(timer, section);
+
+	odc_font_upload(&renderer->font);
+	odc_gl_state_bind_texture_unit(0, GL_TEXTURE_2D,
+				       renderer->font.texture_id);
+	odc_gl_state_bind_texture_unit(2, GL_TEXTURE_2D,
+				       renderer->palette_texture);
+
+	section = odc_gpu_timer_begin(timer, "sort");
+	int opaque_count =
+		renderer->depth_sorting
+			? odc_shape_batch_sort(renderer->batch,
+					       is_texture_opaque,
+					       renderer->textures)
+			: 0;
+	if (opaque_count > 0 && !renderer->target_active &&
+	    !framebuffer_has_depth(renderer))
+		opaque_count = 0;
+	if (opaque_count > 0) {
+		odc_gl_state_bind_buffer(GL_ELEMENT_ARRAY_BUFFER,
+					 renderer->EBO);
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0,
+				sizeof(GLuint) * shape_count * 6,
+				odc_shape_batch_get_indices(renderer->batch));
+		stats->upload_bytes += sizeof(GLuint) * shape_count * 6;
+	}
+	stats->opaque_count = opaque_count;
+	odc_gpu_timer_end(timer, section);
+
+	if (opaque_count == 0) {
+		section = odc_gpu_timer_begin(timer, "shapes");
+		odc_gl_state_set_depth(0, 1);
+		if (renderer->overdraw)
+			set_pass_blend(renderer, 0);
+		for (int i = 0; i < batch_count; ++i) {
+			int first = batches[i].first_shape;
+			int last = batch_end(batches, batch_count, shape_count,
+					     i);
+			if (last <= first ||
+			    bind_batch_texture(renderer, &batches[i]) != 0)
+				continue;
+			glDrawArrays(GL_TRIANGLES, first * 6,
+				     (last - first) * 6);
+			stats->draw_calls++;
+		}
+		odc_gpu_timer_end(timer, section);
+	} else {
+		// Opaque shapes go front to back and write depth, so whatever
+		// they cover is rejected before it reaches the fragment shader
+		section = odc_gpu_timer_begin(timer, "opaque");
+		odc_gl_state_set_depth(1, 1);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		set_pass_blend(renderer, 1);
+		for (int i = batch_count - 1; i >= 0; --i) {
+			const struct draw_batch *batch = &batches[i];
+			if (batch->opaque_count == 0 ||
+			    bind_batch_texture(renderer, batch) != 0)
+				continue;
+			glDrawElements(GL_TRIANGLES, batch->opaque_count,
+				       GL_UNSIGNED_INT,
+				       (void *)(sizeof(GLuint) *
+						batch->opaque_first));
+			stats->draw_calls++;
+		}
 
-		v->resolution[0] = (float)screen_width;
-		v->resolution[1] = (float)screen_height;
+		odc_gpu_timer_end(timer, section);
+
+		section = odc_gpu_timer_begin(timer, "translucent");
+		set_pass_blend(renderer, 0);
+		odc_gl_state_set_depth(1, 0);
+		for (int i = 0; i < batch_count; ++i) {
+			const struct draw_batch *batch = &batches[i];
+			if (batch->translucent_count == 0 ||
+			    bind_batch_texture(renderer, batch) != 0)
+				continue;
+			glDrawElements(GL_TRIANGLES, batch->translucent_count,
+				       GL_UNSIGNED_INT,
+				       (void *)(sizeof(GLuint) *
+						batch->translucent_first));
+			stats->draw_calls++;
+		}
+		odc_gl_state_set_depth(0, 1);
+		odc_gpu_timer_end(timer, section);
 	}
+	CHECK_GL_ERRORS();
 
-	renderer->shape_count++;
+	if (!redraw)
+		odc_texture_manager_end_frame(renderer->textures);
 }
 
-void odc_renderer_add_circle(struct renderer *renderer, float x, float y,
-			     float radius, int screen_width, int screen_height,
-			     float *color)
+void odc_renderer_draw(struct renderer *renderer)
 {
-	if (renderer->shape_count >= MAX_SHAPES)
-		return;
-
-	float norm_x, norm_y;
-	normalize_coordinates(x, y, screen_width, screen_height, &norm_x,
-			      &norm_y);
-
-	float vertices[12] = {-radius, radius,	-radius, -radius,
-			      radius,  -radius, -radius, radius,
-			      radius,  -radius, radius,	 radius};
-
-	for (int i = 0; i < 6; ++i) {
-		struct vertex *v =
-			&renderer->vertices[renderer->shape_count * 6 + i];
+	draw_queued(renderer, 0);
+}
 
-		v->fs_quad_pos[0] = vertices[i * 2];
-		v->fs_quad_pos[1] = vertices[i * 2 + 1];
+void odc_renderer_redraw(struct renderer *renderer)
+{
+	draw_queued(renderer, 1);
+}
 
-		v->shape_pos[0] = norm_x;
-		v->shape_pos[1] = norm_y;
+void odc_renderer_clear_vertices(struct renderer *renderer)
+{
+	odc_shape_batch_clear(renderer->batch);
+}
 
-		v->local_pos[0] = vertices[i * 2];
-		v->local_pos[1] = vertices[i * 2 + 1];
+void odc_renderer_clear(struct renderer *renderer, float r, float g, float b,
+			float a)
+{
+	glClearColor(r, g, b, a);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
 
-		v->op_code = OP_CODE_CIRCLE;
-		v->radius = radius;
-		v->width = radius * 2.0f;
-		v->height = radius * 2.0f;
+void odc_renderer_add_equilateral_triangle(struct renderer *renderer, float x,
+					   float y, float size,
+					   int screen_width, int screen_height,
+					   float *color)
+{
+	odc_shape_batch_add_equilateral_triangle(renderer->batch, x, y, size,
+						 screen_width, screen_height,
+						 color);
+}
 
-		for (int j = 0; j < 4; ++j)
-			v->color[j] = color[j];
+void odc_renderer_add_triangle(struct renderer *renderer, float x1, float y1,
+			       float x2, float y2, float x3, float y3,
+			       int screen_width, int screen_height,
+			       float *color)
+{
+	odc_shape_batch_add_triangle(renderer->batch, x1, y1, x2, y2, x3, y3,
+				     screen_width, screen_height, color);
+}
 
-		v->resolution[0] = (float)screen_width;
-		v->resolution[1] = (float)screen_height;
-	}
-	renderer->shape_count++;
+void odc_renderer_add_circle(struct renderer *renderer, float x, float y,
+			     float radius, int screen_width, int screen_height,
+			     float *color)
+{
+	odc_shape_batch_add_circle(renderer->batch, x, y, radius, screen_width,
+				   screen_height, color);
 }
 
 void odc_renderer_add_rounded_rect(struct renderer *renderer, float x, float y,
@@ -488,46 +875,81 @@ void odc_renderer_add_rounded_rect(struct renderer *renderer, float x, float y,
 				   int screen_width, int screen_height,
 				   float *color)
 {
-	if (renderer->shape_count >= MAX_SHAPES)
-		return;
-
-	float norm_x, norm_y;
-	normalize_coordinates(x, y, screen_width, screen_height, &norm_x,
-			      &norm_y);
+	odc_shape_batch_add_rounded_rect(renderer->batch, x, y, width, height,
+					 radius, screen_width, screen_height,
+					 color);
+}
 
-	float half_width = width * 0.5f;
-	float half_height = height * 0.5f;
+int odc_renderer_register_shape(struct renderer *renderer,
+				const char *sdf_source)
+{
+	if (renderer->custom_shape_count >= MAX_CUSTOM_SHAPES) {
+		fprintf(stderr, "ERROR::RENDERER: Too many custom shapes\n");
+		return -1;
+	}
 
-	float vertices[12] = {-half_width,  half_height, -half_width,
-			      -half_height, half_width,	 -half_height,
-			      -half_width,  half_height, half_width,
-			      -half_height, half_width,	 half_height};
+	char *source = strdup(sdf_source);
+	if (!source)
+		return -1;
 
-	for (int i = 0; i < 6; ++i) {
-		struct vertex *v =
-			&renderer->vertices[renderer->shape_count * 6 + i];
+	renderer->custom_shapes[renderer->custom_shape_count] = source;
+	return renderer->custom_shape_count++;
+}
 
-		v->fs_quad_pos[0] = vertices[i * 2];
-		v->fs_quad_pos[1] = vertices[i * 2 + 1];
+int odc_renderer_rebuild_shaders(struct renderer *renderer)
+{
+	char error[MAX_SHADER_ERROR] = {0};
+	char *fragment_source = build_fragment_source(renderer);
+	if (!fragment_source)
+		return -1;
+
+	GLuint program = odc_shader_new_program(vertexShaderSource,
+						fragment_source, error);
+	free(fragment_source);
+	if (!program) {
+		// Keep drawing with the previous program and drop the shapes
+		// it doesn't know about so the next rebuild can succeed
+		fprintf(stderr, "Shader compilation or linking error: %s\n",
+			error);
+		while (renderer->custom_shape_count >
+		       renderer->compiled_shape_count) {
+			int last = --renderer->custom_shape_count;
+			free(renderer->custom_shapes[last]);
+		}
+		return -1;
+	}
 
-		v->shape_pos[0] = norm_x + half_width / screen_width * 2.0f;
-		v->shape_pos[1] = norm_y - half_height / screen_height * 2.0f;
+	odc_gl_state_delete_program(renderer->shader_program);
+	bind_program(renderer, program);
+	renderer->compiled_shape_count = renderer->custom_shape_count;
+	return 0;
+}
 
-		v->local_pos[0] = vertices[i * 2];
-		v->local_pos[1] = vertices[i * 2 + 1];
+int odc_renderer_get_custom_shape_count(struct renderer *renderer)
+{
+	return renderer->compiled_shape_count;
+}
 
-		v->op_code = OP_CODE_ROUNDED_RECT;
-		v->radius = radius;
-		v->width = width;
-		v->height = height;
+const char *odc_renderer_get_custom_shape(struct renderer *renderer,
+					  int shape)
+{
+	if (shape < 0 || shape >= renderer->custom_shape_count)
+		return NULL;
+	return renderer->custom_shapes[shape];
+}
 
-		for (int j = 0; j < 4; ++j)
-			v->color[j] = color[j];
+void odc_renderer_add_custom_shape(struct renderer *renderer, int shape,
+				   float x, float y, float width,
+				   float height, float param,
+				   int screen_width, int screen_height,
+				   float *color)
+{
+	if (shape < 0 || shape >= renderer->compiled_shape_count)
+		return;
 
-		v->resolution[0] = (float)screen_width;
-		v->resolution[1] = (float)screen_height;
-	}
-	renderer->shape_count++;
+	odc_shape_batch_add_custom_shape(renderer->batch, shape, x, y, width,
+					 height, param, screen_width,
+					 screen_height, color);
 }
 
 void odc_renderer_add_rect(struct renderer *renderer, float x, float y,
@@ -542,252 +964,563 @@ void odc_renderer_add_text(struct renderer *renderer, const char *text, float x,
 			   float y, float scale, int screen_width,
 			   int screen_height, float *color)
 {
-	if (!renderer || !text || renderer->shape_count >= MAX_SHAPES)
+	if (!renderer)
 		return;
 
-	float baseline = y + (renderer->font.ascender * scale);
+	const struct text_layout *layout = odc_text_layout_cache_get(
+		renderer->text_layouts, &renderer->font, text, scale, 0);
+	odc_shape_batch_add_text_layout(renderer->batch, layout, x, y,
+					screen_width, screen_height, color);
+}
 
-	for (const char *c = text; *c; c++) {
-		if (*c < 32 || *c >= 32 + MAX_GLYPHS) {
-			// Skip unsupported characters
-			continue;
-		}
+void odc_renderer_add_multiline_text(struct renderer *renderer,
+				     const char *text, float x, float y,
+				     float scale, int screen_width,
+				     int screen_height, float *color)
+{
+	if (!renderer)
+		return;
 
-		struct glyph *g = &renderer->font.glyphs[*c - 32];
+	const struct text_layout *layout = odc_text_layout_cache_get(
+		renderer->text_layouts, &renderer->font, text, scale, 1);
+	odc_shape_batch_add_text_layout(renderer->batch, layout, x, y,
+					screen_width, screen_height, color);
+}
 
-		float xpos = x + (g->bearing_x * scale);
-		float ypos = baseline - (g->bearing_y * scale);
+static void measure_text(struct renderer *renderer, const char *text,
+			 float scale, int multiline, float *width,
+			 float *height)
+{
+	const struct text_layout *layout = odc_text_layout_cache_get(
+		renderer->text_layouts, &renderer->font, text, scale,
+		multiline);
+	*width = layout ? layout->width : 0.0f;
+	*height = layout ? layout->height : 0.0f;
+}
 
-		float w = (float)g->width * scale;
-		float h = (float)g->height * scale;
+void odc_renderer_measure_text(struct renderer *renderer, const char *text,
+			       float scale, float *width, float *height)
+{
+	measure_text(renderer, text, scale, 0, width, height);
+}
 
-		float tex_x0 = g->tex_offset_x;
-		float tex_y0 =
-			g->tex_offset_y + ((float)g->height / ATLAS_HEIGHT);
-		float tex_x1 =
-			g->tex_offset_x + ((float)g->width / ATLAS_WIDTH);
-		float tex_y1 = g->tex_offset_y;
+void odc_renderer_measure_multiline_text(struct renderer *renderer,
+					 const char *text, float scale,
+					 float *width, float *height)
+{
+	measure_text(renderer, text, scale, 1, width, height);
+}
 
-		float vertices[24] = {
-			xpos,	ypos,	tex_x0,	  tex_y1,   xpos,     ypos + h,
-			tex_x0, tex_y0, xpos + w, ypos + h, tex_x1,   tex_y0,
+struct text_layout_cache *
+odc_renderer_get_text_layouts(struct renderer *renderer)
+{
+	return renderer->text_layouts;
+}
 
-			xpos,	ypos,	tex_x0,	  tex_y1,   xpos + w, ypos + h,
-			tex_x1, tex_y0, xpos + w, ypos,	    tex_x1,   tex_y1};
+void odc_renderer_add_texture(struct renderer *renderer, GLuint texture_handle,
+			      struct texture_render_options *options)
+{
+	odc_shape_batch_add_texture(renderer->batch, texture_handle, options);
+}
 
-		for (int i = 0; i < 6; ++i) {
-			struct vertex *v =
-				&renderer->vertices[renderer->shape_count * 6 +
-						    i];
+void odc_renderer_add_indexed_texture(struct renderer *renderer,
+				      GLuint texture_handle, int palette_index,
+				      struct texture_render_options *options)
+{
+	odc_shape_batch_add_indexed_texture(renderer->batch, texture_handle,
+					    palette_index, options);
+}
 
-			float norm_quad_x, norm_quad_y;
-			normalize_coordinates(vertices[i * 4],
-					      vertices[i * 4 + 1], screen_width,
-					      screen_height, &norm_quad_x,
-					      &norm_quad_y);
+int odc_renderer_register_animation(struct renderer *renderer,
+				    const struct sprite_animation *animation)
+{
+	if (renderer->animation_count >= MAX_SPRITE_ANIMATIONS) {
+		fprintf(stderr, "Maximum sprite animation limit reached\n");
+		return -1;
+	}
 
-			v->fs_quad_pos[0] = norm_quad_x;
-			v->fs_quad_pos[1] = norm_quad_y;
+	if (animation->columns <= 0 || animation->frame_count <= 0 ||
+	    animation->sheet_width <= 0 || animation->sheet_height <= 0) {
+		fprintf(stderr, "Invalid sprite animation\n");
+		return -1;
+	}
 
-			v->shape_pos[0] = 0.0f;
-			v->shape_pos[1] = 0.0f;
+	int id = renderer->animation_count++;
+	float *frames = renderer->animation_frames[id];
+	frames[0] = animation->frame_x / animation->sheet_width;
+	frames[1] = animation->frame_y / animation->sheet_height;
+	frames[2] = animation->frame_width / animation->sheet_width;
+	frames[3] = animation->frame_height / animation->sheet_height;
+
+	float *params = renderer->animation_params[id];
+	params[0] = (float)animation->columns;
+	params[1] = (float)animation->frame_count;
+	params[2] = animation->fps;
+	params[3] = (float)animation->loop_mode;
+
+	renderer->animations_dirty = 1;
+	return id;
+}
+
+void odc_renderer_set_time(struct renderer *renderer, float seconds)
+{
+	renderer->time = seconds;
+}
 
-			v->local_pos[0] = vertices[i * 4];
-			v->local_pos[1] = vertices[i * 4 + 1];
+void odc_renderer_add_animated_sprite(struct renderer *renderer,
+				      GLuint texture_handle, int animation_id,
+				      float start_time,
+				      struct texture_render_options *options)
+{
+	if (animation_id < 0 || animation_id >= renderer->animation_count)
+		return;
 
-			v->op_code = OP_CODE_TEXT;
-			v->radius = 0.0f;
-			v->width = w;
-			v->height = h;
+	float *frames = renderer->animation_frames[animation_id];
+	float frame_width = frames[2] * options->width;
+	float frame_height = frames[3] * options->height;
+
+	// The vertex shader picks the frame, so the quad only carries unit
+	// corner coordinates that it offsets into the current cell
+	struct texture_render_options frame = *options;
+	frame.rect_x = 0.0f;
+	frame.rect_y = 0.0f;
+	frame.rect_width = frame_width;
+	frame.rect_height = frame_height;
+	frame.width = frame_width;
+	frame.height = frame_height;
+
+	odc_shape_batch_add_animated_sprite(renderer->batch, texture_handle,
+					    animation_id, start_time, &frame);
+}
 
-			for (int j = 0; j < 4; j++)
-				v->color[j] = color[j];
+static void font_changed(struct renderer *renderer)
+{
+	odc_text_layout_cache_clear(renderer->text_layouts);
+	odc_gl_state_use_program(renderer->shader_program);
+	glUniform1f(renderer->uniforms.sdf_text,
+		    renderer->font.sdf ? 1.0f : 0.0f);
+}
 
-			v->resolution[0] = (float)screen_width;
-			v->resolution[1] = (float)screen_height;
+int odc_renderer_load_font(struct renderer *r, const char *font_path)
+{
+	int result = odc_font_load(font_path, &r->font);
+	if (result != 0)
+		fprintf(stderr, "Failed to load font\n");
+	font_changed(r);
+	return result;
+}
 
-			v->tex_coord[0] = vertices[i * 4 + 2];
-			v->tex_coord[1] = vertices[i * 4 + 3];
-		}
+int odc_renderer_load_sdf_font(struct renderer *renderer,
+			       const char *font_path)
+{
+	int result = odc_font_load_sdf(font_path, &renderer->font);
+	if (result != 0)
+		fprintf(stderr, "Failed to load font\n");
+	font_changed(renderer);
+	return result;
+}
 
-		renderer->shape_count++;
-		x += (float)g->advance * scale;
-	}
+int odc_renderer_load_font_bitmap(struct renderer *renderer,
+				  const unsigned char *bitmap, int sdf)
+{
+	int result = odc_font_load_bitmap(&renderer->font, bitmap, sdf);
+	font_changed(renderer);
+	return result;
 }
 
-void odc_renderer_add_multiline_text(struct renderer *renderer,
-				     const char *text, float x, float y,
-				     float scale, int screen_width,
-				     int screen_height, float *color)
+static int is_mipmap_filter(GLenum filter)
 {
-	if (!renderer || !text || renderer->shape_count >= MAX_SHAPES)
-		return;
+	return filter == GL_NEAREST_MIPMAP_NEAREST ||
+	       filter == GL_LINEAR_MIPMAP_NEAREST ||
+	       filter == GL_NEAREST_MIPMAP_LINEAR ||
+	       filter == GL_LINEAR_MIPMAP_LINEAR;
+}
 
-	float baseline = y + (renderer->font.ascender * scale);
-	float line_spacing =
-		(renderer->font.ascender - renderer->font.descender +
-		 renderer->font.line_gap) *
-		scale;
+static GLuint get_sampler(struct renderer *renderer, GLenum min_filter,
+			  GLenum mag_filter, GLenum wrap_s, GLenum wrap_t)
+{
+	for (int i = 0; i < renderer->sampler_count; ++i) {
+		struct sampler *s = &renderer->samplers[i];
+		if (s->min_filter == min_filter && s->mag_filter == mag_filter &&
+		    s->wrap_s == wrap_s && s->wrap_t == wrap_t)
+			return s->id;
+	}
 
-	char *line = strdup(text);
-	char *token = strtok(line, "\n");
-	while (token != NULL) {
-		odc_renderer_add_text(renderer, token, x, baseline, scale,
-				      screen_width, screen_height, color);
-		baseline -= line_spacing;
-		token = strtok(NULL, "\n");
+	if (renderer->sampler_count >= MAX_SAMPLERS) {
+		fprintf(stderr, "Maximum sampler limit reached\n");
+		return 0;
 	}
 
-	free(line);
+	struct sampler *s = &renderer->samplers[renderer->sampler_count++];
+	s->min_filter = min_filter;
+	s->mag_filter = mag_filter;
+	s->wrap_s = wrap_s;
+	s->wrap_t = wrap_t;
+
+	glGenSamplers(1, &s->id);
+	glSamplerParameteri(s->id, GL_TEXTURE_MIN_FILTER, min_filter);
+	glSamplerParameteri(s->id, GL_TEXTURE_MAG_FILTER, mag_filter);
+	glSamplerParameteri(s->id, GL_TEXTURE_WRAP_S, wrap_s);
+	glSamplerParameteri(s->id, GL_TEXTURE_WRAP_T, wrap_t);
+
+	return s->id;
 }
 
-void odc_renderer_add_texture(struct renderer *renderer, GLuint texture_handle,
-			      struct texture_render_options *options)
+static void resolve_upload_options(const struct texture_upload_options *in,
+				   struct texture_upload_options *out,
+				   int has_mipmaps)
 {
-	if (renderer->shape_count >= MAX_SHAPES)
-		return;
+	struct texture_upload_options defaults = {0};
+	*out = in ? *in : defaults;
+
+	if (!out->min_filter)
+		out->min_filter = has_mipmaps ? GL_LINEAR_MIPMAP_LINEAR
+					      : GL_NEAREST;
+	if (!out->mag_filter)
+		out->mag_filter = GL_NEAREST;
+	if (!out->wrap_s)
+		out->wrap_s = GL_REPEAT;
+	if (!out->wrap_t)
+		out->wrap_t = GL_REPEAT;
+
+	// Sampling a mip filter on a single-level texture leaves it incomplete
+	if (!has_mipmaps && is_mipmap_filter(out->min_filter))
+		out->min_filter = GL_LINEAR;
+}
 
-	float norm_x, norm_y;
-	normalize_coordinates(options->x, options->y, options->screen_width,
-			      options->screen_height, &norm_x, &norm_y);
+static GLuint upload_texture_levels(struct renderer *renderer,
+				    const unsigned char *const *levels,
+				    int level_count, int width, int height,
+				    const struct texture_upload_options *options)
+{
+	int has_mipmaps =
+		level_count > 1 || (options && options->generate_mipmaps);
+	struct texture_upload_options resolved;
+	resolve_upload_options(options, &resolved, has_mipmaps);
 
-	float width = options->rect_width * options->scale;
-	float height = options->rect_height * options->scale;
+	GLuint texture_id;
+	glGenTextures(1, &texture_id);
+	odc_gl_state_bind_texture(GL_TEXTURE_2D, texture_id);
+	for (int level = 0; level < level_count; ++level) {
+		int level_width = width >> level > 0 ? width >> level : 1;
+		int level_height = height >> level > 0 ? height >> level : 1;
+		glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, level_width,
+			     level_height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+			     levels[level]);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+			level_count > 1 ? level_count - 1 : 1000);
+	if (level_count == 1 && has_mipmaps)
+		glGenerateMipmap(GL_TEXTURE_2D);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+			resolved.min_filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,
+			resolved.mag_filter);
+	odc_gl_state_bind_texture(GL_TEXTURE_2D, 0);
+
+	// Reloads after eviction rebuild mipmaps from the base level, so a
+	// precomputed chain is only kept on the GPU
+	struct managed_texture *texture = odc_texture_manager_add(
+		renderer->textures, texture_id, width, height, GL_RGBA8,
+		GL_RGBA, has_mipmaps, levels[0]);
+	if (!texture) {
+		odc_gl_state_delete_textures(1, &texture_id);
+		return 0;
+	}
+	texture->sampler =
+		get_sampler(renderer, resolved.min_filter, resolved.mag_filter,
+			    resolved.wrap_s, resolved.wrap_t);
+	texture->opaque =
+		levels[0] && odc_image_is_opaque(levels[0], width, height);
 
-	float u0 = options->rect_x / options->width;
-	float v0 = options->rect_y / options->height;
-	float u1 = (options->rect_x + options->rect_width) / options->width;
-	float v1 = (options->rect_y + options->rect_height) / options->height;
+	return texture_id;
+}
 
-	if (options->flip_x) {
-		float temp = u0;
-		u0 = u1;
-		u1 = temp;
-	}
+GLuint odc_renderer_upload_texture(struct renderer *renderer,
+				   const unsigned char *data, int width,
+				   int height)
+{
+	return upload_texture_levels(renderer, &data, 1, width, height, NULL);
+}
 
-	if (options->flip_y) {
-		float temp = v0;
-		v0 = v1;
-		v1 = temp;
+GLuint odc_renderer_upload_texture_ex(
+	struct renderer *renderer, const unsigned char *data, int width,
+	int height, const struct texture_upload_options *options)
+{
+	return upload_texture_levels(renderer, &data, 1, width, height,
+				     options);
+}
+
+GLuint odc_renderer_upload_texture_mips(
+	struct renderer *renderer, const unsigned char *const *levels,
+	int level_count, int width, int height,
+	const struct texture_upload_options *options)
+{
+	if (!levels || level_count <= 0) {
+		fprintf(stderr, "Texture upload needs at least one level\n");
+		return 0;
 	}
 
-	float vertices[24] = {0.0f,  0.0f,    u0, v1, 0.0f,  -height, u0, v0,
-			      width, -height, u1, v0, 0.0f,  0.0f,    u0, v1,
-			      width, -height, u1, v0, width, 0.0f,    u1, v1};
+	return upload_texture_levels(renderer, levels, level_count, width,
+				     height, options);
+}
 
-	float cos_theta = cosf(options->rotation);
-	float sin_theta = sinf(options->rotation);
+void odc_renderer_set_texture_filter(struct renderer *renderer,
+				     GLuint texture_handle, GLenum min_filter,
+				     GLenum mag_filter)
+{
+	struct managed_texture *texture =
+		odc_texture_manager_find(renderer->textures, texture_handle);
+	if (!texture)
+		return;
 
-	for (int i = 0; i < 6; ++i) {
-		struct vertex *v =
-			&renderer->vertices[renderer->shape_count * 6 + i];
+	GLenum wrap_s = GL_REPEAT, wrap_t = GL_REPEAT;
+	for (int i = 0; i < renderer->sampler_count; ++i) {
+		if (renderer->samplers[i].id == texture->sampler) {
+			wrap_s = renderer->samplers[i].wrap_s;
+			wrap_t = renderer->samplers[i].wrap_t;
+		}
+	}
 
-		float local_x = vertices[i * 4];
-		float local_y = vertices[i * 4 + 1];
+	texture->sampler =
+		get_sampler(renderer, min_filter, mag_filter, wrap_s, wrap_t);
+}
 
-		float rotated_x = local_x * cos_theta - local_y * sin_theta;
-		float rotated_y = local_x * sin_theta + local_y * cos_theta;
+GLuint odc_renderer_upload_indexed_texture(struct renderer *renderer,
+					   const unsigned char *data, int width,
+					   int height)
+{
+	GLuint texture_id;
+	glGenTextures(1, &texture_id);
+	odc_gl_state_bind_texture(GL_TEXTURE_2D, texture_id);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED,
+		     GL_UNSIGNED_BYTE, data);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	// Filtering would blend palette indices, so indexed textures are
+	// always sampled nearest
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	odc_gl_state_bind_texture(GL_TEXTURE_2D, 0);
 
-		v->fs_quad_pos[0] = rotated_x;
-		v->fs_quad_pos[1] = rotated_y;
+	struct managed_texture *texture =
+		odc_texture_manager_add(renderer->textures, texture_id, width,
+					height, GL_R8, GL_RED, 0, data);
+	if (!texture) {
+		odc_gl_state_delete_textures(1, &texture_id);
+		return 0;
+	}
+	texture->sampler = get_sampler(renderer, GL_NEAREST, GL_NEAREST,
+				       GL_REPEAT, GL_REPEAT);
 
-		v->shape_pos[0] = norm_x;
-		v->shape_pos[1] = norm_y;
+	return texture_id;
+}
 
-		v->local_pos[0] = rotated_x;
-		v->local_pos[1] = rotated_y;
+GLuint odc_renderer_add_texture_source(
+	struct renderer *renderer, int width, int height,
+	unsigned char *(*load)(void *user_data, int *width, int *height),
+	void *user_data)
+{
+	struct managed_texture *texture = odc_texture_manager_add_source(
+		renderer->textures, width, height, load, user_data);
+	if (!texture)
+		return 0;
 
-		v->op_code = OP_CODE_TEXTURE;
-		v->radius = 0.0f;
-		v->width = options->width;
-		v->height = options->height;
+	texture->sampler = get_sampler(renderer, GL_NEAREST, GL_NEAREST,
+				       GL_REPEAT, GL_REPEAT);
+	return texture->id;
+}
 
-		for (int j = 0; j < 4; ++j)
-			v->color[j] = 1.0f;
+static unsigned char *read_texture_image(GLuint texture, int width,
+					 int height, int channels)
+{
+	unsigned char *pixels =
+		(unsigned char *)malloc((size_t)width * height * channels);
+	if (!pixels)
+		return NULL;
+
+	odc_gl_state_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+	odc_gl_state_bind_texture(GL_TEXTURE_2D, texture);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glGetTexImage(GL_TEXTURE_2D, 0, channels == 1 ? GL_RED : GL_RGBA,
+		      GL_UNSIGNED_BYTE, pixels);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	odc_gl_state_bind_texture(GL_TEXTURE_2D, 0);
+	return pixels;
+}
 
-		v->resolution[0] = (float)options->screen_width;
-		v->resolution[1] = (float)options->screen_height;
+unsigned char *odc_renderer_read_texture(struct renderer *renderer,
+					 GLuint texture_handle,
+					 struct renderer_texture_info *info)
+{
+	struct managed_texture *managed =
+		odc_texture_manager_find(renderer->textures, texture_handle);
+	if (!managed) {
+		fprintf(stderr, "ERROR::RENDERER: Unknown texture %u\n",
+			texture_handle);
+		return NULL;
+	}
 
-		v->tex_coord[0] = vertices[i * 4 + 2];
-		v->tex_coord[1] = vertices[i * 4 + 3];
+	// Evicted textures have to be brought back before they can be read
+	if (odc_texture_manager_use(renderer->textures, texture_handle) != 0)
+		return NULL;
+
+	info->width = managed->width;
+	info->height = managed->height;
+	info->channels = managed->format == GL_RED ? 1 : 4;
+	info->opaque = managed->opaque;
+	info->min_filter = GL_NEAREST;
+	info->mag_filter = GL_NEAREST;
+	for (int i = 0; i < renderer->sampler_count; ++i) {
+		if (renderer->samplers[i].id == managed->sampler) {
+			info->min_filter = renderer->samplers[i].min_filter;
+			info->mag_filter = renderer->samplers[i].mag_filter;
+		}
 	}
 
-	renderer->shape_count++;
-	renderer->textures[renderer->texture_count - 1].id = texture_handle;
+	return read_texture_image(texture_handle, info->width, info->height,
+				  info->channels);
 }
 
-void odc_renderer_load_font(struct renderer *r, const char *font_path)
+void odc_renderer_delete_texture(struct renderer *renderer,
+				 GLuint texture_handle)
 {
-	if (odc_font_load(font_path, &r->font) != 0) {
-		fprintf(stderr, "Failed to load font\n");
-	}
+	odc_texture_manager_remove(renderer->textures, texture_handle);
 }
 
-GLuint odc_renderer_upload_texture(struct renderer *renderer,
-				   const unsigned char *data, int width,
-				   int height)
+void odc_renderer_set_texture_budget(struct renderer *renderer, size_t bytes)
 {
-	if (renderer->texture_count >= MAX_TEXTURES) {
-		fprintf(stderr, "Maximum texture limit reached\n");
-		return 0;
+	odc_texture_manager_set_budget(renderer->textures, bytes);
+}
+
+size_t odc_renderer_get_texture_memory(struct renderer *renderer)
+{
+	return odc_texture_manager_get_usage(renderer->textures);
+}
+
+void odc_renderer_set_texture_pinned(struct renderer *renderer,
+				     GLuint texture_handle, int pinned)
+{
+	odc_texture_manager_set_pinned(renderer->textures, texture_handle,
+				       pinned);
+}
+
+void odc_renderer_set_texture_opaque(struct renderer *renderer,
+				     GLuint texture_handle, int opaque)
+{
+	struct managed_texture *texture =
+		odc_texture_manager_find(renderer->textures, texture_handle);
+	if (texture)
+		texture->opaque = opaque;
+}
+
+int odc_renderer_upload_palettes(struct renderer *renderer,
+				 const unsigned char *colors,
+				 int colors_per_palette, int palette_count)
+{
+	if (colors_per_palette <= 0 || colors_per_palette > MAX_PALETTE_COLORS ||
+	    palette_count <= 0) {
+		fprintf(stderr, "Invalid palette dimensions\n");
+		return -1;
 	}
 
-	GLuint texture_id;
-	glGenTextures(1, &texture_id);
-	glBindTexture(GL_TEXTURE_2D, texture_id);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
-		     GL_UNSIGNED_BYTE, data);
+	if (!renderer->palette_texture)
+		glGenTextures(1, &renderer->palette_texture);
+
+	odc_gl_state_bind_texture(GL_TEXTURE_2D, renderer->palette_texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, colors_per_palette,
+		     palette_count, 0, GL_RGBA, GL_UNSIGNED_BYTE, colors);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	odc_gl_state_bind_texture(GL_TEXTURE_2D, 0);
 
-	renderer->textures[renderer->texture_count].id = texture_id;
-	renderer->texture_count++;
+	renderer->palette_size = colors_per_palette;
+	renderer->palette_count = palette_count;
+	return 0;
+}
 
-	return texture_id;
+unsigned char *odc_renderer_read_palettes(struct renderer *renderer,
+					  int *colors_per_palette,
+					  int *palette_count)
+{
+	*colors_per_palette = renderer->palette_size;
+	*palette_count = renderer->palette_count;
+	if (!renderer->palette_texture)
+		return NULL;
+
+	return read_texture_image(renderer->palette_texture,
+				  renderer->palette_size,
+				  renderer->palette_count, 4);
+}
+
+void odc_renderer_update_palette(struct renderer *renderer, int palette_index,
+				 const unsigned char *colors)
+{
+	if (palette_index < 0 || palette_index >= renderer->palette_count)
+		return;
+
+	odc_gl_state_bind_texture(GL_TEXTURE_2D, renderer->palette_texture);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, palette_index,
+			renderer->palette_size, 1, GL_RGBA, GL_UNSIGNED_BYTE,
+			colors);
+	odc_gl_state_bind_texture(GL_TEXTURE_2D, 0);
 }
 
 void odc_renderer_add_line(struct renderer *renderer, float x1, float y1,
 			   float x2, float y2, float line_width,
 			   int screen_width, int screen_height, float color[4])
 {
-	// Calculate the angle of the line
-	float angle = atan2f(y2 - y1, x2 - x1);
-	float half_width = line_width / 2.0f;
+	odc_shape_batch_add_line(renderer->batch, x1, y1, x2, y2, line_width,
+				 screen_width, screen_height, color);
+}
 
-	// Calculate the corners of the line as a rectangle
-	float cos_angle = cosf(angle);
-	float sin_angle = sinf(angle);
+void odc_renderer_update_texture(struct renderer *renderer, GLuint texture_id,
+				 const unsigned char *data, int x, int y,
+				 int width, int height)
+{
+	if (odc_texture_manager_update(renderer->textures, texture_id, x, y,
+				       width, height, data) != 0)
+		return;
 
-	float dx = half_width * sin_angle;
-	float dy = half_width * cos_angle;
+	odc_gl_state_bind_texture(GL_TEXTURE_2D, texture_id);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RGBA,
+			GL_UNSIGNED_BYTE, data);
+	odc_gl_state_bind_texture(GL_TEXTURE_2D, 0);
+}
 
-	// Coordinates of the four corners
-	float x1_left = x1 - dx;
-	float y1_left = y1 + dy;
-	float x1_right = x1 + dx;
-	float y1_right = y1 - dy;
+unsigned int odc_renderer_update_texture_async(
+	struct renderer *renderer, GLuint texture_id, const unsigned char *data,
+	int x, int y, int width, int height, texture_stream_callback callback,
+	void *user_data)
+{
+	if (!renderer->stream) {
+		size_t size = (size_t)width * height * 4;
+		if (size < TEXTURE_STREAM_MIN_SLOT_SIZE)
+			size = TEXTURE_STREAM_MIN_SLOT_SIZE;
+		renderer->stream = odc_texture_stream_new(
+			renderer->textures, TEXTURE_STREAM_DEFAULT_SLOTS, size);
+		if (!renderer->stream) {
+			odc_renderer_update_texture(renderer, texture_id, data,
+						    x, y, width, height);
+			return 0;
+		}
+	}
 
-	float x2_left = x2 - dx;
-	float y2_left = y2 + dy;
-	float x2_right = x2 + dx;
-	float y2_right = y2 - dy;
+	return odc_texture_stream_upload(renderer->stream, texture_id, x, y,
+					 width, height, GL_RGBA, data,
+					 callback, user_data);
+}
 
-	// First triangle
-	odc_renderer_add_triangle(renderer, x1_left, y1_left, x2_left, y2_left,
-				  x2_right, y2_right, screen_width,
-				  screen_height, color);
-	// Second triangle
-	odc_renderer_add_triangle(renderer, x1_left, y1_left, x2_right,
-				  y2_right, x1_right, y1_right, screen_width,
-				  screen_height, color);
+struct texture_stream *odc_renderer_get_texture_stream(struct renderer *renderer)
+{
+	return renderer->stream;
 }
 
-void odc_renderer_update_texture(GLuint texture_id, const unsigned char *data,
-				 int x, int y, int width, int height)
+struct texture_manager *
+odc_renderer_get_texture_manager(struct renderer *renderer)
 {
-	glBindTexture(GL_TEXTURE_2D, texture_id);
-	glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RGBA,
-			GL_UNSIGNED_BYTE, data);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	return renderer->textures;
 }
@@ -1,11 +1,48 @@
 #include "glad.h"
 
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "odc_cache.h"
 #include "odc_shader.h"
 
+#define PROGRAM_CACHE_MAGIC "ODCP"
+#define PROGRAM_CACHE_VERSION 1
+
+// Program binaries and parallel compilation are newer than the GL 3.3 core
+// glad was generated for, so their entry points are resolved by hand
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+
+typedef void(GLAD_API_PTR *get_program_binary_fn)(GLuint program,
+						   GLsizei size,
+						   GLsizei *length,
+						   GLenum *format, void *data);
+typedef void(GLAD_API_PTR *program_binary_fn)(GLuint program, GLenum format,
+					       const void *data, GLsizei length);
+typedef void(GLAD_API_PTR *program_parameteri_fn)(GLuint program,
+						   GLenum name, GLint value);
+typedef void(GLAD_API_PTR *max_compiler_threads_fn)(GLuint count);
+
+struct program_cache_header {
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	uint32_t format;
+	uint32_t length;
+};
+
+static struct {
+	get_program_binary_fn get_program_binary;
+	program_binary_fn program_binary;
+	program_parameteri_fn program_parameteri;
+	int parallel_compile;
+	int cache_enabled;
+} shader_ext = { .cache_enabled = 1 };
+
 GLuint odc_shader_compile_shader(const char *source, GLenum shaderType,
 				 char *error)
 {
@@ -34,47 +71,304 @@ GLuint odc_shader_compile_shader(const char *source, GLenum shaderType,
 	return shader;
 }
 
-GLuint odc_shader_new_program(const char *vertexShaderSource,
-			      const char *fragmentShaderSource, char *error)
+static int has_extension(const char *name)
 {
-	GLuint vertexShader = odc_shader_compile_shader(
-		vertexShaderSource, GL_VERTEX_SHADER, error);
-	if (vertexShader == 0) {
-		return 0;
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; ++i) {
+		const char *extension =
+			(const char *)glGetStringi(GL_EXTENSIONS, i);
+		if (extension && strcmp(extension, name) == 0)
+			return 1;
 	}
+	return 0;
+}
+
+void odc_shader_load_extensions(GLADloadfunc load)
+{
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+
+	shader_ext.get_program_binary = NULL;
+	shader_ext.program_binary = NULL;
+	shader_ext.program_parameteri = NULL;
+	shader_ext.parallel_compile = 0;
 
-	GLuint fragmentShader = odc_shader_compile_shader(
-		fragmentShaderSource, GL_FRAGMENT_SHADER, error);
-	if (fragmentShader == 0) {
+	GLint formats = 0;
+	if (major > 4 || (major == 4 && minor >= 1) ||
+	    has_extension("GL_ARB_get_program_binary")) {
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		glGetError();
+	}
+
+	// A driver that reports no formats can't reload what it saves
+	if (formats > 0) {
+		shader_ext.get_program_binary =
+			(get_program_binary_fn)load("glGetProgramBinary");
+		shader_ext.program_binary =
+			(program_binary_fn)load("glProgramBinary");
+		shader_ext.program_parameteri =
+			(program_parameteri_fn)load("glProgramParameteri");
+		if (!shader_ext.get_program_binary ||
+		    !shader_ext.program_binary ||
+		    !shader_ext.program_parameteri) {
+			shader_ext.get_program_binary = NULL;
+			shader_ext.program_binary = NULL;
+			shader_ext.program_parameteri = NULL;
+		}
+	}
+
+	max_compiler_threads_fn max_threads = NULL;
+	if (has_extension("GL_KHR_parallel_shader_compile"))
+		max_threads = (max_compiler_threads_fn)load(
+			"glMaxShaderCompilerThreadsKHR");
+	else if (has_extension("GL_ARB_parallel_shader_compile"))
+		max_threads = (max_compiler_threads_fn)load(
+			"glMaxShaderCompilerThreadsARB");
+	if (max_threads) {
+		// 0xffffffff lets the driver pick its own thread count
+		max_threads(0xffffffffu);
+		shader_ext.parallel_compile = 1;
+	}
+}
+
+void odc_shader_set_cache_enabled(int enabled)
+{
+	shader_ext.cache_enabled = enabled;
+}
+
+int odc_shader_has_parallel_compile(void)
+{
+	return shader_ext.parallel_compile;
+}
+
+static int binary_cache_available(void)
+{
+	return shader_ext.cache_enabled && shader_ext.program_binary;
+}
+
+static uint64_t program_key(const struct shader_source *source)
+{
+	uint64_t key = odc_cache_hash_string(CACHE_HASH_SEED, source->vertex);
+	key = odc_cache_hash_string(key, source->fragment);
+	// A driver update invalidates every binary it produced before
+	key = odc_cache_hash_string(key, (const char *)glGetString(GL_VENDOR));
+	key = odc_cache_hash_string(key,
+				    (const char *)glGetString(GL_RENDERER));
+	key = odc_cache_hash_string(key, (const char *)glGetString(GL_VERSION));
+	return key;
+}
+
+static void program_cache_name(uint64_t key, char *name, size_t size)
+{
+	snprintf(name, size, "program-%016llx.bin", (unsigned long long)key);
+}
+
+static GLuint load_cached_program(uint64_t key)
+{
+	char name[64];
+	program_cache_name(key, name, sizeof(name));
+
+	size_t size = 0;
+	unsigned char *data = (unsigned char *)odc_cache_read(name, &size);
+	if (!data)
 		return 0;
+
+	struct program_cache_header header;
+	GLuint program = 0;
+	if (size >= sizeof(header)) {
+		memcpy(&header, data, sizeof(header));
+		if (memcmp(header.magic, PROGRAM_CACHE_MAGIC, 4) == 0 &&
+		    header.version == PROGRAM_CACHE_VERSION &&
+		    header.key == key &&
+		    header.length == size - sizeof(header)) {
+			program = glCreateProgram();
+			shader_ext.program_binary(program, header.format,
+						  data + sizeof(header),
+						  (GLsizei)header.length);
+
+			GLint status = GL_FALSE;
+			glGetProgramiv(program, GL_LINK_STATUS, &status);
+			if (status == GL_FALSE) {
+				glDeleteProgram(program);
+				program = 0;
+			}
+		}
 	}
 
-	GLuint program = glCreateProgram();
-	glAttachShader(program, vertexShader);
-	glAttachShader(program, fragmentShader);
-	glLinkProgram(program);
+	// Drivers may reject binaries for reasons the key can't capture;
+	// the entry gets rewritten after the fallback compile
+	glGetError();
+	free(data);
+	return program;
+}
 
-	GLint status;
-	glGetProgramiv(program, GL_LINK_STATUS, &status);
+static void save_cached_program(uint64_t key, GLuint program)
+{
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	unsigned char *data =
+		(unsigned char *)malloc(sizeof(struct program_cache_header) +
+					length);
+	if (!data)
+		return;
+
+	struct program_cache_header header;
+	memcpy(header.magic, PROGRAM_CACHE_MAGIC, 4);
+	header.version = PROGRAM_CACHE_VERSION;
+	header.key = key;
+
+	GLenum format = 0;
+	GLsizei written = 0;
+	shader_ext.get_program_binary(program, length, &written, &format,
+				      data + sizeof(header));
+	header.format = format;
+	header.length = (uint32_t)written;
+	memcpy(data, &header, sizeof(header));
+
+	if (written > 0) {
+		char name[64];
+		program_cache_name(key, name, sizeof(name));
+		odc_cache_write(name, data, sizeof(header) + written);
+	}
+
+	free(data);
+}
+
+static GLuint create_shader(const char *source, GLenum type)
+{
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, NULL);
+	glCompileShader(shader);
+	return shader;
+}
+
+static void copy_info_log(GLuint object, int is_program, const char *prefix,
+			  char *error)
+{
+	GLint log_length = 0;
+	if (is_program)
+		glGetProgramiv(object, GL_INFO_LOG_LENGTH, &log_length);
+	else
+		glGetShaderiv(object, GL_INFO_LOG_LENGTH, &log_length);
+
+	char *log = (char *)calloc(1, log_length + 1);
+	if (log && log_length > 0) {
+		if (is_program)
+			glGetProgramInfoLog(object, log_length, NULL, log);
+		else
+			glGetShaderInfoLog(object, log_length, NULL, log);
+	}
+
+	snprintf(error, MAX_SHADER_ERROR, "%s: %s", prefix, log ? log : "");
+	free(log);
+}
+
+static void report_link_failure(GLuint vertex, GLuint fragment,
+				GLuint program, char *error)
+{
+	GLint status = GL_FALSE;
+	glGetShaderiv(vertex, GL_COMPILE_STATUS, &status);
 	if (status == GL_FALSE) {
-		GLint logLength;
-		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+		copy_info_log(vertex, 0, "failed to compile shader", error);
+		return;
+	}
 
-		char *log = (char *)malloc(logLength + 1);
-		glGetProgramInfoLog(program, logLength, NULL, log);
+	glGetShaderiv(fragment, GL_COMPILE_STATUS, &status);
+	if (status == GL_FALSE) {
+		copy_info_log(fragment, 0, "failed to compile shader", error);
+		return;
+	}
 
-		snprintf(error, logLength + 1, "failed to link program: %s",
-			 log);
-		free(log);
+	copy_info_log(program, 1, "failed to link program", error);
+}
 
-		glDeleteShader(vertexShader);
-		glDeleteShader(fragmentShader);
-		glDeleteProgram(program);
-		return 0;
+int odc_shader_new_programs(const struct shader_source *sources, int count,
+			    GLuint *programs, char *error)
+{
+	GLuint *shaders = (GLuint *)calloc(count * 2, sizeof(GLuint));
+	uint64_t *keys = (uint64_t *)calloc(count, sizeof(uint64_t));
+	if (!shaders || !keys) {
+		free(shaders);
+		free(keys);
+		snprintf(error, MAX_SHADER_ERROR, "out of memory");
+		return -1;
+	}
+
+	int use_cache = binary_cache_available();
+	for (int i = 0; i < count; ++i) {
+		programs[i] = 0;
+		if (use_cache) {
+			keys[i] = program_key(&sources[i]);
+			programs[i] = load_cached_program(keys[i]);
+		}
+	}
+
+	// Issue every compile and link before querying any status, so a
+	// driver with parallel compilation works on all of them at once
+	for (int i = 0; i < count; ++i) {
+		if (programs[i])
+			continue;
+
+		shaders[i * 2] =
+			create_shader(sources[i].vertex, GL_VERTEX_SHADER);
+		shaders[i * 2 + 1] =
+			create_shader(sources[i].fragment, GL_FRAGMENT_SHADER);
+
+		programs[i] = glCreateProgram();
+		glAttachShader(programs[i], shaders[i * 2]);
+		glAttachShader(programs[i], shaders[i * 2 + 1]);
+		if (use_cache)
+			shader_ext.program_parameteri(
+				programs[i], GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+				GL_TRUE);
+		glLinkProgram(programs[i]);
 	}
 
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
+	int result = 0;
+	for (int i = 0; i < count; ++i) {
+		if (!shaders[i * 2])
+			continue;
 
+		GLint status = GL_FALSE;
+		glGetProgramiv(programs[i], GL_LINK_STATUS, &status);
+		if (status == GL_FALSE && result == 0) {
+			report_link_failure(shaders[i * 2], shaders[i * 2 + 1],
+					    programs[i], error);
+			result = -1;
+		} else if (status != GL_FALSE && use_cache) {
+			save_cached_program(keys[i], programs[i]);
+		}
+
+		glDetachShader(programs[i], shaders[i * 2]);
+		glDetachShader(programs[i], shaders[i * 2 + 1]);
+		glDeleteShader(shaders[i * 2]);
+		glDeleteShader(shaders[i * 2 + 1]);
+	}
+
+	if (result != 0) {
+		for (int i = 0; i < count; ++i) {
+			glDeleteProgram(programs[i]);
+			programs[i] = 0;
+		}
+	}
+
+	free(shaders);
+	free(keys);
+	return result;
+}
+
+GLuint odc_shader_new_program(const char *vertexShaderSource,
+			      const char *fragmentShaderSource, char *error)
+{
+	struct shader_source source = { vertexShaderSource,
+					fragmentShaderSource };
+	GLuint program = 0;
+	if (odc_shader_new_programs(&source, 1, &program, error) != 0)
+		return 0;
 	return program;
 }
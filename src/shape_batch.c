@@ -0,0 +1,761 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "odc_font.h"
+#include "odc_shape_batch.h"
+#include "odc_text_layout.h"
+
+struct shape_batch {
+	struct vertex vertices[MAX_SHAPES * 6];
+	GLuint indices[MAX_SHAPES * 6];
+	struct draw_batch batches[MAX_DRAW_BATCHES];
+	int batch_count;
+	int shape_count;
+	int culling;
+};
+
+struct shape_batch *odc_shape_batch_new(void)
+{
+	struct shape_batch *batch =
+		(struct shape_batch *)calloc(1, sizeof(struct shape_batch));
+	if (!batch) {
+		fprintf(stderr,
+			"ERROR::SHAPE_BATCH: Failed to allocate shape batch\n");
+		return NULL;
+	}
+
+	batch->culling = 1;
+	return batch;
+}
+
+void odc_shape_batch_destroy(struct shape_batch *batch)
+{
+	free(batch);
+}
+
+void odc_shape_batch_reset(struct shape_batch *batch)
+{
+	batch->shape_count = 0;
+	batch->batch_count = 0;
+}
+
+void odc_shape_batch_clear(struct shape_batch *batch)
+{
+	memset(batch->vertices, 0, sizeof(batch->vertices));
+}
+
+void odc_shape_batch_set_culling(struct shape_batch *batch, int enabled)
+{
+	batch->culling = enabled;
+}
+
+static int is_visible(struct shape_batch *batch, float min_x, float min_y,
+		      float max_x, float max_y, int screen_width,
+		      int screen_height)
+{
+	if (!batch->culling)
+		return 1;
+	return max_x >= 0.0f && max_y >= 0.0f &&
+	       min_x <= (float)screen_width && min_y <= (float)screen_height;
+}
+
+// Returns the first of the next shape's six vertices, or NULL when full.
+// Untextured shapes still need a batch to be drawn through.
+static struct vertex *next_shape(struct shape_batch *batch)
+{
+	if (batch->shape_count >= MAX_SHAPES)
+		return NULL;
+
+	if (batch->batch_count == 0) {
+		batch->batches[0].first_shape = 0;
+		batch->batches[0].texture = 0;
+		batch->batch_count = 1;
+	}
+	return &batch->vertices[batch->shape_count * 6];
+}
+
+static int use_texture(struct shape_batch *batch, GLuint texture)
+{
+	if (batch->batch_count > 0) {
+		struct draw_batch *last =
+			&batch->batches[batch->batch_count - 1];
+		if (last->texture == texture)
+			return 0;
+		if (last->texture == 0) {
+			last->texture = texture;
+			return 0;
+		}
+	}
+
+	if (batch->batch_count >= MAX_DRAW_BATCHES) {
+		fprintf(stderr, "Maximum draw batch limit reached\n");
+		return -1;
+	}
+
+	struct draw_batch *draw = &batch->batches[batch->batch_count];
+	draw->first_shape = batch->batch_count == 0 ? 0 : batch->shape_count;
+	draw->texture = texture;
+	batch->batch_count++;
+	return 0;
+}
+
+static void normalize_coordinates(float x, float y, int screen_width,
+				  int screen_height, float *norm_x,
+				  float *norm_y)
+{
+	*norm_x = (x / (float)screen_width) * 2.0f - 1.0f;
+	*norm_y = 1.0f - (y / (float)screen_height) * 2.0f;
+}
+
+void odc_shape_batch_add_equilateral_triangle(struct shape_batch *batch,
+					      float x, float y, float size,
+					      int screen_width,
+					      int screen_height,
+					      const float *color)
+{
+	float half_size = size / 2.0f;
+	if (!is_visible(batch, x - half_size, y - half_size, x + half_size,
+			y + half_size, screen_width, screen_height))
+		return;
+
+	struct vertex *shape = next_shape(batch);
+	if (!shape)
+		return;
+
+	float norm_x, norm_y;
+	normalize_coordinates(x, y, screen_width, screen_height, &norm_x,
+			      &norm_y);
+
+	float height = size;
+
+	float vertices[12] = {-half_size,     -height / 2.0f, half_size,
+			      -height / 2.0f, 0.0f,	      height / 2.0f,
+			      -half_size,     -height / 2.0f, half_size,
+			      -height / 2.0f, 0.0f,	      height / 2.0f};
+
+	for (int i = 0; i < 6; ++i) {
+		struct vertex *v = &shape[i];
+
+		v->fs_quad_pos[0] = vertices[i * 2];
+		v->fs_quad_pos[1] = vertices[i * 2 + 1];
+
+		v->shape_pos[0] = norm_x;
+		v->shape_pos[1] = norm_y;
+
+		v->local_pos[0] = vertices[i * 2];
+		v->local_pos[1] = vertices[i * 2 + 1];
+
+		v->op_code = OP_CODE_EQUILATERAL_TRIANGLE;
+		v->radius = 0.0f;
+		v->width = size;
+		v->height = size;
+
+		for (int j = 0; j < 4; ++j)
+			v->color[j] = color[j];
+
+		v->resolution[0] = (float)screen_width;
+		v->resolution[1] = (float)screen_height;
+	}
+
+	batch->shape_count++;
+}
+
+void odc_shape_batch_add_triangle(struct shape_batch *batch, float x1,
+				  float y1, float x2, float y2, float x3,
+				  float y3, int screen_width, int screen_height,
+				  const float *color)
+{
+	if (!is_visible(batch, fminf(x1, fminf(x2, x3)),
+			fminf(y1, fminf(y2, y3)), fmaxf(x1, fmaxf(x2, x3)),
+			fmaxf(y1, fmaxf(y2, y3)), screen_width,
+			screen_height))
+		return;
+
+	struct vertex *shape = next_shape(batch);
+	if (!shape)
+		return;
+
+	float norm_x1, norm_y1, norm_x2, norm_y2, norm_x3, norm_y3;
+	normalize_coordinates(x1, y1, screen_width, screen_height, &norm_x1,
+			      &norm_y1);
+	normalize_coordinates(x2, y2, screen_width, screen_height, &norm_x2,
+			      &norm_y2);
+	normalize_coordinates(x3, y3, screen_width, screen_height, &norm_x3,
+			      &norm_y3);
+
+	float vertices[6] = {norm_x1, norm_y1, norm_x2,
+			     norm_y2, norm_x3, norm_y3};
+
+	// The second triangle of the slot collapses onto the third corner so
+	// it draws nothing
+	for (int i = 0; i < 6; ++i) {
+		struct vertex *v = &shape[i];
+		int corner = i < 3 ? i : 2;
+
+		v->fs_quad_pos[0] = vertices[corner * 2];
+		v->fs_quad_pos[1] = vertices[corner * 2 + 1];
+
+		v->shape_pos[0] = 0.0f;
+		v->shape_pos[1] = 0.0f;
+
+		v->local_pos[0] = vertices[corner * 2];
+		v->local_pos[1] = vertices[corner * 2 + 1];
+
+		v->op_code = OP_CODE_TRIANGLE;
+		v->radius = 0.0f;
+		v->width = 0.0f;
+		v->height = 0.0f;
+
+		for (int j = 0; j < 4; ++j)
+			v->color[j] = color[j];
+
+		v->resolution[0] = (float)screen_width;
+		v->resolution[1] = (float)screen_height;
+	}
+
+	batch->shape_count++;
+}
+
+void odc_shape_batch_add_circle(struct shape_batch *batch, float x, float y,
+				float radius, int screen_width,
+				int screen_height, const float *color)
+{
+	if (!is_visible(batch, x - radius, y - radius, x + radius, y + radius,
+			screen_width, screen_height))
+		return;
+
+	struct vertex *shape = next_shape(batch);
+	if (!shape)
+		return;
+
+	float norm_x, norm_y;
+	normalize_coordinates(x, y, screen_width, screen_height, &norm_x,
+			      &norm_y);
+
+	float vertices[12] = {-radius, radius,	-radius, -radius,
+			      radius,  -radius, -radius, radius,
+			      radius,  -radius, radius,	 radius};
+
+	for (int i = 0; i < 6; ++i) {
+		struct vertex *v = &shape[i];
+
+		v->fs_quad_pos[0] = vertices[i * 2];
+		v->fs_quad_pos[1] = vertices[i * 2 + 1];
+
+		v->shape_pos[0] = norm_x;
+		v->shape_pos[1] = norm_y;
+
+		v->local_pos[0] = vertices[i * 2];
+		v->local_pos[1] = vertices[i * 2 + 1];
+
+		v->op_code = OP_CODE_CIRCLE;
+		v->radius = radius;
+		v->width = radius * 2.0f;
+		v->height = radius * 2.0f;
+
+		for (int j = 0; j < 4; ++j)
+			v->color[j] = color[j];
+
+		v->resolution[0] = (float)screen_width;
+		v->resolution[1] = (float)screen_height;
+	}
+	batch->shape_count++;
+}
+
+static void add_sdf_quad(struct shape_batch *batch, float x, float y,
+			 float width, float height, float op_code, float param,
+			 int screen_width, int screen_height,
+			 const float *color)
+{
+	if (!is_visible(batch, x, y, x + width, y + height, screen_width,
+			screen_height))
+		return;
+
+	struct vertex *shape = next_shape(batch);
+	if (!shape)
+		return;
+
+	float norm_x, norm_y;
+	normalize_coordinates(x, y, screen_width, screen_height, &norm_x,
+			      &norm_y);
+
+	float half_width = width * 0.5f;
+	float half_height = height * 0.5f;
+
+	float vertices[12] = {-half_width,  half_height, -half_width,
+			      -half_height, half_width,	 -half_height,
+			      -half_width,  half_height, half_width,
+			      -half_height, half_width,	 half_height};
+
+	for (int i = 0; i < 6; ++i) {
+		struct vertex *v = &shape[i];
+
+		v->fs_quad_pos[0] = vertices[i * 2];
+		v->fs_quad_pos[1] = vertices[i * 2 + 1];
+
+		v->shape_pos[0] = norm_x + half_width / screen_width * 2.0f;
+		v->shape_pos[1] = norm_y - half_height / screen_height * 2.0f;
+
+		v->local_pos[0] = vertices[i * 2];
+		v->local_pos[1] = vertices[i * 2 + 1];
+
+		v->op_code = op_code;
+		v->radius = param;
+		v->width = width;
+		v->height = height;
+
+		for (int j = 0; j < 4; ++j)
+			v->color[j] = color[j];
+
+		v->resolution[0] = (float)screen_width;
+		v->resolution[1] = (float)screen_height;
+	}
+	batch->shape_count++;
+}
+
+void odc_shape_batch_add_rounded_rect(struct shape_batch *batch, float x,
+				      float y, float width, float height,
+				      float radius, int screen_width,
+				      int screen_height, const float *color)
+{
+	add_sdf_quad(batch, x, y, width, height, OP_CODE_ROUNDED_RECT, radius,
+		     screen_width, screen_height, color);
+}
+
+void odc_shape_batch_add_custom_shape(struct shape_batch *batch, int shape,
+				      float x, float y, float width,
+				      float height, float param,
+				      int screen_width, int screen_height,
+				      const float *color)
+{
+	add_sdf_quad(batch, x, y, width, height,
+		     OP_CODE_CUSTOM_BASE + (float)shape, param, screen_width,
+		     screen_height, color);
+}
+
+void odc_shape_batch_add_line(struct shape_batch *batch, float x1, float y1,
+			      float x2, float y2, float line_width,
+			      int screen_width, int screen_height,
+			      const float *color)
+{
+	// Calculate the angle of the line
+	float angle = atan2f(y2 - y1, x2 - x1);
+	float half_width = line_width / 2.0f;
+
+	// Calculate the corners of the line as a rectangle
+	float cos_angle = cosf(angle);
+	float sin_angle = sinf(angle);
+
+	float dx = half_width * sin_angle;
+	float dy = half_width * cos_angle;
+
+	// Coordinates of the four corners
+	float x1_left = x1 - dx;
+	float y1_left = y1 + dy;
+	float x1_right = x1 + dx;
+	float y1_right = y1 - dy;
+
+	float x2_left = x2 - dx;
+	float y2_left = y2 + dy;
+	float x2_right = x2 + dx;
+	float y2_right = y2 - dy;
+
+	// First triangle
+	odc_shape_batch_add_triangle(batch, x1_left, y1_left, x2_left, y2_left,
+				     x2_right, y2_right, screen_width,
+				     screen_height, color);
+	// Second triangle
+	odc_shape_batch_add_triangle(batch, x1_left, y1_left, x2_right,
+				     y2_right, x1_right, y1_right,
+				     screen_width, screen_height, color);
+}
+
+static void add_glyph(struct shape_batch *batch, float x0, float y0,
+		      float x1, float y1, float u0, float v0, float u1,
+		      float v1, int screen_width, int screen_height,
+		      const float *color)
+{
+	struct vertex *shape = next_shape(batch);
+	if (!shape)
+		return;
+
+	float corners[24] = {x0, y0, u0, v0, x0, y1, u0, v1, x1, y1, u1, v1,
+			     x0, y0, u0, v0, x1, y1, u1, v1, x1, y0, u1, v0};
+
+	for (int i = 0; i < 6; ++i) {
+		struct vertex *v = &shape[i];
+
+		float norm_quad_x, norm_quad_y;
+		normalize_coordinates(corners[i * 4], corners[i * 4 + 1],
+				      screen_width, screen_height,
+				      &norm_quad_x, &norm_quad_y);
+
+		v->fs_quad_pos[0] = norm_quad_x;
+		v->fs_quad_pos[1] = norm_quad_y;
+
+		v->shape_pos[0] = 0.0f;
+		v->shape_pos[1] = 0.0f;
+
+		v->local_pos[0] = corners[i * 4];
+		v->local_pos[1] = corners[i * 4 + 1];
+
+		v->op_code = OP_CODE_TEXT;
+		v->radius = 0.0f;
+		v->width = x1 - x0;
+		v->height = y1 - y0;
+
+		for (int j = 0; j < 4; j++)
+			v->color[j] = color[j];
+
+		v->resolution[0] = (float)screen_width;
+		v->resolution[1] = (float)screen_height;
+
+		v->tex_coord[0] = corners[i * 4 + 2];
+		v->tex_coord[1] = corners[i * 4 + 3];
+	}
+
+	batch->shape_count++;
+}
+
+// Lays out length bytes of UTF-8 text on one line with its top at y
+static void add_text_line(struct shape_batch *batch, struct font *font,
+			  const char *text, size_t length, float x, float y,
+			  float scale, int screen_width, int screen_height,
+			  const float *color)
+{
+	float baseline = y + (font->ascender * scale);
+	int pixel_size = odc_font_get_pixel_size(font, scale);
+	const char *end = text + length;
+
+	while (text < end) {
+		uint32_t c = odc_font_next_codepoint(&text);
+		if (c == 0)
+			break;
+		if (c < 32) {
+			// Skip control characters
+			continue;
+		}
+
+		int glyph_size;
+		const struct glyph *g = odc_font_get_nearest_glyph(
+			font, c, pixel_size, &glyph_size);
+		if (!g)
+			continue;
+
+		float glyph_scale =
+			(float)FONT_BASE_SIZE * scale / (float)glyph_size;
+		float xpos = x + (g->bearing_x * glyph_scale);
+		float ypos = baseline - (g->bearing_y * glyph_scale);
+
+		float w = (float)g->width * glyph_scale;
+		float h = (float)g->height * glyph_scale;
+
+		x += (float)g->advance * glyph_scale;
+		if (g->width == 0 || g->height == 0 ||
+		    !is_visible(batch, xpos, ypos, xpos + w, ypos + h,
+				screen_width, screen_height))
+			continue;
+		if (batch->shape_count >= MAX_SHAPES)
+			return;
+
+		add_glyph(batch, xpos, ypos, xpos + w, ypos + h,
+			  g->tex_offset_x, g->tex_offset_y,
+			  g->tex_offset_x + ((float)g->width / ATLAS_WIDTH),
+			  g->tex_offset_y + ((float)g->height / ATLAS_HEIGHT),
+			  screen_width, screen_height, color);
+	}
+}
+
+void odc_shape_batch_add_text(struct shape_batch *batch, struct font *font,
+			      const char *text, float x, float y, float scale,
+			      int screen_width, int screen_height,
+			      const float *color)
+{
+	if (!text)
+		return;
+
+	add_text_line(batch, font, text, strlen(text), x, y, scale,
+		      screen_width, screen_height, color);
+}
+
+void odc_shape_batch_add_multiline_text(struct shape_batch *batch,
+					struct font *font, const char *text,
+					float x, float y, float scale,
+					int screen_width, int screen_height,
+					const float *color)
+{
+	if (!text)
+		return;
+
+	float line_spacing =
+		(font->ascender - font->descender + font->line_gap) * scale;
+
+	for (;;) {
+		const char *end = strchr(text, '\n');
+		size_t length = end ? (size_t)(end - text) : strlen(text);
+		add_text_line(batch, font, text, length, x, y, scale,
+			      screen_width, screen_height, color);
+		if (!end)
+			break;
+		text = end + 1;
+		y += line_spacing;
+	}
+}
+
+void odc_shape_batch_add_text_layout(struct shape_batch *batch,
+				     const struct text_layout *layout,
+				     float x, float y, int screen_width,
+				     int screen_height, const float *color)
+{
+	if (!layout || layout->glyph_count == 0 ||
+	    !is_visible(batch, x + layout->min_x, y + layout->min_y,
+			x + layout->max_x, y + layout->max_y, screen_width,
+			screen_height))
+		return;
+
+	for (int i = 0; i < layout->glyph_count; ++i) {
+		const struct text_layout_glyph *g = &layout->glyphs[i];
+		if (!is_visible(batch, x + g->x0, y + g->y0, x + g->x1,
+				y + g->y1, screen_width, screen_height))
+			continue;
+		if (batch->shape_count >= MAX_SHAPES)
+			return;
+
+		add_glyph(batch, x + g->x0, y + g->y0, x + g->x1, y + g->y1,
+			  g->u0, g->v0, g->u1, g->v1, screen_width,
+			  screen_height, color);
+	}
+}
+
+static void add_textured_quad(struct shape_batch *batch,
+			      GLuint texture_handle,
+			      const struct texture_render_options *options,
+			      float op_code, float param, float anim_id,
+			      float anim_start)
+{
+	float width = options->rect_width * options->scale;
+	float height = options->rect_height * options->scale;
+
+	// The quad turns about its top-left corner, so anything it can reach
+	// lies within its diagonal of (x, y)
+	float reach = sqrtf(width * width + height * height);
+	if (!is_visible(batch, options->x - reach, options->y - reach,
+			options->x + reach, options->y + reach,
+			options->screen_width, options->screen_height))
+		return;
+
+	if (batch->shape_count >= MAX_SHAPES ||
+	    use_texture(batch, texture_handle) != 0)
+		return;
+
+	struct vertex *shape = next_shape(batch);
+
+	float norm_x, norm_y;
+	normalize_coordinates(options->x, options->y, options->screen_width,
+			      options->screen_height, &norm_x, &norm_y);
+
+	float u0 = options->rect_x / options->width;
+	float v0 = options->rect_y / options->height;
+	float u1 = (options->rect_x + options->rect_width) / options->width;
+	float v1 = (options->rect_y + options->rect_height) / options->height;
+
+	if (options->flip_x) {
+		float temp = u0;
+		u0 = u1;
+		u1 = temp;
+	}
+
+	if (options->flip_y) {
+		float temp = v0;
+		v0 = v1;
+		v1 = temp;
+	}
+
+	float vertices[24] = {0.0f,  0.0f,    u0, v1, 0.0f,  -height, u0, v0,
+			      width, -height, u1, v0, 0.0f,  0.0f,    u0, v1,
+			      width, -height, u1, v0, width, 0.0f,    u1, v1};
+
+	float cos_theta = cosf(options->rotation);
+	float sin_theta = sinf(options->rotation);
+
+	for (int i = 0; i < 6; ++i) {
+		struct vertex *v = &shape[i];
+
+		float local_x = vertices[i * 4];
+		float local_y = vertices[i * 4 + 1];
+
+		float rotated_x = local_x * cos_theta - local_y * sin_theta;
+		float rotated_y = local_x * sin_theta + local_y * cos_theta;
+
+		v->fs_quad_pos[0] = rotated_x;
+		v->fs_quad_pos[1] = rotated_y;
+
+		v->shape_pos[0] = norm_x;
+		v->shape_pos[1] = norm_y;
+
+		v->local_pos[0] = rotated_x;
+		v->local_pos[1] = rotated_y;
+
+		v->op_code = op_code;
+		v->radius = param;
+		v->width = options->width;
+		v->height = options->height;
+
+		for (int j = 0; j < 4; ++j)
+			v->color[j] = 1.0f;
+
+		v->resolution[0] = (float)options->screen_width;
+		v->resolution[1] = (float)options->screen_height;
+
+		v->tex_coord[0] = vertices[i * 4 + 2];
+		v->tex_coord[1] = vertices[i * 4 + 3];
+
+		v->anim[0] = anim_id;
+		v->anim[1] = anim_start;
+	}
+
+	batch->shape_count++;
+}
+
+void odc_shape_batch_add_texture(struct shape_batch *batch,
+				 GLuint texture_handle,
+				 const struct texture_render_options *options)
+{
+	add_textured_quad(batch, texture_handle, options, OP_CODE_TEXTURE,
+			  0.0f, 0.0f, 0.0f);
+}
+
+void odc_shape_batch_add_indexed_texture(
+	struct shape_batch *batch, GLuint texture_handle, int palette_index,
+	const struct texture_render_options *options)
+{
+	// The palette row rides in the radius slot, which textures don't use
+	add_textured_quad(batch, texture_handle, options,
+			  OP_CODE_INDEXED_TEXTURE, (float)palette_index, 0.0f,
+			  0.0f);
+}
+
+void odc_shape_batch_add_animated_sprite(
+	struct shape_batch *batch, GLuint texture_handle, int animation_id,
+	float start_time, const struct texture_render_options *options)
+{
+	add_textured_quad(batch, texture_handle, options,
+			  OP_CODE_ANIMATED_SPRITE, 0.0f, (float)animation_id,
+			  start_time);
+}
+
+int odc_shape_batch_add_shapes(struct shape_batch *batch,
+			       const struct vertex *vertices, int shape_count,
+			       GLuint texture_handle)
+{
+	if (shape_count > MAX_SHAPES - batch->shape_count)
+		shape_count = MAX_SHAPES - batch->shape_count;
+	if (shape_count <= 0 ||
+	    (texture_handle && use_texture(batch, texture_handle) != 0) ||
+	    !next_shape(batch))
+		return 0;
+
+	memcpy(&batch->vertices[batch->shape_count * 6], vertices,
+	       sizeof(struct vertex) * shape_count * 6);
+	batch->shape_count += shape_count;
+	return shape_count;
+}
+
+static int batch_end(struct shape_batch *batch, int index)
+{
+	return index + 1 < batch->batch_count
+		       ? batch->batches[index + 1].first_shape
+		       : batch->shape_count;
+}
+
+// Only shapes that cover every pixel of their quad with alpha 1 may write
+// depth; SDF shapes leave transparent pixels around their edges
+static int is_opaque_shape(const struct vertex *v, int texture_opaque)
+{
+	if (v->color[3] < 1.0f)
+		return 0;
+
+	if (v->op_code == OP_CODE_TRIANGLE)
+		return 1;
+	if (v->op_code == OP_CODE_ROUNDED_RECT)
+		return v->radius <= 0.0f;
+	if (v->op_code == OP_CODE_TEXTURE ||
+	    v->op_code == OP_CODE_ANIMATED_SPRITE)
+		return texture_opaque;
+	return 0;
+}
+
+// Opaque shapes fill the index buffer from the front and translucent ones
+// from the back. The two halves meet, so one upload covers both.
+int odc_shape_batch_sort(struct shape_batch *batch,
+			 shape_batch_opaque_fn is_texture_opaque,
+			 void *user_data)
+{
+	GLuint *front = batch->indices;
+	GLuint *back = batch->indices + batch->shape_count * 6;
+
+	for (int i = batch->batch_count - 1; i >= 0; --i) {
+		struct draw_batch *draw = &batch->batches[i];
+		int texture_opaque =
+			is_texture_opaque &&
+			is_texture_opaque(draw->texture, user_data);
+		GLuint *opaque_start = front;
+		GLuint *translucent_end = back;
+
+		for (int shape = batch_end(batch, i) - 1;
+		     shape >= draw->first_shape; --shape) {
+			GLuint *out;
+			if (is_opaque_shape(&batch->vertices[shape * 6],
+					    texture_opaque)) {
+				out = front;
+				front += 6;
+			} else {
+				back -= 6;
+				out = back;
+			}
+			for (int v = 0; v < 6; ++v)
+				out[v] = (GLuint)(shape * 6 + v);
+		}
+
+		draw->opaque_first = (int)(opaque_start - batch->indices);
+		draw->opaque_count = (int)(front - opaque_start);
+		draw->translucent_first = (int)(back - batch->indices);
+		draw->translucent_count = (int)(translucent_end - back);
+	}
+
+	return (int)(front - batch->indices) / 6;
+}
+
+int odc_shape_batch_get_shape_count(struct shape_batch *batch)
+{
+	return batch->shape_count;
+}
+
+const struct vertex *odc_shape_batch_get_vertices(struct shape_batch *batch)
+{
+	return batch->vertices;
+}
+
+const GLuint *odc_shape_batch_get_indices(struct shape_batch *batch)
+{
+	return batch->indices;
+}
+
+const struct draw_batch *
+odc_shape_batch_get_draw_batches(struct shape_batch *batch, int *count)
+{
+	*count = batch->batch_count;
+	return batch->batches;
+}
+
+void odc_shape_batch_get_frame(struct shape_batch *batch,
+			       struct renderer_frame *frame)
+{
+	memset(frame, 0, sizeof(*frame));
+	frame->vertices = batch->vertices;
+	frame->shape_count = batch->shape_count;
+	frame->batches = batch->batches;
+	frame->batch_count = batch->batch_count;
+}
@@ -0,0 +1,927 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "odc_font.h"
+#include "odc_renderer.h"
+#include "odc_soft_rasterizer.h"
+#include "odc_thread_pool.h"
+
+#define SUBPIXEL_STEPS 256.0f
+
+struct soft_texture {
+	GLuint handle;
+	const unsigned char *pixels;
+	int width;
+	int height;
+	int channels;
+};
+
+struct bin_entry {
+	int shape;
+	const struct soft_texture *texture;
+};
+
+struct tile {
+	struct soft_rasterizer *raster;
+	int x0;
+	int y0;
+	int x1;
+	int y1;
+	struct bin_entry *entries;
+	int count;
+	int capacity;
+};
+
+struct soft_rasterizer {
+	unsigned char *pixels;
+	int width;
+	int height;
+	struct tile *tiles;
+	int tiles_x;
+	int tiles_y;
+	struct thread_pool *pool;
+	struct soft_texture *textures;
+	int texture_count;
+	int texture_capacity;
+	const unsigned char *palettes;
+	int palette_width;
+	int palette_count;
+	soft_rasterizer_sdf_fn custom_shapes[MAX_CUSTOM_SHAPES];
+	struct renderer_frame frame;
+};
+
+// Screen position in pixels, top row first, plus the interpolated local
+// position and texture coordinate
+struct raster_vertex {
+	float x;
+	float y;
+	float attr[4];
+};
+
+struct shade {
+	int op;
+	unsigned char color[4];
+	float radius;
+	float width;
+	float height;
+	const struct soft_texture *texture;
+	soft_rasterizer_sdf_fn sdf;
+};
+
+struct edge {
+	float a;
+	float b;
+	float c;
+	int owns_zero;
+};
+
+static unsigned char to_byte(float value)
+{
+	if (value <= 0.0f)
+		return 0;
+	if (value >= 1.0f)
+		return 255;
+	return (unsigned char)(value * 255.0f + 0.5f);
+}
+
+// Exact x / 255 rounding, matching what GL does for RGBA8 blending up to
+// float precision
+static void blend_pixel(unsigned char *dst, const unsigned char *color)
+{
+	unsigned int alpha = color[3];
+	unsigned int inverse = 255 - alpha;
+	for (int c = 0; c < 4; ++c) {
+		unsigned int x = color[c] * alpha + dst[c] * inverse + 128;
+		dst[c] = (unsigned char)((x + (x >> 8)) >> 8);
+	}
+}
+
+static void store_span(unsigned char *dst, int count,
+		       const unsigned char *color)
+{
+	uint32_t packed;
+	memcpy(&packed, color, 4);
+
+	int i = 0;
+#ifdef __SSE2__
+	__m128i value = _mm_set1_epi32((int)packed);
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_si128((__m128i *)(dst + i * 4), value);
+#endif
+	for (; i < count; ++i)
+		memcpy(dst + i * 4, &packed, 4);
+}
+
+// Blends one color over a run of pixels with SRC_ALPHA, ONE_MINUS_SRC_ALPHA
+static void fill_span(unsigned char *dst, int count,
+		      const unsigned char *color)
+{
+	unsigned int alpha = color[3];
+	if (alpha == 0)
+		return;
+	if (alpha == 255) {
+		store_span(dst, count, color);
+		return;
+	}
+
+	int i = 0;
+#ifdef __SSE2__
+	__m128i zero = _mm_setzero_si128();
+	__m128i inverse = _mm_set1_epi16((short)(255 - alpha));
+	short r = (short)(color[0] * alpha + 128);
+	short g = (short)(color[1] * alpha + 128);
+	short b = (short)(color[2] * alpha + 128);
+	short a = (short)(color[3] * alpha + 128);
+	__m128i source = _mm_setr_epi16(r, g, b, a, r, g, b, a);
+	for (; i + 4 <= count; i += 4) {
+		__m128i pixels = _mm_loadu_si128((__m128i *)(dst + i * 4));
+		__m128i lo = _mm_unpacklo_epi8(pixels, zero);
+		__m128i hi = _mm_unpackhi_epi8(pixels, zero);
+		lo = _mm_add_epi16(_mm_mullo_epi16(lo, inverse), source);
+		hi = _mm_add_epi16(_mm_mullo_epi16(hi, inverse), source);
+		lo = _mm_add_epi16(lo, _mm_srli_epi16(lo, 8));
+		hi = _mm_add_epi16(hi, _mm_srli_epi16(hi, 8));
+		lo = _mm_srli_epi16(lo, 8);
+		hi = _mm_srli_epi16(hi, 8);
+		_mm_storeu_si128((__m128i *)(dst + i * 4),
+				 _mm_packus_epi16(lo, hi));
+	}
+#endif
+	for (; i < count; ++i)
+		blend_pixel(dst + i * 4, color);
+}
+
+static float sd_rounded_rect(float x, float y, float half_width,
+			     float half_height, float radius)
+{
+	float qx = fabsf(x) - (half_width - radius);
+	float qy = fabsf(y) - (half_height - radius);
+	float ox = fmaxf(qx, 0.0f);
+	float oy = fmaxf(qy, 0.0f);
+	return sqrtf(ox * ox + oy * oy) + fminf(fmaxf(qx, qy), 0.0f) - radius;
+}
+
+static float sd_equilateral_triangle(float x, float y)
+{
+	const float k = 1.7320508f;
+	x = fabsf(x) - 0.5f;
+	y = y + 0.5f / k;
+	if (x + k * y > 0.0f) {
+		float nx = (x - k * y) / 2.0f;
+		float ny = (-k * x - y) / 2.0f;
+		x = nx;
+		y = ny;
+	}
+	x -= fminf(fmaxf(x, -1.0f), 0.0f);
+
+	float length = sqrtf(x * x + y * y);
+	if (y > 0.0f)
+		return -length;
+	return y < 0.0f ? length : 0.0f;
+}
+
+static float shape_sdf(const struct shade *shade, float x, float y)
+{
+	switch (shade->op) {
+	case (int)OP_CODE_CIRCLE:
+		return sqrtf(x * x + y * y) - shade->radius;
+	case (int)OP_CODE_ROUNDED_RECT:
+		return sd_rounded_rect(x, y, shade->width * 0.5f,
+				       shade->height * 0.5f, shade->radius);
+	case (int)OP_CODE_EQUILATERAL_TRIANGLE: {
+		float size = fmaxf(shade->width, shade->height);
+		return sd_equilateral_triangle(x / size, y / size);
+	}
+	default:
+		return shade->sdf(x, y, shade->width * 0.5f,
+				  shade->height * 0.5f, shade->radius);
+	}
+}
+
+static int wrap(int value, int size)
+{
+	value %= size;
+	return value < 0 ? value + size : value;
+}
+
+// GL_NEAREST with GL_REPEAT, the renderer's default sampler
+static void fetch_texel(const struct soft_texture *texture, float u, float v,
+			unsigned char *out)
+{
+	int x = wrap((int)floorf(u * texture->width), texture->width);
+	int y = wrap((int)floorf(v * texture->height), texture->height);
+	const unsigned char *texel =
+		texture->pixels +
+		((size_t)y * texture->width + x) * texture->channels;
+
+	if (texture->channels == 1) {
+		out[0] = texel[0];
+		out[1] = 0;
+		out[2] = 0;
+		out[3] = 255;
+		return;
+	}
+	memcpy(out, texel, 4);
+}
+
+static int clamp_index(int value, int size)
+{
+	if (value < 0)
+		return 0;
+	return value >= size ? size - 1 : value;
+}
+
+// GL_LINEAR with GL_CLAMP_TO_EDGE, as the font atlas is set up
+static unsigned char sample_font(const unsigned char *bitmap, float u, float v)
+{
+	float x = u * ATLAS_WIDTH - 0.5f;
+	float y = v * ATLAS_HEIGHT - 0.5f;
+	float fx0 = floorf(x);
+	float fy0 = floorf(y);
+	float fx = x - fx0;
+	float fy = y - fy0;
+	int x0 = clamp_index((int)fx0, ATLAS_WIDTH);
+	int x1 = clamp_index((int)fx0 + 1, ATLAS_WIDTH);
+	int y0 = clamp_index((int)fy0, ATLAS_HEIGHT);
+	int y1 = clamp_index((int)fy0 + 1, ATLAS_HEIGHT);
+
+	float top = bitmap[y0 * ATLAS_WIDTH + x0] * (1.0f - fx) +
+		    bitmap[y0 * ATLAS_WIDTH + x1] * fx;
+	float bottom = bitmap[y1 * ATLAS_WIDTH + x0] * (1.0f - fx) +
+		       bitmap[y1 * ATLAS_WIDTH + x1] * fx;
+	return (unsigned char)(top * (1.0f - fy) + bottom * fy + 0.5f);
+}
+
+// The GL shader's smoothstep over half a pixel's change in distance either
+// side of the edge. texels is how far the span steps through the atlas per
+// pixel.
+static unsigned char sdf_coverage(unsigned char distance, float texels)
+{
+	float edge = 0.5f * texels * 127.5f / (float)FONT_SDF_SPREAD;
+	if (edge <= 0.0f)
+		return distance >= 128 ? 255 : 0;
+	float t = ((float)distance - 127.5f + edge) / (2.0f * edge);
+	if (t <= 0.0f)
+		return 0;
+	if (t >= 1.0f)
+		return 255;
+	return (unsigned char)(t * t * (3.0f - 2.0f * t) * 255.0f + 0.5f);
+}
+
+static void shade_span(struct soft_rasterizer *raster,
+		       const struct shade *shade, int y, int x0, int x1,
+		       const float *attr, const float *step)
+{
+	const struct renderer_frame *frame = &raster->frame;
+	unsigned char *dst =
+		raster->pixels + ((size_t)y * raster->width + x0) * 4;
+	int count = x1 - x0;
+	unsigned char color[4];
+
+	switch (shade->op) {
+	case (int)OP_CODE_TRIANGLE:
+		fill_span(dst, count, shade->color);
+		return;
+	case (int)OP_CODE_TEXT: {
+		float texels = fabsf(step[2]) * ATLAS_WIDTH +
+			       fabsf(step[3]) * ATLAS_HEIGHT;
+		memcpy(color, shade->color, 3);
+		for (int i = 0; i < count; ++i) {
+			color[3] = sample_font(frame->font_bitmap,
+					       attr[2] + step[2] * i,
+					       attr[3] + step[3] * i);
+			if (frame->font_sdf)
+				color[3] = sdf_coverage(color[3], texels);
+			if (color[3])
+				blend_pixel(dst + i * 4, color);
+		}
+		return;
+	}
+	case (int)OP_CODE_TEXTURE:
+	case (int)OP_CODE_ANIMATED_SPRITE:
+		for (int i = 0; i < count; ++i) {
+			fetch_texel(shade->texture, attr[2] + step[2] * i,
+				    attr[3] + step[3] * i, color);
+			if (color[3])
+				blend_pixel(dst + i * 4, color);
+		}
+		return;
+	case (int)OP_CODE_INDEXED_TEXTURE: {
+		int row = clamp_index((int)(shade->radius + 0.5f),
+				      raster->palette_count);
+		const unsigned char *palette =
+			raster->palettes +
+			(size_t)row * raster->palette_width * 4;
+		for (int i = 0; i < count; ++i) {
+			fetch_texel(shade->texture, attr[2] + step[2] * i,
+				    attr[3] + step[3] * i, color);
+			int index =
+				clamp_index(color[0], raster->palette_width);
+			const unsigned char *entry = palette + index * 4;
+			if (entry[3])
+				blend_pixel(dst + i * 4, entry);
+		}
+		return;
+	}
+	}
+
+	// Everything else is a solid color inside an SDF, so the inside runs
+	// go to the span filler
+	int run = -1;
+	for (int i = 0; i < count; ++i) {
+		int inside = shape_sdf(shade, attr[0] + step[0] * i,
+				       attr[1] + step[1] * i) < 0.0f;
+		if (inside && run < 0) {
+			run = i;
+		} else if (!inside && run >= 0) {
+			fill_span(dst + run * 4, i - run, shade->color);
+			run = -1;
+		}
+	}
+	if (run >= 0)
+		fill_span(dst + run * 4, count - run, shade->color);
+}
+
+// Edges are evaluated the same way for both triangles of a quad, so the
+// shared diagonal gives exactly negated values and the top-left style tie
+// rule hands each pixel on it to one triangle only
+static int covers(const struct edge *edges, const float *rows, float x)
+{
+	for (int i = 0; i < 3; ++i) {
+		float e = edges[i].a * x + rows[i];
+		if (e < 0.0f || (e == 0.0f && !edges[i].owns_zero))
+			return 0;
+	}
+	return 1;
+}
+
+static void draw_triangle(struct soft_rasterizer *raster,
+			  const struct tile *tile,
+			  const struct raster_vertex *v0,
+			  const struct raster_vertex *v1,
+			  const struct raster_vertex *v2,
+			  const struct shade *shade)
+{
+	const struct raster_vertex *v[3] = {v0, v1, v2};
+	float cross = (v1->x - v0->x) * (v2->y - v0->y) -
+		      (v2->x - v0->x) * (v1->y - v0->y);
+	if (cross == 0.0f || isnan(cross))
+		return;
+
+	struct edge edges[3];
+	for (int i = 0; i < 3; ++i) {
+		const struct raster_vertex *p = v[(i + 1) % 3];
+		const struct raster_vertex *q = v[(i + 2) % 3];
+		float sign = cross > 0.0f ? 1.0f : -1.0f;
+		edges[i].a = sign * (p->y - q->y);
+		edges[i].b = sign * (q->x - p->x);
+		edges[i].c = sign * (p->x * q->y - q->x * p->y);
+		edges[i].owns_zero =
+			edges[i].a > 0.0f ||
+			(edges[i].a == 0.0f && edges[i].b > 0.0f);
+	}
+
+	float dx[4], dy[4];
+	for (int i = 0; i < 4; ++i) {
+		float d1 = v1->attr[i] - v0->attr[i];
+		float d2 = v2->attr[i] - v0->attr[i];
+		dx[i] = (d1 * (v2->y - v0->y) - d2 * (v1->y - v0->y)) / cross;
+		dy[i] = (d2 * (v1->x - v0->x) - d1 * (v2->x - v0->x)) / cross;
+	}
+
+	float min_x = fminf(v0->x, fminf(v1->x, v2->x));
+	float max_x = fmaxf(v0->x, fmaxf(v1->x, v2->x));
+	float min_y = fminf(v0->y, fminf(v1->y, v2->y));
+	float max_y = fmaxf(v0->y, fmaxf(v1->y, v2->y));
+
+	// Pixel centers sit at +0.5
+	int bx0 = tile->x0, bx1 = tile->x1;
+	int y0 = tile->y0, y1 = tile->y1;
+	if (min_x - 0.5f > bx0)
+		bx0 = (int)ceilf(min_x - 0.5f);
+	if (max_x - 0.5f < bx1 - 1)
+		bx1 = (int)floorf(max_x - 0.5f) + 1;
+	if (min_y - 0.5f > y0)
+		y0 = (int)ceilf(min_y - 0.5f);
+	if (max_y - 0.5f < y1 - 1)
+		y1 = (int)floorf(max_y - 0.5f) + 1;
+
+	for (int y = y0; y < y1; ++y) {
+		float yc = (float)y + 0.5f;
+		float rows[3];
+		float left = (float)bx0 + 0.5f;
+		float right = (float)bx1 - 0.5f;
+		int empty = 0;
+
+		for (int i = 0; i < 3; ++i) {
+			rows[i] = edges[i].b * yc + edges[i].c;
+			if (edges[i].a > 0.0f)
+				left = fmaxf(left, -rows[i] / edges[i].a);
+			else if (edges[i].a < 0.0f)
+				right = fminf(right, -rows[i] / edges[i].a);
+			else if (rows[i] < 0.0f ||
+				 (rows[i] == 0.0f && !edges[i].owns_zero))
+				empty = 1;
+		}
+		if (empty || left > right + 1.0f)
+			continue;
+
+		// The solved span is only close; the exact edge test decides
+		// the pixels at either end
+		int sx = (int)ceilf(left - 0.5f);
+		int ex = (int)floorf(right - 0.5f) + 1;
+		if (sx < bx0)
+			sx = bx0;
+		if (ex > bx1)
+			ex = bx1;
+		if (ex < sx)
+			ex = sx;
+		while (sx < ex && !covers(edges, rows, sx + 0.5f))
+			sx++;
+		while (ex > sx && !covers(edges, rows, ex - 0.5f))
+			ex--;
+		while (sx > bx0 && covers(edges, rows, sx - 0.5f))
+			sx--;
+		while (ex < bx1 && covers(edges, rows, ex + 0.5f))
+			ex++;
+		if (sx >= ex)
+			continue;
+
+		float attr[4];
+		for (int i = 0; i < 4; ++i)
+			attr[i] = v0->attr[i] + (sx + 0.5f - v0->x) * dx[i] +
+				  (yc - v0->y) * dy[i];
+		shade_span(raster, shade, y, sx, ex, attr, dx);
+	}
+}
+
+// The vertex shader's frame selection for animated sprites
+static void animate_tex_coord(const struct renderer_frame *frame,
+			      const struct vertex *v, float *tex_coord)
+{
+	int id = (int)(v->anim[0] + 0.5f);
+	const float *rect = frame->animation_frames[id];
+	const float *params = frame->animation_params[id];
+	float count = params[1];
+	float index = floorf(fmaxf(frame->time - v->anim[1], 0.0f) * params[2]);
+
+	if (params[3] == 0.0f) {
+		index = fminf(index, count - 1.0f);
+	} else if (params[3] == 1.0f) {
+		index = fmodf(index, count);
+	} else {
+		float period = fmaxf(2.0f * count - 2.0f, 1.0f);
+		index = fmodf(index, period);
+		if (index >= count)
+			index = period - index;
+	}
+
+	float cell_x = fmodf(index, params[0]);
+	float cell_y = floorf(index / params[0]);
+	tex_coord[0] = rect[0] + (cell_x + v->tex_coord[0]) * rect[2];
+	tex_coord[1] = rect[1] + (cell_y + v->tex_coord[1]) * rect[3];
+}
+
+static void shape_vertices(const struct soft_rasterizer *raster,
+			   const struct vertex *v, int op,
+			   struct raster_vertex *out)
+{
+	for (int i = 0; i < 6; ++i) {
+		float x, y;
+		if (op == (int)OP_CODE_TRIANGLE || op == (int)OP_CODE_TEXT) {
+			x = v[i].fs_quad_pos[0];
+			y = v[i].fs_quad_pos[1];
+		} else {
+			x = v[i].shape_pos[0] +
+			    v[i].local_pos[0] / v[i].resolution[0] * 2.0f;
+			y = v[i].shape_pos[1] +
+			    v[i].local_pos[1] / v[i].resolution[1] * 2.0f;
+		}
+
+		// Snap to the 1/256 pixel grid GL rasterizers use, so edges
+		// that pass through pixel centers resolve the same way
+		out[i].x = roundf((x + 1.0f) * 0.5f * raster->width *
+				  SUBPIXEL_STEPS) /
+			   SUBPIXEL_STEPS;
+		out[i].y = roundf((1.0f - y) * 0.5f * raster->height *
+				  SUBPIXEL_STEPS) /
+			   SUBPIXEL_STEPS;
+		out[i].attr[0] = v[i].local_pos[0];
+		out[i].attr[1] = v[i].local_pos[1];
+		if (op == (int)OP_CODE_ANIMATED_SPRITE) {
+			animate_tex_coord(&raster->frame, &v[i],
+					  &out[i].attr[2]);
+		} else {
+			out[i].attr[2] = v[i].tex_coord[0];
+			out[i].attr[3] = v[i].tex_coord[1];
+		}
+	}
+}
+
+// Fills in how a shape is shaded, or returns -1 when it draws nothing or
+// needs data the rasterizer doesn't have
+static int prepare_shade(const struct soft_rasterizer *raster,
+			 const struct vertex *v,
+			 const struct soft_texture *texture,
+			 struct shade *shade)
+{
+	const struct renderer_frame *frame = &raster->frame;
+	int op = (int)(v->op_code + 0.5f);
+
+	shade->op = op;
+	shade->radius = v->radius;
+	shade->width = v->width;
+	shade->height = v->height;
+	shade->texture = texture;
+	shade->sdf = NULL;
+	for (int i = 0; i < 4; ++i)
+		shade->color[i] = to_byte(v->color[i]);
+
+	switch (op) {
+	case (int)OP_CODE_CIRCLE:
+	case (int)OP_CODE_ROUNDED_RECT:
+	case (int)OP_CODE_EQUILATERAL_TRIANGLE:
+	case (int)OP_CODE_TRIANGLE:
+		return shade->color[3] ? 0 : -1;
+	case (int)OP_CODE_TEXT:
+		return frame->font_bitmap ? 0 : -1;
+	case (int)OP_CODE_TEXTURE:
+		return texture ? 0 : -1;
+	case (int)OP_CODE_ANIMATED_SPRITE: {
+		int id = (int)(v->anim[0] + 0.5f);
+		return texture && id >= 0 && id < frame->animation_count ? 0
+									  : -1;
+	}
+	case (int)OP_CODE_INDEXED_TEXTURE:
+		return texture && raster->palettes ? 0 : -1;
+	}
+
+	int custom = op - (int)OP_CODE_CUSTOM_BASE;
+	if (custom < 0 || custom >= MAX_CUSTOM_SHAPES ||
+	    !raster->custom_shapes[custom] || !shade->color[3])
+		return -1;
+	shade->sdf = raster->custom_shapes[custom];
+	return 0;
+}
+
+static void draw_tile(void *arg)
+{
+	struct tile *tile = (struct tile *)arg;
+	struct soft_rasterizer *raster = tile->raster;
+	struct raster_vertex corners[6];
+	struct shade shade;
+
+	for (int i = 0; i < tile->count; ++i) {
+		const struct bin_entry *entry = &tile->entries[i];
+		const struct vertex *v =
+			&raster->frame.vertices[entry->shape * 6];
+		if (prepare_shade(raster, v, entry->texture, &shade) != 0)
+			continue;
+
+		shape_vertices(raster, v, shade.op, corners);
+		draw_triangle(raster, tile, &corners[0], &corners[1],
+			      &corners[2], &shade);
+		draw_triangle(raster, tile, &corners[3], &corners[4],
+			      &corners[5], &shade);
+	}
+}
+
+static const struct soft_texture *find_texture(struct soft_rasterizer *raster,
+					       GLuint handle)
+{
+	for (int i = 0; i < raster->texture_count; ++i) {
+		if (raster->textures[i].handle == handle)
+			return &raster->textures[i];
+	}
+	return NULL;
+}
+
+static int bin_append(struct tile *tile, int shape,
+		      const struct soft_texture *texture)
+{
+	if (tile->count == tile->capacity) {
+		int capacity = tile->capacity ? tile->capacity * 2 : 64;
+		struct bin_entry *entries = (struct bin_entry *)realloc(
+			tile->entries, capacity * sizeof(*entries));
+		if (!entries)
+			return -1;
+		tile->entries = entries;
+		tile->capacity = capacity;
+	}
+
+	tile->entries[tile->count].shape = shape;
+	tile->entries[tile->count].texture = texture;
+	tile->count++;
+	return 0;
+}
+
+static int bin_shapes(struct soft_rasterizer *raster)
+{
+	const struct renderer_frame *frame = &raster->frame;
+	int tile_count = raster->tiles_x * raster->tiles_y;
+	for (int i = 0; i < tile_count; ++i)
+		raster->tiles[i].count = 0;
+
+	int batch = 0;
+	const struct soft_texture *texture =
+		frame->batch_count > 0
+			? find_texture(raster, frame->batches[0].texture)
+			: NULL;
+	struct raster_vertex corners[6];
+	struct shade shade;
+
+	for (int shape = 0; shape < frame->shape_count; ++shape) {
+		while (batch + 1 < frame->batch_count &&
+		       frame->batches[batch + 1].first_shape <= shape) {
+			batch++;
+			texture = find_texture(raster,
+					       frame->batches[batch].texture);
+		}
+
+		const struct vertex *v = &frame->vertices[shape * 6];
+		if (prepare_shade(raster, v, texture, &shade) != 0)
+			continue;
+		shape_vertices(raster, v, shade.op, corners);
+
+		float min_x = corners[0].x, max_x = corners[0].x;
+		float min_y = corners[0].y, max_y = corners[0].y;
+		for (int i = 1; i < 6; ++i) {
+			min_x = fminf(min_x, corners[i].x);
+			max_x = fmaxf(max_x, corners[i].x);
+			min_y = fminf(min_y, corners[i].y);
+			max_y = fmaxf(max_y, corners[i].y);
+		}
+
+		// Clamp before converting so far off-screen shapes can't
+		// overflow the int conversion
+		int x0 = (int)ceilf(fmaxf(min_x, -1.0f) - 0.5f);
+		int x1 = (int)floorf(fminf(max_x, raster->width + 1.0f) - 0.5f);
+		int y0 = (int)ceilf(fmaxf(min_y, -1.0f) - 0.5f);
+		int y1 =
+			(int)floorf(fminf(max_y, raster->height + 1.0f) - 0.5f);
+		if (x0 < 0)
+			x0 = 0;
+		if (y0 < 0)
+			y0 = 0;
+		if (x1 >= raster->width)
+			x1 = raster->width - 1;
+		if (y1 >= raster->height)
+			y1 = raster->height - 1;
+		if (x0 > x1 || y0 > y1)
+			continue;
+
+		for (int ty = y0 / SOFT_RASTER_TILE_SIZE;
+		     ty <= y1 / SOFT_RASTER_TILE_SIZE; ++ty) {
+			for (int tx = x0 / SOFT_RASTER_TILE_SIZE;
+			     tx <= x1 / SOFT_RASTER_TILE_SIZE; ++tx) {
+				struct tile *tile =
+					&raster->tiles[ty * raster->tiles_x +
+						       tx];
+				if (bin_append(tile, shape, texture) != 0) {
+					fprintf(stderr,
+						"ERROR::SOFT_RASTERIZER: "
+						"Failed to grow tile bin\n");
+					return -1;
+				}
+			}
+		}
+	}
+
+	return 0;
+}
+
+static void release_tiles(struct soft_rasterizer *raster)
+{
+	for (int i = 0; i < raster->tiles_x * raster->tiles_y; ++i)
+		free(raster->tiles[i].entries);
+	free(raster->tiles);
+	raster->tiles = NULL;
+	raster->tiles_x = 0;
+	raster->tiles_y = 0;
+}
+
+struct soft_rasterizer *odc_soft_rasterizer_new(int width, int height,
+						int thread_count)
+{
+	struct soft_rasterizer *raster =
+		(struct soft_rasterizer *)calloc(1, sizeof(*raster));
+	if (!raster) {
+		fprintf(stderr, "ERROR::SOFT_RASTERIZER: Failed to allocate "
+				"rasterizer\n");
+		return NULL;
+	}
+
+	if (odc_soft_rasterizer_resize(raster, width, height) != 0) {
+		odc_soft_rasterizer_destroy(raster);
+		return NULL;
+	}
+
+	// Without a pool, tiles are drawn on the calling thread
+	if (thread_count != 1)
+		raster->pool = odc_thread_pool_new(thread_count);
+
+	return raster;
+}
+
+void odc_soft_rasterizer_destroy(struct soft_rasterizer *raster)
+{
+	if (!raster)
+		return;
+
+	odc_thread_pool_destroy(raster->pool);
+	release_tiles(raster);
+	free(raster->textures);
+	free(raster->pixels);
+	free(raster);
+}
+
+int odc_soft_rasterizer_resize(struct soft_rasterizer *raster, int width,
+			       int height)
+{
+	if (width <= 0 || height <= 0) {
+		fprintf(stderr, "ERROR::SOFT_RASTERIZER: Invalid size %dx%d\n",
+			width, height);
+		return -1;
+	}
+
+	int tiles_x = (width + SOFT_RASTER_TILE_SIZE - 1) /
+		      SOFT_RASTER_TILE_SIZE;
+	int tiles_y = (height + SOFT_RASTER_TILE_SIZE - 1) /
+		      SOFT_RASTER_TILE_SIZE;
+	unsigned char *pixels =
+		(unsigned char *)calloc((size_t)width * height, 4);
+	struct tile *tiles = (struct tile *)calloc((size_t)tiles_x * tiles_y,
+						   sizeof(*tiles));
+	if (!pixels || !tiles) {
+		fprintf(stderr,
+			"ERROR::SOFT_RASTERIZER: Failed to allocate %dx%d "
+			"target\n",
+			width, height);
+		free(pixels);
+		free(tiles);
+		return -1;
+	}
+
+	release_tiles(raster);
+	free(raster->pixels);
+	raster->pixels = pixels;
+	raster->width = width;
+	raster->height = height;
+	raster->tiles = tiles;
+	raster->tiles_x = tiles_x;
+	raster->tiles_y = tiles_y;
+
+	for (int ty = 0; ty < tiles_y; ++ty) {
+		for (int tx = 0; tx < tiles_x; ++tx) {
+			struct tile *tile = &tiles[ty * tiles_x + tx];
+			tile->raster = raster;
+			tile->x0 = tx * SOFT_RASTER_TILE_SIZE;
+			tile->y0 = ty * SOFT_RASTER_TILE_SIZE;
+			tile->x1 = tile->x0 + SOFT_RASTER_TILE_SIZE;
+			tile->y1 = tile->y0 + SOFT_RASTER_TILE_SIZE;
+			if (tile->x1 > width)
+				tile->x1 = width;
+			if (tile->y1 > height)
+				tile->y1 = height;
+		}
+	}
+
+	return 0;
+}
+
+int odc_soft_rasterizer_set_texture(struct soft_rasterizer *raster,
+				    GLuint texture_handle,
+				    const unsigned char *pixels, int width,
+				    int height, int channels)
+{
+	struct soft_texture *texture =
+		(struct soft_texture *)find_texture(raster, texture_handle);
+
+	if (!pixels) {
+		if (texture)
+			*texture = raster->textures[--raster->texture_count];
+		return 0;
+	}
+
+	if (width <= 0 || height <= 0 || (channels != 1 && channels != 4)) {
+		fprintf(stderr,
+			"ERROR::SOFT_RASTERIZER: Unsupported texture %dx%d "
+			"with %d channels\n",
+			width, height, channels);
+		return -1;
+	}
+
+	if (!texture) {
+		if (raster->texture_count == raster->texture_capacity) {
+			int capacity = raster->texture_capacity
+					       ? raster->texture_capacity * 2
+					       : 16;
+			struct soft_texture *textures =
+				(struct soft_texture *)realloc(
+					raster->textures,
+					capacity * sizeof(*textures));
+			if (!textures) {
+				fprintf(stderr,
+					"ERROR::SOFT_RASTERIZER: Failed to "
+					"grow texture table\n");
+				return -1;
+			}
+			raster->textures = textures;
+			raster->texture_capacity = capacity;
+		}
+		texture = &raster->textures[raster->texture_count++];
+	}
+
+	texture->handle = texture_handle;
+	texture->pixels = pixels;
+	texture->width = width;
+	texture->height = height;
+	texture->channels = channels;
+	return 0;
+}
+
+void odc_soft_rasterizer_set_palettes(struct soft_rasterizer *raster,
+				      const unsigned char *colors,
+				      int colors_per_palette, int palette_count)
+{
+	if (!colors || colors_per_palette <= 0 || palette_count <= 0) {
+		raster->palettes = NULL;
+		return;
+	}
+
+	raster->palettes = colors;
+	raster->palette_width = colors_per_palette;
+	raster->palette_count = palette_count;
+}
+
+int odc_soft_rasterizer_set_custom_shape(struct soft_rasterizer *raster,
+					 int shape, soft_rasterizer_sdf_fn sdf)
+{
+	if (shape < 0 || shape >= MAX_CUSTOM_SHAPES) {
+		fprintf(stderr, "ERROR::SOFT_RASTERIZER: Invalid shape %d\n",
+			shape);
+		return -1;
+	}
+
+	raster->custom_shapes[shape] = sdf;
+	return 0;
+}
+
+void odc_soft_rasterizer_clear(struct soft_rasterizer *raster, float r,
+			       float g, float b, float a)
+{
+	unsigned char color[4] = {to_byte(r), to_byte(g), to_byte(b),
+				  to_byte(a)};
+	store_span(raster->pixels, raster->width * raster->height, color);
+}
+
+int odc_soft_rasterizer_draw(struct soft_rasterizer *raster,
+			     struct renderer *renderer)
+{
+	struct renderer_frame frame;
+	odc_renderer_get_frame(renderer, &frame);
+	return odc_soft_rasterizer_draw_frame(raster, &frame);
+}
+
+int odc_soft_rasterizer_draw_frame(struct soft_rasterizer *raster,
+				   const struct renderer_frame *frame)
+{
+	raster->frame = *frame;
+	if (bin_shapes(raster) != 0)
+		return -1;
+
+	// Tiles own disjoint pixels, so they need no locking
+	int tile_count = raster->tiles_x * raster->tiles_y;
+	for (int i = 0; i < tile_count; ++i) {
+		struct tile *tile = &raster->tiles[i];
+		if (!tile->count)
+			continue;
+		if (!raster->pool ||
+		    odc_thread_pool_submit(raster->pool, draw_tile, tile) != 0)
+			draw_tile(tile);
+	}
+
+	if (raster->pool)
+		odc_thread_pool_wait(raster->pool);
+	return 0;
+}
+
+const unsigned char *
+odc_soft_rasterizer_get_pixels(struct soft_rasterizer *raster)
+{
+	return raster->pixels;
+}
+
+void odc_soft_rasterizer_get_size(struct soft_rasterizer *raster, int *width,
+				  int *height)
+{
+	*width = raster->width;
+	*height = raster->height;
+}
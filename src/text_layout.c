@@ -0,0 +1,338 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "odc_cache.h"
+#include "odc_font.h"
+#include "odc_text_layout.h"
+
+struct layout_entry {
+	uint64_t hash;
+	char *text;
+	size_t text_capacity;
+	const struct font *font;
+	float scale;
+	int multiline;
+	// The font's generation when laid out, and the atlas pages used
+	unsigned int generation;
+	unsigned int page_mask;
+	int dropped_glyphs;
+	struct text_layout layout;
+	struct text_layout_glyph *glyphs;
+	int glyph_capacity;
+	int bucket_next;
+	int lru_prev;
+	int lru_next;
+};
+
+struct text_layout_cache {
+	struct layout_entry *entries;
+	int capacity;
+	int count;
+	int *buckets;
+	int bucket_mask;
+	// Most recently used first
+	int lru_head;
+	int lru_tail;
+	int hits;
+	int misses;
+};
+
+struct text_layout_cache *odc_text_layout_cache_new(int capacity)
+{
+	if (capacity <= 0)
+		capacity = TEXT_LAYOUT_CACHE_DEFAULT_ENTRIES;
+
+	struct text_layout_cache *cache =
+		(struct text_layout_cache *)calloc(1, sizeof(*cache));
+	if (!cache) {
+		fprintf(stderr, "ERROR::TEXT_LAYOUT: Failed to allocate "
+				"layout cache\n");
+		return NULL;
+	}
+
+	int bucket_count = 1;
+	while (bucket_count < capacity * 2)
+		bucket_count <<= 1;
+
+	cache->entries = (struct layout_entry *)calloc(
+		capacity, sizeof(struct layout_entry));
+	cache->buckets = (int *)malloc(sizeof(int) * bucket_count);
+	if (!cache->entries || !cache->buckets) {
+		fprintf(stderr, "ERROR::TEXT_LAYOUT: Failed to allocate "
+				"layout cache\n");
+		free(cache->entries);
+		free(cache->buckets);
+		free(cache);
+		return NULL;
+	}
+
+	cache->capacity = capacity;
+	cache->bucket_mask = bucket_count - 1;
+	odc_text_layout_cache_clear(cache);
+	return cache;
+}
+
+void odc_text_layout_cache_destroy(struct text_layout_cache *cache)
+{
+	if (!cache)
+		return;
+
+	for (int i = 0; i < cache->capacity; ++i) {
+		free(cache->entries[i].text);
+		free(cache->entries[i].glyphs);
+	}
+	free(cache->entries);
+	free(cache->buckets);
+	free(cache);
+}
+
+void odc_text_layout_cache_clear(struct text_layout_cache *cache)
+{
+	// Entries keep their buffers for reuse
+	for (int i = 0; i <= cache->bucket_mask; ++i)
+		cache->buckets[i] = -1;
+	cache->count = 0;
+	cache->lru_head = -1;
+	cache->lru_tail = -1;
+}
+
+static uint64_t hash_key(const struct font *font, const char *text,
+			 float scale, int multiline)
+{
+	uint64_t hash = odc_cache_hash_string(CACHE_HASH_SEED, text);
+	hash = odc_cache_hash(hash, &font, sizeof(font));
+	hash = odc_cache_hash(hash, &scale, sizeof(scale));
+	return odc_cache_hash(hash, &multiline, sizeof(multiline));
+}
+
+static void lru_unlink(struct text_layout_cache *cache, int index)
+{
+	struct layout_entry *entry = &cache->entries[index];
+	if (entry->lru_prev >= 0)
+		cache->entries[entry->lru_prev].lru_next = entry->lru_next;
+	else
+		cache->lru_head = entry->lru_next;
+	if (entry->lru_next >= 0)
+		cache->entries[entry->lru_next].lru_prev = entry->lru_prev;
+	else
+		cache->lru_tail = entry->lru_prev;
+}
+
+static void lru_push_front(struct text_layout_cache *cache, int index)
+{
+	struct layout_entry *entry = &cache->entries[index];
+	entry->lru_prev = -1;
+	entry->lru_next = cache->lru_head;
+	if (cache->lru_head >= 0)
+		cache->entries[cache->lru_head].lru_prev = index;
+	cache->lru_head = index;
+	if (cache->lru_tail < 0)
+		cache->lru_tail = index;
+}
+
+static void bucket_remove(struct text_layout_cache *cache, int index)
+{
+	int *link = &cache->buckets[cache->entries[index].hash &
+				    cache->bucket_mask];
+	while (*link != index)
+		link = &cache->entries[*link].bucket_next;
+	*link = cache->entries[index].bucket_next;
+}
+
+static int find_entry(struct text_layout_cache *cache, uint64_t hash,
+		      const struct font *font, const char *text, float scale,
+		      int multiline)
+{
+	int index = cache->buckets[hash & cache->bucket_mask];
+	while (index >= 0) {
+		struct layout_entry *entry = &cache->entries[index];
+		if (entry->hash == hash && entry->font == font &&
+		    entry->scale == scale && entry->multiline == multiline &&
+		    strcmp(entry->text, text) == 0)
+			return index;
+		index = entry->bucket_next;
+	}
+	return -1;
+}
+
+static int reserve_entry(struct layout_entry *entry, size_t length)
+{
+	if (length + 1 > entry->text_capacity) {
+		char *text = (char *)realloc(entry->text, length + 1);
+		if (!text)
+			return -1;
+		entry->text = text;
+		entry->text_capacity = length + 1;
+	}
+
+	// Every byte is at most one glyph
+	if ((int)length > entry->glyph_capacity) {
+		struct text_layout_glyph *glyphs =
+			(struct text_layout_glyph *)realloc(
+				entry->glyphs,
+				sizeof(struct text_layout_glyph) * length);
+		if (!glyphs)
+			return -1;
+		entry->glyphs = glyphs;
+		entry->glyph_capacity = (int)length;
+	}
+
+	return 0;
+}
+
+static void build_layout(struct layout_entry *entry, struct font *font,
+			 const char *text, float scale, int multiline)
+{
+	struct text_layout *layout = &entry->layout;
+	float ascent = (float)font->ascender * scale;
+	float line_spacing =
+		(float)(font->ascender - font->descender + font->line_gap) *
+		scale;
+	int pixel_size = odc_font_get_pixel_size(font, scale);
+	float pen_x = 0.0f;
+	float top = 0.0f;
+
+	memset(layout, 0, sizeof(*layout));
+	layout->line_count = 1;
+	entry->page_mask = 0;
+	entry->dropped_glyphs = 0;
+
+	for (;;) {
+		uint32_t c = odc_font_next_codepoint(&text);
+		if (c == 0)
+			break;
+		if (c == '\n' && multiline) {
+			if (pen_x > layout->width)
+				layout->width = pen_x;
+			pen_x = 0.0f;
+			top += line_spacing;
+			layout->line_count++;
+			continue;
+		}
+		if (c < 32)
+			continue;
+
+		int glyph_size;
+		const struct glyph *g = odc_font_get_nearest_glyph(
+			font, c, pixel_size, &glyph_size);
+		// A glyph that fell back to the base size is laid out again
+		// once there may be room for it at this one
+		if (glyph_size != pixel_size || !g)
+			entry->dropped_glyphs = font->face != NULL;
+		if (!g)
+			continue;
+
+		// Glyphs rendered at another pixel size are stretched to this
+		// one
+		float glyph_scale =
+			(float)FONT_BASE_SIZE * scale / (float)glyph_size;
+		float x0 = pen_x + (float)g->bearing_x * glyph_scale;
+		float y0 = top + ascent - (float)g->bearing_y * glyph_scale;
+		pen_x += (float)g->advance * glyph_scale;
+
+		// Spaces only move the pen
+		if (g->width == 0 || g->height == 0)
+			continue;
+
+		struct text_layout_glyph *quad =
+			&entry->glyphs[layout->glyph_count];
+		quad->x0 = x0;
+		quad->y0 = y0;
+		quad->x1 = x0 + (float)g->width * glyph_scale;
+		quad->y1 = y0 + (float)g->height * glyph_scale;
+		quad->u0 = g->tex_offset_x;
+		quad->v0 = g->tex_offset_y;
+		quad->u1 = g->tex_offset_x + (float)g->width / ATLAS_WIDTH;
+		quad->v1 = g->tex_offset_y + (float)g->height / ATLAS_HEIGHT;
+		entry->page_mask |=
+			1u << (int)(g->tex_offset_y * FONT_ATLAS_PAGES);
+
+		if (layout->glyph_count == 0 || quad->x0 < layout->min_x)
+			layout->min_x = quad->x0;
+		if (layout->glyph_count == 0 || quad->y0 < layout->min_y)
+			layout->min_y = quad->y0;
+		if (layout->glyph_count == 0 || quad->x1 > layout->max_x)
+			layout->max_x = quad->x1;
+		if (layout->glyph_count == 0 || quad->y1 > layout->max_y)
+			layout->max_y = quad->y1;
+		layout->glyph_count++;
+	}
+
+	if (pen_x > layout->width)
+		layout->width = pen_x;
+	layout->height = (float)layout->line_count * line_spacing;
+	layout->glyphs = entry->glyphs;
+	entry->generation = font->generation;
+}
+
+const struct text_layout *
+odc_text_layout_cache_get(struct text_layout_cache *cache, struct font *font,
+			  const char *text, float scale, int multiline)
+{
+	if (!text)
+		return NULL;
+
+	multiline = multiline != 0;
+	uint64_t hash = hash_key(font, text, scale, multiline);
+	int index = find_entry(cache, hash, font, text, scale, multiline);
+	if (index >= 0) {
+		struct layout_entry *entry = &cache->entries[index];
+		if (cache->lru_head != index) {
+			lru_unlink(cache, index);
+			lru_push_front(cache, index);
+		}
+		// Lay out again if glyphs it used were evicted from the atlas
+		// since, or ones the full atlas had no room for may fit now
+		if (!entry->dropped_glyphs &&
+		    odc_font_touch_pages(font, entry->page_mask,
+					 entry->generation)) {
+			cache->hits++;
+		} else {
+			cache->misses++;
+			build_layout(entry, font, text, scale, multiline);
+		}
+		return &entry->layout;
+	}
+
+	cache->misses++;
+	index = cache->count < cache->capacity ? cache->count
+					       : cache->lru_tail;
+	struct layout_entry *entry = &cache->entries[index];
+	size_t length = strlen(text);
+	// realloc keeps the old contents on failure, so the entry being
+	// replaced stays intact until this succeeds
+	if (reserve_entry(entry, length) != 0) {
+		fprintf(stderr,
+			"ERROR::TEXT_LAYOUT: Failed to allocate text layout\n");
+		return NULL;
+	}
+
+	if (cache->count < cache->capacity) {
+		cache->count++;
+	} else {
+		lru_unlink(cache, index);
+		bucket_remove(cache, index);
+	}
+
+	memcpy(entry->text, text, length + 1);
+	entry->hash = hash;
+	entry->font = font;
+	entry->scale = scale;
+	entry->multiline = multiline;
+	build_layout(entry, font, text, scale, multiline);
+
+	int *bucket = &cache->buckets[hash & cache->bucket_mask];
+	entry->bucket_next = *bucket;
+	*bucket = index;
+	lru_push_front(cache, index);
+	return &entry->layout;
+}
+
+void odc_text_layout_cache_get_stats(struct text_layout_cache *cache,
+				     int *hits, int *misses)
+{
+	*hits = cache->hits;
+	*misses = cache->misses;
+}
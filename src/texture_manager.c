@@ -0,0 +1,425 @@
+#include "glad.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "odc_gl_state.h"
+#include "odc_image.h"
+#include "odc_texture_manager.h"
+
+struct texture_manager {
+	struct managed_texture **textures;
+	int count;
+	int capacity;
+	// Maps a GL texture name to its index in textures, offset by one
+	int *slots;
+	GLuint slot_capacity;
+	size_t budget;
+	size_t usage;
+	unsigned long frame;
+};
+
+static int mip_level_count(int width, int height)
+{
+	int levels = 1;
+	int size = width > height ? width : height;
+	while (size > 1) {
+		size >>= 1;
+		levels++;
+	}
+	return levels;
+}
+
+static size_t texture_bytes(int width, int height, int bytes_per_pixel,
+			    int has_mipmaps)
+{
+	size_t bytes = (size_t)width * height * bytes_per_pixel;
+	// A full mip chain adds a third on top of the base level
+	return has_mipmaps ? bytes + bytes / 3 : bytes;
+}
+
+static int set_slot(struct texture_manager *manager, GLuint id, int slot)
+{
+	if (id >= manager->slot_capacity) {
+		GLuint capacity = manager->slot_capacity ? manager->slot_capacity
+							 : 64;
+		while (capacity <= id)
+			capacity *= 2;
+
+		int *slots = (int *)realloc(manager->slots,
+					    capacity * sizeof(int));
+		if (!slots)
+			return -1;
+		memset(slots + manager->slot_capacity, 0,
+		       (capacity - manager->slot_capacity) * sizeof(int));
+		manager->slots = slots;
+		manager->slot_capacity = capacity;
+	}
+
+	manager->slots[id] = slot;
+	return 0;
+}
+
+static struct managed_texture *insert(struct texture_manager *manager,
+				      GLuint id)
+{
+	if (manager->count == manager->capacity) {
+		int capacity = manager->capacity ? manager->capacity * 2 : 64;
+		struct managed_texture **textures =
+			(struct managed_texture **)realloc(
+				manager->textures,
+				capacity * sizeof(struct managed_texture *));
+		if (!textures)
+			return NULL;
+		manager->textures = textures;
+		manager->capacity = capacity;
+	}
+
+	struct managed_texture *texture =
+		(struct managed_texture *)calloc(1, sizeof(*texture));
+	if (!texture)
+		return NULL;
+
+	if (set_slot(manager, id, manager->count + 1) != 0) {
+		free(texture);
+		return NULL;
+	}
+
+	texture->id = id;
+	texture->last_used = manager->frame;
+	manager->textures[manager->count++] = texture;
+	return texture;
+}
+
+static int has_source(const struct managed_texture *texture)
+{
+	return texture->pixels || texture->load;
+}
+
+// Copies the base level back from the GPU so a texture that was created
+// without pixels, or written in place since, can still be evicted
+static int snapshot(struct managed_texture *texture)
+{
+	size_t size = (size_t)texture->width * texture->height *
+		      texture->bytes_per_pixel;
+	texture->pixels = (unsigned char *)malloc(size);
+	if (!texture->pixels) {
+		fprintf(stderr,
+			"ERROR::TEXTURE: Failed to snapshot texture %u\n",
+			texture->id);
+		return -1;
+	}
+
+	odc_gl_state_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+	odc_gl_state_bind_texture(GL_TEXTURE_2D, texture->id);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glGetTexImage(GL_TEXTURE_2D, 0, texture->format, GL_UNSIGNED_BYTE,
+		      texture->pixels);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	odc_gl_state_bind_texture(GL_TEXTURE_2D, 0);
+	return 0;
+}
+
+static void release_storage(struct texture_manager *manager,
+			    struct managed_texture *texture)
+{
+	// Respecifying every level as empty frees the storage but keeps the
+	// texture name valid, so handles held by callers stay usable
+	int levels = texture->has_mipmaps
+			     ? mip_level_count(texture->width, texture->height)
+			     : 1;
+	odc_gl_state_bind_texture(GL_TEXTURE_2D, texture->id);
+	for (int level = 0; level < levels; ++level) {
+		glTexImage2D(GL_TEXTURE_2D, level, texture->internal_format, 0,
+			     0, 0, texture->format, GL_UNSIGNED_BYTE, NULL);
+	}
+	odc_gl_state_bind_texture(GL_TEXTURE_2D, 0);
+
+	texture->resident = 0;
+	manager->usage -= texture->gpu_bytes;
+}
+
+static void evict(struct texture_manager *manager, size_t needed)
+{
+	if (!manager->budget)
+		return;
+
+	while (manager->usage + needed > manager->budget) {
+		struct managed_texture *victim = NULL;
+		for (int i = 0; i < manager->count; ++i) {
+			struct managed_texture *t = manager->textures[i];
+			if (!t->resident || t->pinned ||
+			    t->last_used >= manager->frame)
+				continue;
+			if (!victim || t->last_used < victim->last_used)
+				victim = t;
+		}
+
+		if (!victim)
+			return;
+		if (!has_source(victim) && snapshot(victim) != 0)
+			return;
+
+		release_storage(manager, victim);
+	}
+}
+
+static int make_resident(struct texture_manager *manager,
+			 struct managed_texture *texture)
+{
+	unsigned char *loaded = NULL;
+	const unsigned char *pixels = texture->pixels;
+
+	if (!pixels && texture->load) {
+		int width = 0, height = 0;
+		loaded = texture->load(texture->user_data, &width, &height);
+		if (!loaded) {
+			fprintf(stderr,
+				"ERROR::TEXTURE: Failed to load texture %u\n",
+				texture->id);
+			return -1;
+		}
+		texture->width = width;
+		texture->height = height;
+		texture->gpu_bytes = texture_bytes(width, height,
+						   texture->bytes_per_pixel,
+						   texture->has_mipmaps);
+		pixels = loaded;
+	}
+
+	if (!pixels) {
+		fprintf(stderr, "ERROR::TEXTURE: Texture %u has no source\n",
+			texture->id);
+		return -1;
+	}
+
+	evict(manager, texture->gpu_bytes);
+
+	odc_gl_state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	odc_gl_state_bind_texture(GL_TEXTURE_2D, texture->id);
+	if (texture->bytes_per_pixel == 1)
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, texture->internal_format,
+		     texture->width, texture->height, 0, texture->format,
+		     GL_UNSIGNED_BYTE, pixels);
+	if (texture->bytes_per_pixel == 1)
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	if (texture->has_mipmaps)
+		glGenerateMipmap(GL_TEXTURE_2D);
+	odc_gl_state_bind_texture(GL_TEXTURE_2D, 0);
+
+	free(loaded);
+
+	texture->resident = 1;
+	manager->usage += texture->gpu_bytes;
+	return 0;
+}
+
+struct texture_manager *odc_texture_manager_new(void)
+{
+	struct texture_manager *manager =
+		(struct texture_manager *)calloc(1, sizeof(*manager));
+	if (!manager) {
+		fprintf(stderr,
+			"ERROR::TEXTURE: Failed to allocate texture manager\n");
+		return NULL;
+	}
+
+	// Start at one so textures added before the first frame count as
+	// used and are not evicted before they are drawn
+	manager->frame = 1;
+	return manager;
+}
+
+void odc_texture_manager_destroy(struct texture_manager *manager)
+{
+	if (!manager)
+		return;
+
+	for (int i = 0; i < manager->count; ++i) {
+		odc_gl_state_delete_textures(1, &manager->textures[i]->id);
+		free(manager->textures[i]->pixels);
+		free(manager->textures[i]);
+	}
+
+	free(manager->textures);
+	free(manager->slots);
+	free(manager);
+}
+
+struct managed_texture *
+odc_texture_manager_add(struct texture_manager *manager, GLuint id, int width,
+			int height, GLenum internal_format, GLenum format,
+			int has_mipmaps, const unsigned char *pixels)
+{
+	struct managed_texture *texture = insert(manager, id);
+	if (!texture) {
+		fprintf(stderr, "ERROR::TEXTURE: Failed to track texture %u\n",
+			id);
+		return NULL;
+	}
+
+	texture->width = width;
+	texture->height = height;
+	texture->internal_format = internal_format;
+	texture->format = format;
+	texture->bytes_per_pixel = format == GL_RED ? 1 : 4;
+	texture->has_mipmaps = has_mipmaps;
+	texture->gpu_bytes = texture_bytes(width, height,
+					   texture->bytes_per_pixel,
+					   has_mipmaps);
+	texture->resident = 1;
+	manager->usage += texture->gpu_bytes;
+
+	// Keep a CPU copy when a budget may force this texture out; textures
+	// added without one are read back if they are ever evicted
+	if (manager->budget && pixels) {
+		size_t size = (size_t)width * height * texture->bytes_per_pixel;
+		texture->pixels = (unsigned char *)malloc(size);
+		if (texture->pixels)
+			memcpy(texture->pixels, pixels, size);
+	}
+
+	evict(manager, 0);
+	return texture;
+}
+
+struct managed_texture *
+odc_texture_manager_add_source(struct texture_manager *manager, int width,
+			       int height, texture_load_fn load,
+			       void *user_data)
+{
+	if (!load) {
+		fprintf(stderr, "ERROR::TEXTURE: Texture source needs a loader\n");
+		return NULL;
+	}
+
+	GLuint id;
+	glGenTextures(1, &id);
+
+	struct managed_texture *texture = insert(manager, id);
+	if (!texture) {
+		odc_gl_state_delete_textures(1, &id);
+		return NULL;
+	}
+
+	texture->width = width;
+	texture->height = height;
+	texture->internal_format = GL_RGBA8;
+	texture->format = GL_RGBA;
+	texture->bytes_per_pixel = 4;
+	texture->gpu_bytes = texture_bytes(width, height, 4, 0);
+	texture->load = load;
+	texture->user_data = user_data;
+	return texture;
+}
+
+struct managed_texture *odc_texture_manager_find(struct texture_manager *manager,
+						 GLuint id)
+{
+	if (id >= manager->slot_capacity || !manager->slots[id])
+		return NULL;
+	return manager->textures[manager->slots[id] - 1];
+}
+
+void odc_texture_manager_remove(struct texture_manager *manager, GLuint id)
+{
+	struct managed_texture *texture = odc_texture_manager_find(manager, id);
+	if (!texture)
+		return;
+
+	int index = manager->slots[id] - 1;
+	if (texture->resident)
+		manager->usage -= texture->gpu_bytes;
+
+	odc_gl_state_delete_textures(1, &texture->id);
+	free(texture->pixels);
+	free(texture);
+
+	manager->slots[id] = 0;
+	manager->count--;
+	if (index != manager->count) {
+		manager->textures[index] = manager->textures[manager->count];
+		manager->slots[manager->textures[index]->id] = index + 1;
+	}
+}
+
+int odc_texture_manager_use(struct texture_manager *manager, GLuint id)
+{
+	struct managed_texture *texture = odc_texture_manager_find(manager, id);
+	if (!texture)
+		return -1;
+
+	texture->last_used = manager->frame;
+	if (texture->resident)
+		return 0;
+
+	return make_resident(manager, texture);
+}
+
+int odc_texture_manager_update(struct texture_manager *manager, GLuint id,
+			       int x, int y, int width, int height,
+			       const unsigned char *pixels)
+{
+	struct managed_texture *texture = odc_texture_manager_find(manager, id);
+	if (!texture)
+		return 0;
+
+	texture->last_used = manager->frame;
+	if (!texture->resident && make_resident(manager, texture) != 0)
+		return -1;
+
+	// Without reading the rest back a write can only be known to keep
+	// the texture opaque, never to make it so. Palette indices carry no
+	// alpha to check.
+	if (texture->opaque &&
+	    (!pixels || texture->bytes_per_pixel != 4 ||
+	     !odc_image_is_opaque(pixels, width, height)))
+		texture->opaque = 0;
+
+	if (pixels && texture->pixels) {
+		size_t pixel_bytes = texture->bytes_per_pixel;
+		size_t row_bytes = (size_t)width * pixel_bytes;
+		for (int row = 0; row < height; ++row) {
+			memcpy(texture->pixels +
+				       ((size_t)(y + row) * texture->width + x) *
+					       pixel_bytes,
+			       pixels + row * row_bytes, row_bytes);
+		}
+		return 0;
+	}
+
+	// The new contents only exist on the GPU now, so neither the old
+	// copy nor the loader can bring the texture back
+	free(texture->pixels);
+	texture->pixels = NULL;
+	texture->load = NULL;
+	return 0;
+}
+
+void odc_texture_manager_end_frame(struct texture_manager *manager)
+{
+	evict(manager, 0);
+	manager->frame++;
+}
+
+void odc_texture_manager_set_budget(struct texture_manager *manager,
+				    size_t bytes)
+{
+	manager->budget = bytes;
+	evict(manager, 0);
+}
+
+size_t odc_texture_manager_get_usage(struct texture_manager *manager)
+{
+	return manager->usage;
+}
+
+void odc_texture_manager_set_pinned(struct texture_manager *manager, GLuint id,
+				    int pinned)
+{
+	struct managed_texture *texture = odc_texture_manager_find(manager, id);
+	if (texture)
+		texture->pinned = pinned;
+}
@@ -0,0 +1,363 @@
+#include "glad.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "odc_gl_state.h"
+#include "odc_texture_manager.h"
+#include "odc_texture_stream.h"
+
+enum slot_state {
+	SLOT_FREE,
+	SLOT_MAPPED,
+	SLOT_READY,
+	SLOT_IN_FLIGHT,
+	// The texture couldn't be made resident, so nothing was uploaded
+	SLOT_FAILED,
+};
+
+struct stream_slot {
+	GLuint pbo;
+	enum slot_state state;
+	GLsync fence;
+	unsigned int ticket;
+	GLuint texture;
+	int x, y;
+	int width, height;
+	GLenum format;
+	texture_stream_callback callback;
+	void *user_data;
+};
+
+struct texture_stream {
+	struct stream_slot *slots;
+	int slot_count;
+	size_t slot_size;
+	unsigned int next_ticket;
+	pthread_mutex_t mutex;
+	struct texture_manager *textures;
+};
+
+static int bytes_per_pixel(GLenum format)
+{
+	return format == GL_RED ? 1 : 4;
+}
+
+static void upload_direct(GLuint texture, int x, int y, int width, int height,
+			  GLenum format, const void *data)
+{
+	odc_gl_state_bind_texture(GL_TEXTURE_2D, texture);
+	if (bytes_per_pixel(format) == 1)
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, format,
+			GL_UNSIGNED_BYTE, data);
+	if (bytes_per_pixel(format) == 1)
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	odc_gl_state_bind_texture(GL_TEXTURE_2D, 0);
+}
+
+// Brings an evicted texture back before it is written and keeps the
+// manager's copy in step; pixels is NULL when the data sits in a PBO.
+// Fails when the texture has been deleted or can't be reloaded.
+static int prepare_texture(struct texture_stream *stream, GLuint texture,
+			   int x, int y, int width, int height,
+			   const void *pixels)
+{
+	if (stream->textures &&
+	    odc_texture_manager_update(stream->textures, texture, x, y, width,
+				       height,
+				       (const unsigned char *)pixels) != 0)
+		return -1;
+	return glIsTexture(texture) ? 0 : -1;
+}
+
+static void issue_slot(struct texture_stream *stream,
+		       struct stream_slot *slot)
+{
+	odc_gl_state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, slot->pbo);
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	odc_gl_state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	if (prepare_texture(stream, slot->texture, slot->x, slot->y,
+			    slot->width, slot->height, NULL) != 0) {
+		pthread_mutex_lock(&stream->mutex);
+		slot->state = SLOT_FAILED;
+		pthread_mutex_unlock(&stream->mutex);
+		return;
+	}
+
+	// Reloading an evicted texture unbinds the PBO, so bind it after
+	odc_gl_state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, slot->pbo);
+	upload_direct(slot->texture, slot->x, slot->y, slot->width,
+		      slot->height, slot->format, (const void *)0);
+	odc_gl_state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	pthread_mutex_lock(&stream->mutex);
+	slot->state = SLOT_IN_FLIGHT;
+	pthread_mutex_unlock(&stream->mutex);
+}
+
+// Issues ready slots oldest first so updates to the same texture land in
+// submission order
+static void issue_ready_slots(struct texture_stream *stream)
+{
+	for (;;) {
+		struct stream_slot *next = NULL;
+		pthread_mutex_lock(&stream->mutex);
+		for (int i = 0; i < stream->slot_count; ++i) {
+			struct stream_slot *slot = &stream->slots[i];
+			if (slot->state == SLOT_READY &&
+			    (!next || slot->ticket < next->ticket))
+				next = slot;
+		}
+		pthread_mutex_unlock(&stream->mutex);
+
+		if (!next)
+			break;
+
+		issue_slot(stream, next);
+	}
+}
+
+struct texture_stream *
+odc_texture_stream_new(struct texture_manager *textures, int slot_count,
+		       size_t slot_size)
+{
+	if (slot_count <= 0)
+		slot_count = TEXTURE_STREAM_DEFAULT_SLOTS;
+
+	struct texture_stream *stream =
+		(struct texture_stream *)calloc(1, sizeof(*stream));
+	if (!stream) {
+		fprintf(stderr,
+			"ERROR::TEXTURE_STREAM: Failed to allocate stream\n");
+		return NULL;
+	}
+
+	stream->slots =
+		(struct stream_slot *)calloc(slot_count, sizeof(*stream->slots));
+	if (!stream->slots) {
+		fprintf(stderr,
+			"ERROR::TEXTURE_STREAM: Failed to allocate slots\n");
+		free(stream);
+		return NULL;
+	}
+
+	stream->slot_count = slot_count;
+	stream->slot_size = slot_size;
+	stream->next_ticket = 1;
+	stream->textures = textures;
+	pthread_mutex_init(&stream->mutex, NULL);
+
+	for (int i = 0; i < slot_count; ++i) {
+		glGenBuffers(1, &stream->slots[i].pbo);
+		odc_gl_state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, stream->slots[i].pbo);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)slot_size, NULL,
+			     GL_STREAM_DRAW);
+	}
+	odc_gl_state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	return stream;
+}
+
+void odc_texture_stream_destroy(struct texture_stream *stream)
+{
+	if (!stream)
+		return;
+
+	odc_texture_stream_finish(stream);
+
+	for (int i = 0; i < stream->slot_count; ++i) {
+		struct stream_slot *slot = &stream->slots[i];
+		if (slot->state == SLOT_MAPPED || slot->state == SLOT_READY) {
+			odc_gl_state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, slot->pbo);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		}
+		odc_gl_state_delete_buffers(1, &slot->pbo);
+	}
+	odc_gl_state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	pthread_mutex_destroy(&stream->mutex);
+	free(stream->slots);
+	free(stream);
+}
+
+void *odc_texture_stream_acquire(struct texture_stream *stream, size_t size,
+				 int *slot)
+{
+	if (size > stream->slot_size)
+		return NULL;
+
+	struct stream_slot *free_slot = NULL;
+	pthread_mutex_lock(&stream->mutex);
+	for (int i = 0; i < stream->slot_count; ++i) {
+		if (stream->slots[i].state == SLOT_FREE) {
+			free_slot = &stream->slots[i];
+			free_slot->state = SLOT_MAPPED;
+			*slot = i;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&stream->mutex);
+
+	if (!free_slot)
+		return NULL;
+
+	// A free slot's fence has signaled, so the GPU is done with it and
+	// the map doesn't need to synchronize
+	odc_gl_state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, free_slot->pbo);
+	void *data = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0,
+				      (GLsizeiptr)size,
+				      GL_MAP_WRITE_BIT |
+					      GL_MAP_INVALIDATE_BUFFER_BIT |
+					      GL_MAP_UNSYNCHRONIZED_BIT);
+	odc_gl_state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	if (!data) {
+		fprintf(stderr,
+			"ERROR::TEXTURE_STREAM: Failed to map staging buffer\n");
+		pthread_mutex_lock(&stream->mutex);
+		free_slot->state = SLOT_FREE;
+		pthread_mutex_unlock(&stream->mutex);
+	}
+
+	return data;
+}
+
+unsigned int odc_texture_stream_submit(struct texture_stream *stream, int slot,
+				       GLuint texture, int x, int y, int width,
+				       int height, GLenum format,
+				       texture_stream_callback callback,
+				       void *user_data)
+{
+	if (slot < 0 || slot >= stream->slot_count)
+		return 0;
+
+	pthread_mutex_lock(&stream->mutex);
+	struct stream_slot *s = &stream->slots[slot];
+	if (s->state != SLOT_MAPPED) {
+		pthread_mutex_unlock(&stream->mutex);
+		return 0;
+	}
+
+	s->texture = texture;
+	s->x = x;
+	s->y = y;
+	s->width = width;
+	s->height = height;
+	s->format = format;
+	s->callback = callback;
+	s->user_data = user_data;
+	s->ticket = stream->next_ticket++;
+	s->state = SLOT_READY;
+	unsigned int ticket = s->ticket;
+	pthread_mutex_unlock(&stream->mutex);
+
+	return ticket;
+}
+
+unsigned int odc_texture_stream_upload(struct texture_stream *stream,
+				       GLuint texture, int x, int y, int width,
+				       int height, GLenum format,
+				       const void *data,
+				       texture_stream_callback callback,
+				       void *user_data)
+{
+	size_t size = (size_t)width * height * bytes_per_pixel(format);
+
+	int slot;
+	void *staging = odc_texture_stream_acquire(stream, size, &slot);
+	if (staging) {
+		memcpy(staging, data, size);
+		return odc_texture_stream_submit(stream, slot, texture, x, y,
+						 width, height, format,
+						 callback, user_data);
+	}
+
+	// No staging space, so fall back to a blocking upload that is
+	// complete as soon as it returns. Earlier submissions go first, or
+	// they would land on top of these newer pixels.
+	issue_ready_slots(stream);
+	int failed = prepare_texture(stream, texture, x, y, width, height,
+				     data) != 0;
+	if (!failed)
+		upload_direct(texture, x, y, width, height, format, data);
+
+	pthread_mutex_lock(&stream->mutex);
+	unsigned int ticket = stream->next_ticket++;
+	pthread_mutex_unlock(&stream->mutex);
+
+	if (callback)
+		callback(failed ? 0 : texture, ticket, user_data);
+	return ticket;
+}
+
+static void retire_slots(struct texture_stream *stream, GLuint64 timeout)
+{
+	for (int i = 0; i < stream->slot_count; ++i) {
+		struct stream_slot *slot = &stream->slots[i];
+		int failed = slot->state == SLOT_FAILED;
+		if (slot->state != SLOT_IN_FLIGHT && !failed)
+			continue;
+
+		if (!failed) {
+			// Waiting on a fence that was never flushed may never
+			// return
+			GLenum status = glClientWaitSync(
+				slot->fence,
+				timeout ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+				timeout);
+			if (status != GL_ALREADY_SIGNALED &&
+			    status != GL_CONDITION_SATISFIED)
+				continue;
+
+			glDeleteSync(slot->fence);
+			slot->fence = NULL;
+		}
+
+		texture_stream_callback callback = slot->callback;
+		GLuint texture = failed ? 0 : slot->texture;
+		unsigned int ticket = slot->ticket;
+		void *user_data = slot->user_data;
+
+		pthread_mutex_lock(&stream->mutex);
+		slot->state = SLOT_FREE;
+		pthread_mutex_unlock(&stream->mutex);
+
+		if (callback)
+			callback(texture, ticket, user_data);
+	}
+}
+
+void odc_texture_stream_update(struct texture_stream *stream)
+{
+	retire_slots(stream, 0);
+	issue_ready_slots(stream);
+}
+
+void odc_texture_stream_finish(struct texture_stream *stream)
+{
+	odc_texture_stream_update(stream);
+	retire_slots(stream, GL_TIMEOUT_IGNORED);
+}
+
+int odc_texture_stream_is_complete(struct texture_stream *stream,
+				   unsigned int ticket)
+{
+	int complete = ticket != 0;
+
+	pthread_mutex_lock(&stream->mutex);
+	if (ticket >= stream->next_ticket)
+		complete = 0;
+	for (int i = 0; complete && i < stream->slot_count; ++i) {
+		struct stream_slot *slot = &stream->slots[i];
+		if (slot->state != SLOT_FREE && slot->state != SLOT_MAPPED &&
+		    slot->ticket == ticket)
+			complete = 0;
+	}
+	pthread_mutex_unlock(&stream->mutex);
+
+	return complete;
+}
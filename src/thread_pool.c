@@ -0,0 +1,161 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "odc_thread_pool.h"
+
+struct thread_pool_job {
+	thread_pool_job_fn fn;
+	void *arg;
+	struct thread_pool_job *next;
+};
+
+struct thread_pool {
+	pthread_t *threads;
+	int thread_count;
+	struct thread_pool_job *head;
+	struct thread_pool_job *tail;
+	int active;
+	int stopping;
+	pthread_mutex_t mutex;
+	pthread_cond_t job_available;
+	pthread_cond_t idle;
+};
+
+static void *worker_main(void *arg)
+{
+	struct thread_pool *pool = (struct thread_pool *)arg;
+
+	for (;;) {
+		pthread_mutex_lock(&pool->mutex);
+		while (!pool->head && !pool->stopping)
+			pthread_cond_wait(&pool->job_available, &pool->mutex);
+
+		if (!pool->head) {
+			pthread_mutex_unlock(&pool->mutex);
+			return NULL;
+		}
+
+		struct thread_pool_job *job = pool->head;
+		pool->head = job->next;
+		if (!pool->head)
+			pool->tail = NULL;
+		pool->active++;
+		pthread_mutex_unlock(&pool->mutex);
+
+		job->fn(job->arg);
+		free(job);
+
+		pthread_mutex_lock(&pool->mutex);
+		pool->active--;
+		if (!pool->head && !pool->active)
+			pthread_cond_broadcast(&pool->idle);
+		pthread_mutex_unlock(&pool->mutex);
+	}
+}
+
+struct thread_pool *odc_thread_pool_new(int thread_count)
+{
+	if (thread_count <= 0) {
+		long cores = sysconf(_SC_NPROCESSORS_ONLN);
+		thread_count = cores > 0 ? (int)cores : 1;
+	}
+
+	struct thread_pool *pool =
+		(struct thread_pool *)calloc(1, sizeof(*pool));
+	if (!pool) {
+		fprintf(stderr,
+			"ERROR::THREAD_POOL: Failed to allocate thread pool\n");
+		return NULL;
+	}
+
+	pool->threads = (pthread_t *)calloc(thread_count, sizeof(pthread_t));
+	if (!pool->threads) {
+		fprintf(stderr,
+			"ERROR::THREAD_POOL: Failed to allocate threads\n");
+		free(pool);
+		return NULL;
+	}
+
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->job_available, NULL);
+	pthread_cond_init(&pool->idle, NULL);
+
+	for (int i = 0; i < thread_count; ++i) {
+		if (pthread_create(&pool->threads[i], NULL, worker_main, pool) !=
+		    0) {
+			fprintf(stderr,
+				"ERROR::THREAD_POOL: Failed to start worker\n");
+			break;
+		}
+		pool->thread_count++;
+	}
+
+	if (!pool->thread_count) {
+		odc_thread_pool_destroy(pool);
+		return NULL;
+	}
+
+	return pool;
+}
+
+void odc_thread_pool_destroy(struct thread_pool *pool)
+{
+	if (!pool)
+		return;
+
+	// Workers drain the queue before they exit
+	pthread_mutex_lock(&pool->mutex);
+	pool->stopping = 1;
+	pthread_cond_broadcast(&pool->job_available);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (int i = 0; i < pool->thread_count; ++i)
+		pthread_join(pool->threads[i], NULL);
+
+	pthread_cond_destroy(&pool->idle);
+	pthread_cond_destroy(&pool->job_available);
+	pthread_mutex_destroy(&pool->mutex);
+	free(pool->threads);
+	free(pool);
+}
+
+int odc_thread_pool_submit(struct thread_pool *pool, thread_pool_job_fn fn,
+			   void *arg)
+{
+	struct thread_pool_job *job =
+		(struct thread_pool_job *)malloc(sizeof(*job));
+	if (!job) {
+		fprintf(stderr, "ERROR::THREAD_POOL: Failed to allocate job\n");
+		return -1;
+	}
+
+	job->fn = fn;
+	job->arg = arg;
+	job->next = NULL;
+
+	pthread_mutex_lock(&pool->mutex);
+	if (pool->tail)
+		pool->tail->next = job;
+	else
+		pool->head = job;
+	pool->tail = job;
+	pthread_cond_signal(&pool->job_available);
+	pthread_mutex_unlock(&pool->mutex);
+
+	return 0;
+}
+
+void odc_thread_pool_wait(struct thread_pool *pool)
+{
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->head || pool->active)
+		pthread_cond_wait(&pool->idle, &pool->mutex);
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+int odc_thread_pool_get_thread_count(struct thread_pool *pool)
+{
+	return pool->thread_count;
+}
@@ -0,0 +1,440 @@
+#include "glad.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "odc_gl_state.h"
+#include "odc_video_capture.h"
+
+enum capture_slot_state {
+	SLOT_FREE,
+	// glReadPixels into the buffer is queued behind a fence
+	SLOT_READING,
+	// Mapped and handed to the writer thread
+	SLOT_QUEUED,
+	// Written out; the GL thread unmaps it
+	SLOT_WRITTEN,
+};
+
+struct capture_slot {
+	GLuint pbo;
+	GLsync fence;
+	enum capture_slot_state state;
+	const unsigned char *pixels;
+};
+
+struct video_capture {
+	FILE *file;
+	int is_pipe;
+	enum video_capture_format format;
+	int width;
+	int height;
+	struct capture_slot slots[VIDEO_CAPTURE_SLOTS];
+	// Slots are filled, mapped and written in ring order
+	int read_index;
+	int map_index;
+	int write_index;
+	int frame_count;
+	int dropped_count;
+	int write_failed;
+	unsigned char *yuv;
+	pthread_t writer;
+	int writer_started;
+	int stopping;
+	pthread_mutex_t mutex;
+	pthread_cond_t queued;
+};
+
+static unsigned char clamp_byte(int value)
+{
+	return value < 0 ? 0 : value > 255 ? 255 : (unsigned char)value;
+}
+
+// Full range BT.601, as "C420jpeg" declares. GL rows start at the bottom.
+static void convert_yuv420(const unsigned char *rgba, int width, int height,
+			   unsigned char *yuv)
+{
+	int chroma_width = (width + 1) / 2;
+	int chroma_height = (height + 1) / 2;
+	unsigned char *y_plane = yuv;
+	unsigned char *u_plane = yuv + width * height;
+	unsigned char *v_plane = u_plane + chroma_width * chroma_height;
+
+	for (int y = 0; y < height; ++y) {
+		const unsigned char *row = rgba + (size_t)(height - 1 - y) *
+							  width * 4;
+		for (int x = 0; x < width; ++x) {
+			const unsigned char *p = &row[x * 4];
+			int luma = 77 * p[0] + 150 * p[1] + 29 * p[2];
+			y_plane[y * width + x] = clamp_byte((luma + 128) >> 8);
+		}
+	}
+
+	for (int cy = 0; cy < chroma_height; ++cy) {
+		for (int cx = 0; cx < chroma_width; ++cx) {
+			int r = 0, g = 0, b = 0, count = 0;
+			for (int dy = 0; dy < 2; ++dy) {
+				int y = cy * 2 + dy;
+				if (y >= height)
+					break;
+				const unsigned char *row =
+					rgba + (size_t)(height - 1 - y) *
+						       width * 4;
+				for (int dx = 0; dx < 2; ++dx) {
+					int x = cx * 2 + dx;
+					if (x >= width)
+						break;
+					r += row[x * 4];
+					g += row[x * 4 + 1];
+					b += row[x * 4 + 2];
+					count++;
+				}
+			}
+			r /= count;
+			g /= count;
+			b /= count;
+			u_plane[cy * chroma_width + cx] = clamp_byte(
+				((-43 * r - 85 * g + 128 * b + 128) >> 8) +
+				128);
+			v_plane[cy * chroma_width + cx] = clamp_byte(
+				((128 * r - 107 * g - 21 * b + 128) >> 8) +
+				128);
+		}
+	}
+}
+
+static int write_frame(struct video_capture *capture,
+		       const unsigned char *pixels)
+{
+	int width = capture->width;
+	int height = capture->height;
+
+	if (capture->format == VIDEO_CAPTURE_RAW) {
+		size_t stride = (size_t)width * 4;
+		for (int y = height - 1; y >= 0; --y) {
+			if (fwrite(pixels + y * stride, 1, stride,
+				   capture->file) != stride)
+				return -1;
+		}
+		return 0;
+	}
+
+	size_t size = (size_t)width * height +
+		      2 * (size_t)((width + 1) / 2) * ((height + 1) / 2);
+	convert_yuv420(pixels, width, height, capture->yuv);
+	if (fputs("FRAME\n", capture->file) == EOF ||
+	    fwrite(capture->yuv, 1, size, capture->file) != size)
+		return -1;
+	return 0;
+}
+
+// Writing to a command that has exited raises SIGPIPE, which would end the
+// process; blocked, the write fails with EPIPE instead
+static void block_sigpipe(sigset_t *previous)
+{
+	sigset_t set;
+	sigemptyset(&set);
+	sigaddset(&set, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &set, previous);
+}
+
+// Drops a SIGPIPE raised while it was blocked, unless the caller had it
+// blocked already and may be waiting for it
+static void restore_sigpipe(const sigset_t *previous)
+{
+	sigset_t pending;
+	sigpending(&pending);
+	if (sigismember(&pending, SIGPIPE) &&
+	    !sigismember(previous, SIGPIPE)) {
+		sigset_t set;
+		struct timespec zero = {0, 0};
+		sigemptyset(&set);
+		sigaddset(&set, SIGPIPE);
+		sigtimedwait(&set, NULL, &zero);
+	}
+	pthread_sigmask(SIG_SETMASK, previous, NULL);
+}
+
+static void *writer_main(void *arg)
+{
+	struct video_capture *capture = (struct video_capture *)arg;
+
+	// Each frame is flushed here, so the pipe is only written from this
+	// thread until it is closed
+	block_sigpipe(NULL);
+
+	for (;;) {
+		struct capture_slot *slot =
+			&capture->slots[capture->write_index];
+
+		pthread_mutex_lock(&capture->mutex);
+		while (slot->state != SLOT_QUEUED && !capture->stopping)
+			pthread_cond_wait(&capture->queued, &capture->mutex);
+		// Stopping only ends the thread once the queue is drained
+		if (slot->state != SLOT_QUEUED) {
+			pthread_mutex_unlock(&capture->mutex);
+			return NULL;
+		}
+		pthread_mutex_unlock(&capture->mutex);
+
+		if (slot->pixels && !capture->write_failed &&
+		    (write_frame(capture, slot->pixels) != 0 ||
+		     fflush(capture->file) != 0)) {
+			fprintf(stderr, "ERROR::VIDEO_CAPTURE: %s\n",
+				errno == EPIPE ? "Output command exited"
+					       : "Failed to write frame");
+			capture->write_failed = 1;
+		}
+
+		pthread_mutex_lock(&capture->mutex);
+		slot->state = SLOT_WRITTEN;
+		pthread_mutex_unlock(&capture->mutex);
+
+		capture->write_index =
+			(capture->write_index + 1) % VIDEO_CAPTURE_SLOTS;
+	}
+}
+
+static enum capture_slot_state get_state(struct video_capture *capture,
+					 struct capture_slot *slot)
+{
+	pthread_mutex_lock(&capture->mutex);
+	enum capture_slot_state state = slot->state;
+	pthread_mutex_unlock(&capture->mutex);
+	return state;
+}
+
+// Hands finished readbacks to the writer, oldest first, until one hasn't
+// landed within timeout
+static void map_ready_slots(struct video_capture *capture, GLuint64 timeout)
+{
+	for (;;) {
+		struct capture_slot *slot = &capture->slots[capture->map_index];
+		if (get_state(capture, slot) != SLOT_READING)
+			return;
+
+		GLenum status = glClientWaitSync(
+			slot->fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+		if (status != GL_ALREADY_SIGNALED &&
+		    status != GL_CONDITION_SATISFIED)
+			return;
+
+		glDeleteSync(slot->fence);
+		slot->fence = NULL;
+
+		odc_gl_state_bind_buffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+		const unsigned char *pixels = (const unsigned char *)
+			glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+					 (GLsizeiptr)capture->width *
+						 capture->height * 4,
+					 GL_MAP_READ_BIT);
+		odc_gl_state_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+		if (!pixels)
+			fprintf(stderr, "ERROR::VIDEO_CAPTURE: Failed to map "
+					"frame\n");
+
+		pthread_mutex_lock(&capture->mutex);
+		slot->pixels = pixels;
+		slot->state = SLOT_QUEUED;
+		pthread_cond_signal(&capture->queued);
+		pthread_mutex_unlock(&capture->mutex);
+
+		capture->map_index =
+			(capture->map_index + 1) % VIDEO_CAPTURE_SLOTS;
+	}
+}
+
+static void unmap_written_slots(struct video_capture *capture)
+{
+	for (int i = 0; i < VIDEO_CAPTURE_SLOTS; ++i) {
+		struct capture_slot *slot = &capture->slots[i];
+		if (get_state(capture, slot) != SLOT_WRITTEN)
+			continue;
+
+		if (slot->pixels) {
+			odc_gl_state_bind_buffer(GL_PIXEL_PACK_BUFFER,
+						 slot->pbo);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			slot->pixels = NULL;
+		}
+
+		pthread_mutex_lock(&capture->mutex);
+		slot->state = SLOT_FREE;
+		pthread_mutex_unlock(&capture->mutex);
+	}
+	odc_gl_state_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+static int open_output(struct video_capture *capture, const char *path,
+		       int fps)
+{
+	if (path[0] == '|') {
+		capture->file = popen(path + 1, "w");
+		capture->is_pipe = 1;
+	} else {
+		capture->file = fopen(path, "wb");
+	}
+
+	if (!capture->file) {
+		fprintf(stderr, "ERROR::VIDEO_CAPTURE: Failed to open %s\n",
+			path);
+		return -1;
+	}
+
+	if (capture->format == VIDEO_CAPTURE_Y4M &&
+	    fprintf(capture->file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n",
+		    capture->width, capture->height, fps) < 0) {
+		fprintf(stderr, "ERROR::VIDEO_CAPTURE: Failed to write %s\n",
+			path);
+		return -1;
+	}
+
+	return 0;
+}
+
+struct video_capture *odc_video_capture_new(const char *path,
+					    enum video_capture_format format,
+					    int width, int height, int fps)
+{
+	if (width <= 0 || height <= 0 || fps <= 0) {
+		fprintf(stderr, "ERROR::VIDEO_CAPTURE: Invalid frame size or "
+				"rate\n");
+		return NULL;
+	}
+
+	struct video_capture *capture =
+		(struct video_capture *)calloc(1, sizeof(*capture));
+	if (!capture) {
+		fprintf(stderr,
+			"ERROR::VIDEO_CAPTURE: Failed to allocate capture\n");
+		return NULL;
+	}
+
+	capture->format = format;
+	capture->width = width;
+	capture->height = height;
+	pthread_mutex_init(&capture->mutex, NULL);
+	pthread_cond_init(&capture->queued, NULL);
+
+	if (format == VIDEO_CAPTURE_Y4M) {
+		capture->yuv = (unsigned char *)malloc(
+			(size_t)width * height +
+			2 * (size_t)((width + 1) / 2) * ((height + 1) / 2));
+		if (!capture->yuv) {
+			fprintf(stderr, "ERROR::VIDEO_CAPTURE: Failed to "
+					"allocate conversion buffer\n");
+			odc_video_capture_destroy(capture);
+			return NULL;
+		}
+	}
+
+	if (open_output(capture, path, fps) != 0) {
+		odc_video_capture_destroy(capture);
+		return NULL;
+	}
+
+	for (int i = 0; i < VIDEO_CAPTURE_SLOTS; ++i) {
+		glGenBuffers(1, &capture->slots[i].pbo);
+		odc_gl_state_bind_buffer(GL_PIXEL_PACK_BUFFER,
+					 capture->slots[i].pbo);
+		glBufferData(GL_PIXEL_PACK_BUFFER,
+			     (GLsizeiptr)width * height * 4, NULL,
+			     GL_STREAM_READ);
+	}
+	odc_gl_state_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	if (pthread_create(&capture->writer, NULL, writer_main, capture) !=
+	    0) {
+		fprintf(stderr,
+			"ERROR::VIDEO_CAPTURE: Failed to start writer\n");
+		odc_video_capture_destroy(capture);
+		return NULL;
+	}
+	capture->writer_started = 1;
+
+	return capture;
+}
+
+void odc_video_capture_destroy(struct video_capture *capture)
+{
+	if (!capture)
+		return;
+
+	map_ready_slots(capture, GL_TIMEOUT_IGNORED);
+
+	if (capture->writer_started) {
+		pthread_mutex_lock(&capture->mutex);
+		capture->stopping = 1;
+		pthread_cond_signal(&capture->queued);
+		pthread_mutex_unlock(&capture->mutex);
+		pthread_join(capture->writer, NULL);
+	}
+
+	unmap_written_slots(capture);
+	for (int i = 0; i < VIDEO_CAPTURE_SLOTS; ++i) {
+		if (capture->slots[i].pbo)
+			odc_gl_state_delete_buffers(1, &capture->slots[i].pbo);
+	}
+
+	if (capture->file) {
+		if (capture->is_pipe) {
+			// Anything left unwritten after a failure would be
+			// flushed to the dead pipe here
+			sigset_t previous;
+			block_sigpipe(&previous);
+			pclose(capture->file);
+			restore_sigpipe(&previous);
+		} else {
+			fclose(capture->file);
+		}
+	}
+
+	pthread_cond_destroy(&capture->queued);
+	pthread_mutex_destroy(&capture->mutex);
+	free(capture->yuv);
+	free(capture);
+}
+
+int odc_video_capture_frame(struct video_capture *capture, GLuint framebuffer)
+{
+	unmap_written_slots(capture);
+	map_ready_slots(capture, 0);
+
+	// Waiting on the GPU here would only hand the slot to the writer, not
+	// free it, so a full ring drops the frame straight away
+	struct capture_slot *slot = &capture->slots[capture->read_index];
+	if (get_state(capture, slot) != SLOT_FREE) {
+		capture->dropped_count++;
+		return 0;
+	}
+
+	GLint previous = 0;
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	odc_gl_state_bind_buffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+	glReadPixels(0, 0, capture->width, capture->height, GL_RGBA,
+		     GL_UNSIGNED_BYTE, (void *)0);
+	odc_gl_state_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, (GLuint)previous);
+
+	slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	pthread_mutex_lock(&capture->mutex);
+	slot->state = SLOT_READING;
+	pthread_mutex_unlock(&capture->mutex);
+	capture->read_index = (capture->read_index + 1) % VIDEO_CAPTURE_SLOTS;
+	capture->frame_count++;
+	return 1;
+}
+
+int odc_video_capture_get_frame_count(struct video_capture *capture)
+{
+	return capture->frame_count;
+}
+
+int odc_video_capture_get_dropped_count(struct video_capture *capture)
+{
+	return capture->dropped_count;
+}
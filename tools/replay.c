@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "odc.h"
+
+// Re-renders a frame saved with odc_frame_capture_save or
+// odc_engine_capture_frame in a loop and prints the average frame time, so
+// a slow frame from a game can be profiled on its own. Usage:
+//   odc_replay CAPTURE [--frames N] [--window] [--screenshot OUT.ppm]
+// Headless by default at the captured size; --window runs until closed.
+
+#define DEFAULT_FRAMES 100
+
+static struct frame_capture *capture;
+
+static double now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void render(struct engine *e)
+{
+	struct renderer *renderer = odc_engine_get_renderer(e);
+	odc_renderer_reset_shape_count(renderer);
+	odc_renderer_clear(renderer, 0.0f, 0.0f, 0.0f, 1.0f);
+	odc_frame_capture_submit(capture, renderer);
+}
+
+static int write_screenshot(struct engine *engine, const char *path,
+			    int width, int height)
+{
+	unsigned char *pixels =
+		(unsigned char *)malloc((size_t)width * height * 4);
+	if (!pixels || odc_engine_read_pixels(engine, pixels) != 0) {
+		free(pixels);
+		return -1;
+	}
+
+	FILE *file = fopen(path, "wb");
+	if (!file) {
+		fprintf(stderr, "Failed to open %s\n", path);
+		free(pixels);
+		return -1;
+	}
+
+	fprintf(file, "P6\n%d %d\n255\n", width, height);
+	for (int i = 0; i < width * height; ++i)
+		fwrite(&pixels[i * 4], 1, 3, file);
+	int ok = fclose(file) == 0;
+	free(pixels);
+	return ok ? 0 : -1;
+}
+
+static void run_headless(struct engine *engine, int frames)
+{
+	struct renderer *renderer = odc_engine_get_renderer(engine);
+	struct gpu_timer *timer = odc_renderer_get_gpu_timer(renderer);
+	double frame_ms = 0.0;
+	double gpu_ms = 0.0;
+	int gpu_frames = 0;
+
+	// GPU timer results lag, so the first frames aren't counted
+	for (int i = 0; i < GPU_TIMER_FRAMES + 1 + frames; ++i) {
+		double start = now_ms();
+		odc_engine_render(engine);
+		double elapsed = now_ms() - start;
+		if (i < GPU_TIMER_FRAMES + 1)
+			continue;
+
+		frame_ms += elapsed;
+		double gpu = odc_gpu_timer_get_gpu_frame_time(timer);
+		if (gpu > 0.0) {
+			gpu_ms += gpu;
+			gpu_frames++;
+		}
+	}
+
+	printf("frames: %d\nshapes: %d\nframe_ms: %.3f\n", frames,
+	       odc_frame_capture_get_shape_count(capture),
+	       frame_ms / (double)frames);
+	if (gpu_frames > 0)
+		printf("gpu_ms: %.3f\n", gpu_ms / (double)gpu_frames);
+	else
+		printf("gpu_ms: unavailable\n");
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = NULL;
+	const char *screenshot = NULL;
+	int frames = DEFAULT_FRAMES;
+	int windowed = 0;
+
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--window") == 0) {
+			windowed = 1;
+		} else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+			frames = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--screenshot") == 0 &&
+			   i + 1 < argc) {
+			screenshot = argv[++i];
+		} else if (argv[i][0] != '-' && !path) {
+			path = argv[i];
+		} else {
+			fprintf(stderr, "Unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+	if (!path || frames <= 0) {
+		fprintf(stderr, "Usage: odc_replay CAPTURE [--frames N] "
+				"[--window] [--screenshot OUT.ppm]\n");
+		return 1;
+	}
+
+	capture = odc_frame_capture_load(path);
+	if (!capture)
+		return 1;
+
+	int width, height;
+	odc_frame_capture_get_size(capture, &width, &height);
+	struct engine *engine;
+	if (windowed)
+		engine = odc_engine_new(width, height, 0);
+	else
+		engine = odc_engine_new_headless(width, height);
+	if (!engine) {
+		odc_frame_capture_destroy(capture);
+		return 1;
+	}
+
+	struct renderer *renderer = odc_engine_get_renderer(engine);
+	int result = odc_frame_capture_prepare(capture, renderer);
+	if (result == 0) {
+		odc_renderer_set_gpu_timing(renderer, 1);
+		odc_engine_set_render_callback(engine, render);
+		if (windowed)
+			odc_engine_run(engine);
+		else
+			run_headless(engine, frames);
+	}
+
+	if (result == 0 && screenshot && !windowed)
+		result = write_screenshot(engine, screenshot, width, height);
+
+	odc_engine_destroy(engine);
+	odc_frame_capture_destroy(capture);
+	return result == 0 ? 0 : 1;
+}